@@ -0,0 +1,34 @@
+#version 330
+
+// This shader is used by the deferred renderer (see "systems/deferred-renderer.hpp") to draw the lighted materials
+// It uses "lighted.vert" as a vertex shader and writes the surface data to the G-buffer instead of computing the lighting
+
+#include "../include/material.glsl"
+
+in Varyings {
+    vec4 color;
+    vec2 tex_coord;
+    vec3 normal;
+    vec3 view;
+    vec3 world;
+} fs_in;
+
+layout(location = 0) out vec4 gbuffer_albedo;   // rgb: albedo, a: ambient occlusion
+layout(location = 1) out vec4 gbuffer_specular; // rgb: specular, a: roughness
+layout(location = 2) out vec2 gbuffer_normal;   // The normal packed into 2 components (octahedral encoding)
+layout(location = 3) out vec4 gbuffer_emissive; // rgb: emissive
+
+// Projects the normal on an octahedron then unfolds the octahedron into a square
+vec2 encode_normal(vec3 normal) {
+    normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+    if(normal.z >= 0.0) return normal.xy;
+    vec2 signs = vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+    return (1.0 - abs(normal.yx)) * signs;
+}
+
+void main() {
+    gbuffer_albedo = vec4(sample_albedo(fs_in.tex_coord), sample_ambient_occlusion(fs_in.tex_coord));
+    gbuffer_specular = vec4(sample_specular(fs_in.tex_coord), sample_roughness(fs_in.tex_coord));
+    gbuffer_normal = encode_normal(normalize(fs_in.normal));
+    gbuffer_emissive = vec4(sample_emissive(fs_in.tex_coord), 1.0);
+}
@@ -0,0 +1,61 @@
+#version 330
+
+// This shader is used by the deferred renderer (see "systems/deferred-renderer.hpp") to light the G-buffer
+// It is drawn as a fullscreen triangle so every pixel is lit once no matter how many objects were drawn over it
+// The lighting is the same as "lighted.frag" and the lights are read from the same light clusters
+
+#include "../include/lighting.glsl"
+
+// The G-buffer written by "gbuffer.frag"
+uniform sampler2D gbuffer_albedo;
+uniform sampler2D gbuffer_specular;
+uniform sampler2D gbuffer_normal;
+uniform sampler2D gbuffer_emissive;
+uniform sampler2D gbuffer_depth;
+
+// Used to reconstruct the world position of the pixel from its depth
+uniform mat4 inverse_VP;
+uniform vec3 camera_position;
+uniform vec3 camera_forward;
+
+in vec2 tex_coord;
+out vec4 frag_color;
+
+vec3 decode_normal(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if(normal.z < 0.0){
+        vec2 signs = vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+        normal.xy = (1.0 - abs(normal.yx)) * signs;
+    }
+    return normalize(normal);
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth_sample = texelFetch(gbuffer_depth, pixel, 0).r;
+    // Nothing was drawn to this pixel (the sky will be drawn there later)
+    if(depth_sample == 1.0){
+        frag_color = vec4(0.0);
+        return;
+    }
+    vec4 clip = inverse_VP * vec4(tex_coord * 2.0 - 1.0, depth_sample * 2.0 - 1.0, 1.0);
+    vec3 world = clip.xyz / clip.w;
+
+    vec4 albedo_occlusion = texelFetch(gbuffer_albedo, pixel, 0);
+    vec4 specular_roughness = texelFetch(gbuffer_specular, pixel, 0);
+    vec3 normal = decode_normal(texelFetch(gbuffer_normal, pixel, 0).xy);
+    vec3 emissive = texelFetch(gbuffer_emissive, pixel, 0).rgb;
+    vec3 view = normalize(camera_position - world);
+
+    vec3 diffuse = albedo_occlusion.rgb;
+    vec3 specular = specular_roughness.rgb;
+    vec3 ambient = diffuse * albedo_occlusion.a;
+    float shininess = 2.0 / pow(clamp(specular_roughness.a, 0.001, 0.999), 4.0) - 2.0;
+
+    vec3 color = emissive + compute_sky_light(normal) * ambient;
+
+    float depth = max(dot(world - camera_position, camera_forward), cluster_near);
+    color += compute_lights(world, normal, view, depth, diffuse, specular, shininess);
+
+    frag_color = vec4(color, 1.0);
+}
@@ -0,0 +1,5 @@
+#version 330
+
+// The depth pre-pass doesn't write any color, the depth is written by the fixed function pipeline
+void main() {
+}
@@ -0,0 +1,27 @@
+#version 330
+
+// This shader is used by the depth pre-pass of the renderer to draw only the depth of the lighted objects
+// The position must be computed exactly like "lighted.vert" does so that the main pass can use GL_EQUAL as a depth function
+layout(location = 0) in vec3 position;
+
+uniform mat4 VP;
+
+#ifdef BATCHED
+// The batched instances read their model matrix like "lighted.vert" does
+uniform samplerBuffer instance_data;
+uniform int instance_offset;
+#else
+uniform mat4 M;
+#endif
+
+invariant gl_Position;
+
+void main() {
+#ifdef BATCHED
+    int base = instance_offset + 9 * gl_InstanceID;
+    mat4 M = mat4(texelFetch(instance_data, base), texelFetch(instance_data, base + 1),
+                  texelFetch(instance_data, base + 2), texelFetch(instance_data, base + 3));
+#endif
+    vec3 world = (M * vec4(position, 1.0)).xyz;
+    gl_Position = VP * vec4(world, 1.0);
+}
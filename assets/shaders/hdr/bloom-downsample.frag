@@ -0,0 +1,69 @@
+#version 330
+
+// This shader is used by the bloom (see "systems/forward-renderer.hpp") to halve the resolution of the bright parts of the scene
+// It uses the 13 taps filter of "Next Generation Post Processing in Call of Duty: Advanced Warfare" (Jorge Jimenez) which
+// is a weighted average of 5 overlapping 2x2 boxes, so the downsampling doesn't flicker when the camera moves
+
+// The texture of the level before this one (or the HDR scene for the first level)
+uniform sampler2D tex;
+// The size of a texel of "tex" in the texture coordinates space
+uniform vec2 texel_size;
+// The part of "tex" that holds the image (the scene is drawn to a part of its target by the dynamic resolution)
+uniform vec2 uv_scale;
+uniform vec2 uv_max;
+// The first level only keeps the colors above the threshold, and each box is weighted by the inverse of its brightness
+// (Karis average) so a single very bright pixel doesn't turn into a blinking square
+uniform bool prefilter;
+uniform vec4 threshold; // x: threshold, y: threshold - knee, z: 2 * knee, w: 0.25 / knee
+
+in vec2 tex_coord;
+out vec4 frag_color;
+
+vec3 fetch(vec2 offset){
+    return texture(tex, min(tex_coord * uv_scale + offset * texel_size, uv_max)).rgb;
+}
+
+float luma(vec3 color){
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Removes the colors under the threshold with a soft knee (a quadratic curve) so the bloom doesn't start abruptly
+vec3 apply_threshold(vec3 color){
+    float brightness = max(color.r, max(color.g, color.b));
+    float soft = clamp(brightness - threshold.y, 0.0, threshold.z);
+    soft = soft * soft * threshold.w;
+    return color * max(soft, brightness - threshold.x) / max(brightness, 0.0001);
+}
+
+void main(){
+    vec3 a = fetch(vec2(-2.0, 2.0)), b = fetch(vec2(0.0, 2.0)), c = fetch(vec2(2.0, 2.0));
+    vec3 d = fetch(vec2(-1.0, 1.0)), e = fetch(vec2(1.0, 1.0));
+    vec3 f = fetch(vec2(-2.0, 0.0)), g = fetch(vec2(0.0, 0.0)), h = fetch(vec2(2.0, 0.0));
+    vec3 i = fetch(vec2(-1.0, -1.0)), j = fetch(vec2(1.0, -1.0));
+    vec3 k = fetch(vec2(-2.0, -2.0)), l = fetch(vec2(0.0, -2.0)), m = fetch(vec2(2.0, -2.0));
+
+    // The central box has half the weight and the 4 corner boxes share the other half
+    vec3 boxes[5] = vec3[](
+        (d + e + i + j) * 0.25,
+        (a + b + f + g) * 0.25,
+        (b + c + g + h) * 0.25,
+        (f + g + k + l) * 0.25,
+        (g + h + l + m) * 0.25
+    );
+    float weights[5] = float[](0.5, 0.125, 0.125, 0.125, 0.125);
+
+    vec3 color = vec3(0.0);
+    if(prefilter){
+        float total = 0.0;
+        for(int index = 0; index < 5; index++){
+            float weight = weights[index] / (1.0 + luma(boxes[index]));
+            color += boxes[index] * weight;
+            total += weight;
+        }
+        color = apply_threshold(color / total);
+    } else {
+        for(int index = 0; index < 5; index++)
+            color += boxes[index] * weights[index];
+    }
+    frag_color = vec4(color, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330
+
+// This shader is used by the bloom (see "systems/forward-renderer.hpp") to add a level to the level above it
+// The level is read with a 3x3 tent filter, and the result is added (using blending) to the downsampled level above it
+// so each level ends up holding the sum of the blurs of all the levels below it
+
+// The texture of the level below the one being drawn
+uniform sampler2D tex;
+// The size of a texel of "tex" in the texture coordinates space multiplied by the radius of the filter
+uniform vec2 texel_size;
+
+in vec2 tex_coord;
+out vec4 frag_color;
+
+void main(){
+    vec3 color = texture(tex, tex_coord).rgb * 4.0;
+    color += (texture(tex, tex_coord + vec2(-texel_size.x, 0.0)).rgb + texture(tex, tex_coord + vec2(texel_size.x, 0.0)).rgb +
+              texture(tex, tex_coord + vec2(0.0, -texel_size.y)).rgb + texture(tex, tex_coord + vec2(0.0, texel_size.y)).rgb) * 2.0;
+    color += texture(tex, tex_coord - texel_size).rgb + texture(tex, tex_coord + texel_size).rgb +
+             texture(tex, tex_coord + vec2(-texel_size.x, texel_size.y)).rgb + texture(tex, tex_coord + vec2(texel_size.x, -texel_size.y)).rgb;
+    frag_color = vec4(color / 16.0, 1.0);
+}
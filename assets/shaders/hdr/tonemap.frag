@@ -0,0 +1,29 @@
+#version 330
+
+// This shader is the first postprocessing pass when the scene is drawn in HDR (see "systems/forward-renderer.hpp")
+// It adds the bloom to the scene, applies the exposure and maps the colors to the range of the screen using a filmic curve.
+// It also upscales the scene if the dynamic resolution lowered its render size (so this doesn't need a separate pass)
+
+// The HDR scene
+uniform sampler2D tex;
+// The first level of the bloom (it holds the sum of all the levels)
+uniform sampler2D bloom;
+// The part of "tex" that holds the image (the scene is drawn to a part of its target by the dynamic resolution)
+uniform vec2 uv_scale;
+uniform vec2 uv_max;
+uniform float exposure;
+uniform float bloom_intensity;
+
+in vec2 tex_coord;
+out vec4 frag_color;
+
+// The fit of the ACES filmic curve by Krzysztof Narkowicz
+vec3 aces_filmic(vec3 color){
+    return clamp((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main(){
+    vec3 color = texture(tex, min(tex_coord * uv_scale, uv_max)).rgb;
+    color += texture(bloom, tex_coord).rgb * bloom_intensity;
+    frag_color = vec4(aces_filmic(color * exposure), 1.0);
+}
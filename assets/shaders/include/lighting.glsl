@@ -0,0 +1,149 @@
+// The lighting shared by "lighted.frag" and "deferred/lighting.frag": the lights are read from the light clusters
+// (see "systems/light-clusters.hpp") and shadowed by the shadow maps (see "systems/shadow-maps.hpp")
+
+#define DIRECTIONAL 0
+#define POINT       1
+#define SPOT        2
+
+struct Light {
+    int type;
+    vec3 position;
+    vec3 direction;
+    vec3 color;
+    vec3 attenuation;
+    vec2 cone_angles; // The inner & outer angles of a spot light
+    int shadow; // The shadow map of the light (-1 if it has no shadows)
+};
+
+// The lights are binned into a grid of clusters by the renderer
+// light_data holds 4 texels per light, light_clusters holds the (offset, count) of the lights of each cluster in light_indices
+// The three of them view the dynamic buffer of the renderer, and light_offsets is where the data of this frame starts in each
+uniform samplerBuffer light_data;
+uniform usamplerBuffer light_clusters;
+uniform usamplerBuffer light_indices;
+uniform ivec3 light_offsets;
+// The first "global_light_count" lights (e.g. directional lights) affect every fragment so they are not in the clusters
+uniform int global_light_count;
+uniform ivec3 cluster_count;
+uniform vec2 cluster_tile_size;
+uniform float cluster_near;
+uniform float cluster_depth_scale; // slice = log(depth / cluster_near) * cluster_depth_scale
+
+Light fetch_light(int index) {
+    int base = light_offsets.x + 4 * index;
+    vec4 position_type = texelFetch(light_data, base);
+    vec4 direction_inner = texelFetch(light_data, base + 1);
+    vec4 color_outer = texelFetch(light_data, base + 2);
+    Light light;
+    light.type = int(position_type.w);
+    light.position = position_type.xyz;
+    light.direction = direction_inner.xyz;
+    light.color = color_outer.rgb;
+    vec4 attenuation_shadow = texelFetch(light_data, base + 3);
+    light.attenuation = attenuation_shadow.xyz;
+    light.shadow = int(attenuation_shadow.w);
+    light.cone_angles = vec2(direction_inner.w, color_outer.w);
+    return light;
+}
+
+// The shadow maps (see "systems/shadow-maps.hpp")
+// The directional light uses cascades (layers of "shadow_cascades") picked by the view depth of the fragment,
+// and the spot lights use tiles of "shadow_atlas" (the tile of a light is its shadow index)
+uniform sampler2DArrayShadow shadow_cascades;
+uniform sampler2DShadow shadow_atlas;
+uniform int shadow_cascade_count;
+uniform float shadow_cascade_splits[4];      // The view depth where each cascade ends
+uniform float shadow_cascade_texels[4];      // The size of a texel of each cascade in the world
+uniform mat4 shadow_cascade_matrices[4];     // From the world space to the texture space of each cascade
+uniform mat4 shadow_spot_matrices[16];       // From the world space to the texture space of each tile of the atlas
+uniform float shadow_spot_texel;             // The size of a texel of a spot shadow map at a distance of 1 from the light
+
+// Returns how much of the light reaches the fragment (0: fully in shadow, 1: fully lit)
+float compute_shadow(Light light, vec3 world, vec3 normal, float depth) {
+    if(light.shadow < 0) return 1.0;
+    // Sampling with 4 offsets gives a softer edge (each sample is already a bilinear 2x2 comparison)
+    vec2 offsets[4] = vec2[](vec2(-0.5, -0.5), vec2(0.5, -0.5), vec2(-0.5, 0.5), vec2(0.5, 0.5));
+    float lit = 0.0;
+    if(light.type == DIRECTIONAL){
+        for(int i = 0; i < shadow_cascade_count; i++){
+            if(depth > shadow_cascade_splits[i]) continue;
+            // Push the point along the normal by a texel or so to avoid shadow acne
+            vec3 coord = (shadow_cascade_matrices[i] * vec4(world + normal * (1.5 * shadow_cascade_texels[i]), 1.0)).xyz;
+            vec2 texel = 1.0 / vec2(textureSize(shadow_cascades, 0).xy);
+            for(int k = 0; k < 4; k++) lit += texture(shadow_cascades, vec4(coord.xy + offsets[k] * texel, float(i), coord.z));
+            return lit * 0.25;
+        }
+        return 1.0;
+    }
+    float distance_to_light = length(light.position - world);
+    vec4 coord = shadow_spot_matrices[light.shadow] * vec4(world + normal * (1.5 * shadow_spot_texel * distance_to_light), 1.0);
+    coord.xyz /= coord.w;
+    if(coord.w <= 0.0 || coord.z > 1.0) return 1.0;
+    vec2 texel = 1.0 / vec2(textureSize(shadow_atlas, 0));
+    for(int k = 0; k < 4; k++) lit += texture(shadow_atlas, vec3(coord.xy + offsets[k] * texel, coord.z));
+    return lit * 0.25;
+}
+
+struct Sky {
+    vec3 top, horizon, bottom;
+};
+
+uniform Sky sky;
+
+vec3 compute_sky_light(vec3 normal){
+    vec3 extreme = normal.y > 0 ? sky.top : sky.bottom;
+    return mix(sky.horizon, extreme, normal.y * normal.y);
+}
+
+float lambert(vec3 normal, vec3 world_to_light_direction) {
+    return max(0.0, dot(normal, world_to_light_direction));
+}
+
+float phong(vec3 reflected, vec3 view, float shininess) {
+    return pow(max(0.0, dot(reflected, view)), shininess);
+}
+
+// Computes the diffuse & specular light reflected by the fragment from the given light
+vec3 compute_light(Light light, vec3 world, vec3 normal, vec3 view, vec3 diffuse, vec3 specular, float shininess) {
+    vec3 world_to_light_dir;
+    float attenuation = 1.0;
+    if(light.type == DIRECTIONAL){
+        world_to_light_dir = -light.direction;
+    } else {
+        world_to_light_dir = light.position - world;
+        float d = length(world_to_light_dir);
+        world_to_light_dir /= d;
+        attenuation = 1.0 / dot(light.attenuation, vec3(d*d, d, 1.0));
+        if(light.type == SPOT){
+            float angle = acos(dot(light.direction, -world_to_light_dir));
+            attenuation *= smoothstep(light.cone_angles.y, light.cone_angles.x, angle);
+        }
+    }
+
+    vec3 computed_diffuse = light.color * diffuse * lambert(normal, world_to_light_dir);
+
+    vec3 reflected = reflect(-world_to_light_dir, normal);
+    vec3 computed_specular = light.color * specular * phong(reflected, view, shininess);
+
+    return (computed_diffuse + computed_specular) * attenuation;
+}
+
+// Sums the light reflected by the fragment from all the lights that reach it (the global lights & the lights of its cluster)
+// "depth" is the view depth of the fragment (used to find its cluster & its shadow cascade)
+vec3 compute_lights(vec3 world, vec3 normal, vec3 view, float depth, vec3 diffuse, vec3 specular, float shininess) {
+    vec3 color = vec3(0.0);
+    for(int light_idx = 0; light_idx < global_light_count; light_idx++){
+        Light light = fetch_light(light_idx);
+        color += compute_light(light, world, normal, view, diffuse, specular, shininess) * compute_shadow(light, world, normal, depth);
+    }
+
+    // Find the cluster of this fragment: the screen tile from the pixel position & the depth slice from the view depth
+    ivec3 cluster = ivec3(ivec2(gl_FragCoord.xy / cluster_tile_size), int(log(depth / cluster_near) * cluster_depth_scale));
+    cluster = clamp(cluster, ivec3(0), cluster_count - 1);
+    uvec2 cluster_lights = texelFetch(light_clusters, light_offsets.y + cluster.x + cluster_count.x * (cluster.y + cluster_count.y * cluster.z)).rg;
+    for(uint i = 0u; i < cluster_lights.y; i++){
+        Light light = fetch_light(int(texelFetch(light_indices, light_offsets.z + int(cluster_lights.x + i)).r));
+        color += compute_light(light, world, normal, view, diffuse, specular, shininess) * compute_shadow(light, world, normal, depth);
+    }
+    return color;
+}
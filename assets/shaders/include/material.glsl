@@ -0,0 +1,60 @@
+// The textures of the lighted materials (see "LightMaterial" in "material.hpp")
+// The fragment shaders read them through the "sample_*" functions so they don't depend on where the textures are:
+//  - Normally, each texture is bound to its own texture unit and the optional ones are only read if their feature is defined
+//  - With "BATCHED", the textures of all the materials in the batch are layers of one texture array and the layers of the
+//    material of each instance come from the vertex shader (see "lighted.vert"). A layer of -1 means that there is no texture.
+
+#ifdef BATCHED
+
+uniform sampler2DArray material_textures;
+
+flat in vec4 material_layers;   // The layers of the albedo, the specular, the roughness & the ambient occlusion
+flat in vec2 material_emissive; // The layer of the emissive texture & its intensity
+
+vec3 sample_albedo(vec2 tex_coord) { return texture(material_textures, vec3(tex_coord, material_layers.x)).rgb; }
+vec3 sample_specular(vec2 tex_coord) { return texture(material_textures, vec3(tex_coord, material_layers.y)).rgb; }
+float sample_roughness(vec2 tex_coord) { return texture(material_textures, vec3(tex_coord, material_layers.z)).r; }
+float sample_ambient_occlusion(vec2 tex_coord) {
+    return material_layers.w < 0.0 ? 1.0 : texture(material_textures, vec3(tex_coord, material_layers.w)).r;
+}
+vec3 sample_emissive(vec2 tex_coord) {
+    return material_emissive.x < 0.0 ? vec3(0.0) : texture(material_textures, vec3(tex_coord, material_emissive.x)).rgb * material_emissive.y;
+}
+
+#else
+
+struct Material {
+    sampler2D albedo;
+    sampler2D specular;
+    sampler2D roughness;
+    // The optional textures are only read if their feature is defined (see "shader-variants.hpp")
+#ifdef AMBIENT_OCCLUSION
+    sampler2D ambient_occlusion;
+#endif
+#ifdef EMISSIVE
+    sampler2D emissive;
+    float emissive_intensity;
+#endif
+};
+
+uniform Material material;
+
+vec3 sample_albedo(vec2 tex_coord) { return texture(material.albedo, tex_coord).rgb; }
+vec3 sample_specular(vec2 tex_coord) { return texture(material.specular, tex_coord).rgb; }
+float sample_roughness(vec2 tex_coord) { return texture(material.roughness, tex_coord).r; }
+float sample_ambient_occlusion(vec2 tex_coord) {
+#ifdef AMBIENT_OCCLUSION
+    return texture(material.ambient_occlusion, tex_coord).r;
+#else
+    return 1.0;
+#endif
+}
+vec3 sample_emissive(vec2 tex_coord) {
+#ifdef EMISSIVE
+    return texture(material.emissive, tex_coord).rgb * material.emissive_intensity;
+#else
+    return vec3(0.0);
+#endif
+}
+
+#endif
@@ -11,10 +11,23 @@ uniform mat4 VP;
 
 // bnb3t el camera position 34an  a3rf mkan el object fen fl world blnesba lel camera
 uniform vec3 camera_position;
+
+#ifdef BATCHED
+// The instances of a batch are drawn in one call (see "systems/material-batches.hpp"). The data of each instance is read from
+// "instance_data" (9 texels per instance, starting from the texel "instance_offset"): the model matrix, its inverse transpose
+// (3 texels) then the material layers & the emissive layer & intensity which are passed to the fragment shader
+// (see "include/material.glsl")
+uniform samplerBuffer instance_data;
+uniform int instance_offset;
+
+flat out vec4 material_layers;
+flat out vec2 material_emissive;
+#else
 uniform mat4 M;
 
 // model inverse transpose, da 34an lama agy a3ml scale lel object, el normals hya kaman by7slhash scale
 uniform mat4 M_IT;
+#endif
 
 out Varyings {
     vec4 color;
@@ -24,7 +37,19 @@ out Varyings {
     vec3 world;
 } vs_out;
 
+// The depth pre-pass computes the position using the same operations (see "depth-only.vert"), this guarantees it gets the same depth
+invariant gl_Position;
+
 void main() {
+#ifdef BATCHED
+    int base = instance_offset + 9 * gl_InstanceID;
+    mat4 M = mat4(texelFetch(instance_data, base), texelFetch(instance_data, base + 1),
+                  texelFetch(instance_data, base + 2), texelFetch(instance_data, base + 3));
+    mat4 M_IT = mat4(texelFetch(instance_data, base + 4), texelFetch(instance_data, base + 5),
+                     texelFetch(instance_data, base + 6), vec4(0.0, 0.0, 0.0, 1.0));
+    material_layers = texelFetch(instance_data, base + 7);
+    material_emissive = texelFetch(instance_data, base + 8).xy;
+#endif
     // b3rf el world 3n tre2 el M matrix
     vec3 world = (M * vec4(position, 1.0)).xyz;
     gl_Position = VP * vec4(world, 1.0);
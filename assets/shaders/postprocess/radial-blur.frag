@@ -16,6 +16,7 @@ void main(){
     // To apply radial blur, we compute the direction outward from the center to the current pixel
     vec2 step_vector = (tex_coord - 0.5) * (STRENGTH / STEPS);
     // Then we sample multiple pixels along that direction and compute the average
+    frag_color = vec4(0.0);
     for(int i = 0; i < STEPS; i++){
         frag_color += texture(tex, tex_coord + step_vector * i);    
     }
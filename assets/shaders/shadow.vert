@@ -0,0 +1,17 @@
+#version 330
+
+// This shader draws the depth of the shadow casters to the shadow maps (see "systems/shadow-maps.hpp")
+// The casters are drawn instanced: the model matrix of each instance is read from "instance_matrices" (4 texels per matrix)
+// starting from the texel "instance_offset"
+layout(location = 0) in vec3 position;
+
+uniform samplerBuffer instance_matrices;
+uniform int instance_offset;
+uniform mat4 light_VP;
+
+void main() {
+    int base = instance_offset + 4 * gl_InstanceID;
+    mat4 M = mat4(texelFetch(instance_matrices, base), texelFetch(instance_matrices, base + 1),
+                  texelFetch(instance_matrices, base + 2), texelFetch(instance_matrices, base + 3));
+    gl_Position = light_VP * (M * vec4(position, 1.0));
+}
@@ -24,6 +24,8 @@
 #endif
 
 #include "texture/screenshot.hpp"
+#include "shader/shader.hpp"
+#include "asset-loader.hpp"
 #include "stb/stb_image.h"
 
 
@@ -219,6 +221,18 @@ int our::Application::run(int run_for_frames) {
     std::cout << "VERSION         : " << glGetString(GL_VERSION) << std::endl;
     std::cout << "GLSL VERSION    : " << glGetString(GL_SHADING_LANGUAGE_VERSION) << std::endl;
 
+    // The linked shader programs are saved to this directory so the next runs (and the next states) don't compile them again
+    ShaderProgram::setCacheDirectory(app_config.value("shader-cache", ""));
+    // Let the driver compile the shaders on its own threads (if it can)
+    ShaderProgram::setCompilerThreads(app_config.value("shader-compiler-threads", 0xFFFFFFFFu));
+
+    // Watch the asset & config files so the shaders, textures & materials can be edited while the game is running
+    if (auto hotReload = app_config.value("hot-reload", nlohmann::json::object()); hotReload.value("enabled", false)) {
+        fileWatcher = new FileWatcher(hotReload.value("directories", std::vector<std::string>{"assets", "config"}),
+                                      hotReload.value("poll-interval", 0.5));
+        std::cout << "Hot reload is enabled" << (fileWatcher->isPolling() ? " (polling the files)" : "") << std::endl;
+    }
+
 #if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
     // if we have OpenGL debug messages enabled, set the message callback
     glDebugMessageCallback(opengl_callback, nullptr);
@@ -279,6 +293,7 @@ int our::Application::run(int run_for_frames) {
     while (!glfwWindowShouldClose(window)) {
         if (run_for_frames != 0 && current_frame >= run_for_frames)
             break;
+        frameArena.beginFrame(); // Release the transient memory allocated two frames ago
         glfwPollEvents(); // Read all the user events and call relevant callbacks.
         // Start a new ImGui frame
         ImGui_ImplOpenGL3_NewFrame();
@@ -353,6 +368,12 @@ int our::Application::run(int run_for_frames) {
         keyboard.update();
         mouse.update();
 
+        // Reload the assets whose files changed (between two frames so a frame never sees half of a reload)
+        if (fileWatcher) {
+            if (auto changed = fileWatcher->poll(); !changed.empty())
+                reloadAssets(changed);
+        }
+
         // If a scene change was requested, apply it
         while (nextState) {
             // If a scene was already running, destroy it (not delete since we can go back to it later)
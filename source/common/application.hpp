@@ -12,6 +12,8 @@
 
 #include "input/keyboard.hpp"
 #include "input/mouse.hpp"
+#include "frame-arena.hpp"
+#include "file-watcher.hpp"
 
 #define USE_SOUND
 
@@ -75,6 +77,10 @@ namespace our
 
         nlohmann::json app_config; // A Json file that contains all application configuration
 
+        FrameArena frameArena; // The allocator for the transient data of each frame (it is reset at the start of every frame)
+
+        FileWatcher *fileWatcher = nullptr; // Watches the asset & config files to reload them while running (if "hot-reload" is enabled)
+
         std::unordered_map<std::string, State *> states; // This will store all the states that the application can run
         State *currentState = nullptr;                   // This will store the current scene that is being run
         State *nextState = nullptr;                      // If it is requested to go to another scene, this will contain a pointer to that scene
@@ -94,13 +100,16 @@ namespace our
         int heartCount = 3;
 
         // Create an application with following configuration
-        Application(const nlohmann::json &app_config) : app_config(app_config) {}
+        // The initial size of the frame arena can be set using "frame-arena-size" (in bytes) in the config
+        Application(const nlohmann::json &app_config)
+            : app_config(app_config), frameArena(app_config.value("frame-arena-size", size_t(1) << 20)) {}
 
         // On destruction, delete all the states
         ~Application()
         {
             for (auto &it : states)
                 delete it.second;
+            delete fileWatcher;
         }
 
         // This is the main class function that run the whole application (Initialize, Game loop, House cleaning).
@@ -155,6 +164,8 @@ namespace our
 
         [[nodiscard]] const nlohmann::json &getConfig() const { return app_config; }
 
+        FrameArena &getFrameArena() { return frameArena; }
+
         // Get the size of the frame buffer of the window in pixels.
         glm::ivec2 getFrameBufferSize()
         {
@@ -1,34 +1,86 @@
 #include "asset-loader.hpp"
 
 #include "shader/shader.hpp"
+#include "shader/shader-variants.hpp"
 #include "texture/texture2d.hpp"
+#include "texture/texture-array.hpp"
 #include "texture/texture-utils.hpp"
 #include "texture/sampler.hpp"
 #include "mesh/mesh.hpp"
 #include "mesh/mesh-utils.hpp"
 #include "material/material.hpp"
 #include "deserialize-utils.hpp"
+#include "config-utils.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <map>
 
 namespace our {
 
+    // Where the assets came from, so "reloadAssets" can find the assets affected by a changed file
+    // (the paths are normalized like the ones reported by the file watcher)
+    static std::unordered_map<std::string, std::string> textureFiles;  // The image file of each texture
+    static std::unordered_map<std::string, std::string> materialTypes; // The type of each material
+    static std::unordered_map<std::string, std::string> groupFiles;    // The file of each asset group that isn't written inline
+    static nlohmann::json textureArrayOptions;                         // The options of the texture arrays (if they were packed)
+
+    static std::string normalizePath(const std::string& path){
+        return std::filesystem::path(path).lexically_normal().generic_string();
+    }
+
+    // Remembers the file of the asset group (if it is given as a path) then resolves the group
+    static nlohmann::json resolveGroup(const nlohmann::json& assetData, const std::string& group){
+        if(assetData[group].is_string())
+            groupFiles[group] = normalizePath(assetData[group].get<std::string>());
+        return resolveConfig(assetData[group]);
+    }
+    static nlohmann::json resolveGroup(const nlohmann::json& assetData, const std::string& group,
+                                       const std::unordered_set<std::string>& keys){
+        if(assetData[group].is_string())
+            groupFiles[group] = normalizePath(assetData[group].get<std::string>());
+        return resolveConfig(assetData[group], keys);
+    }
+
     // This will load all the shaders defined in "data"
     // data must be in the form:
     //    { shader_name : { "vs" : "path/to/vertex-shader", "fs" : "path/to/fragment-shader" }, ... }
+    // A shader can also have a list of "defines" (e.g. ["MAX_LIGHTS 16"]) added to its source
+    // The shaders that have "features" are loaded as shader variants instead (see below)
+    // The driver compiles the shaders while the other assets are loaded, each shader is finished when it is first used
     template<>
     void AssetLoader<ShaderProgram>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
+                if(desc.contains("features")) continue;
                 std::string vsPath = desc.value("vs", "");
                 std::string fsPath = desc.value("fs", "");
+                auto defines = desc.value("defines", std::vector<std::string>());
                 auto shader = new ShaderProgram();
-                shader->attach(vsPath, GL_VERTEX_SHADER);
-                shader->attach(fsPath, GL_FRAGMENT_SHADER);
-                shader->link();
+                shader->attach(vsPath, GL_VERTEX_SHADER, defines);
+                shader->attach(fsPath, GL_FRAGMENT_SHADER, defines);
+                shader->startLink();
                 assets[name] = shader;
             }
         }
     };
 
+    // This will load the shaders defined in "data" that have "features" (the same data as the shader programs)
+    //    { shader_name : { "vs" : "...", "fs" : "...", "features": ["EMISSIVE", ...] }, ... }
+    // Nothing is compiled here, the materials request the variants they need (see "Material::deserialize")
+    template<>
+    void AssetLoader<ShaderVariants>::deserialize(const nlohmann::json& data) {
+        if(data.is_object()){
+            for(auto& [name, desc] : data.items()){
+                if(!desc.contains("features")) continue;
+                assets[name] = new ShaderVariants(desc.value("vs", ""), desc.value("fs", ""),
+                                                  desc["features"].get<std::vector<std::string>>(),
+                                                  desc.value("defines", std::vector<std::string>()));
+            }
+        }
+    };
+
     // This will load all the textures defined in "data"
     // data must be in the form:
     //    { texture_name : "path/to/image", ... }
@@ -38,6 +90,7 @@ namespace our {
             for(auto& [name, desc] : data.items()){
                 std::string path = desc.get<std::string>();
                 assets[name] = texture_utils::loadImage(path);
+                textureFiles[name] = normalizePath(path);
             }
         }
     };
@@ -63,12 +116,16 @@ namespace our {
     // This will load all the meshes defined in "data"
     // data must be in the form:
     //    { mesh_name : "path/to/3d-model-file", ... }
+    // A mesh can also be an object to generate levels of detail for it:
+    //    { mesh_name : { "path": "path/to/3d-model-file", "lods": 3 }, ... }
     template<>
     void AssetLoader<Mesh>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
             for(auto& [name, desc] : data.items()){
-                std::string path = desc.get<std::string>();
-                assets[name] = mesh_utils::loadOBJ(path);
+                if(desc.is_object())
+                    assets[name] = mesh_utils::loadOBJ(desc.value("path", ""), desc.value("lods", 0));
+                else
+                    assets[name] = mesh_utils::loadOBJ(desc.get<std::string>());
             }
         }
     };
@@ -93,30 +150,289 @@ namespace our {
                 auto material = createMaterialFromType(type);
                 material->deserialize(desc);
                 assets[name] = material;
+                materialTypes[name] = type;
+            }
+        }
+    };
+
+    // This will pack the textures of the loaded lighted materials into texture arrays, so the renderers can draw many materials
+    // in one instanced batch with a single texture binding (see "systems/material-batches.hpp")
+    // data must be in the form:
+    //    { "layer-size": 1024 }
+    // The textures are grouped by their size and each group becomes an array named after its size (e.g. "512x512").
+    // Only the opaque materials whose shader has the "BATCHED" feature are packed, and only if all their textures have the
+    // same size. If "layer-size" is given, it is the largest size of a layer: the textures bigger than it are scaled down to it
+    // (so the big textures end up in the same array) and a material with textures of different sizes is packed at the size of
+    // its largest texture. The smaller textures keep their size. The arrays that were packed before are replaced, so it must be called after all the materials are loaded.
+    template<>
+    void AssetLoader<TextureArray>::deserialize(const nlohmann::json& data) {
+        if(!data.is_object()) return;
+        int layerSize = data.value("layer-size", 0);
+        GLint maxLayers = 0;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+        // The materials are visited in the order of their names so the layers are the same in every run
+        std::vector<LightMaterial*> materials;
+        std::vector<std::string> names;
+        for(auto& [name, type] : materialTypes) names.push_back(name);
+        std::sort(names.begin(), names.end());
+        for(auto& name : names){
+            if(auto material = dynamic_cast<LightMaterial*>(AssetLoader<Material>::get(name))){
+                material->textureArray = nullptr;
+                std::fill(std::begin(material->layers), std::end(material->layers), -1);
+                materials.push_back(material);
             }
         }
+        clear();
+
+        struct Group {
+            std::vector<Texture2D*> textures;
+            std::vector<LightMaterial*> materials;
+        };
+        std::map<std::pair<int, int>, Group> groups;
+        std::unordered_map<Texture2D*, glm::ivec2> sizes;
+        for(auto material : materials){
+            if(material->transparent || !material->variants || !material->variants->hasFeature("BATCHED")) continue;
+            if(!material->albedo || !material->specular || !material->roughness || !material->sampler) continue;
+            // The textures in the order of their texture units (see "LightMaterial::bindTextures")
+            Texture2D* textures[5] = {material->albedo, material->specular, material->emissive, material->roughness,
+                                      material->ambient_occlusion};
+            bool mixed = false;
+            glm::ivec2 size(0), largest(0);
+            for(auto texture : textures){
+                if(!texture) continue;
+                if(!sizes.count(texture)) sizes[texture] = texture_utils::getSize(texture);
+                if(size.x == 0) size = sizes[texture];
+                else if(sizes[texture] != size) mixed = true;
+                largest = glm::max(largest, sizes[texture]);
+            }
+            if(layerSize > 0){
+                size = glm::min(largest, glm::ivec2(layerSize));
+                mixed = false;
+            }
+            if(mixed || size.x <= 0 || size.y <= 0) continue;
+            auto& group = groups[{size.x, size.y}];
+            for(int unit = 0; unit < 5; ++unit){
+                if(!textures[unit]) continue;
+                auto it = std::find(group.textures.begin(), group.textures.end(), textures[unit]);
+                material->layers[unit] = GLint(it - group.textures.begin());
+                if(it == group.textures.end()) group.textures.push_back(textures[unit]);
+            }
+            group.materials.push_back(material);
+        }
+
+        for(auto& [size, group] : groups){
+            if(GLint(group.textures.size()) > maxLayers){
+                std::cerr << "The " << size.first << "x" << size.second << " textures don't fit in one texture array ("
+                          << group.textures.size() << " layers), they are not packed" << std::endl;
+                for(auto material : group.materials)
+                    std::fill(std::begin(material->layers), std::end(material->layers), -1);
+                continue;
+            }
+            auto array = texture_utils::packLayers(group.textures, glm::ivec2(size.first, size.second));
+            assets[std::to_string(size.first) + "x" + std::to_string(size.second)] = array;
+            for(auto material : group.materials)
+                material->textureArray = array;
+        }
     };
 
+    void collectAssetDependencies(const nlohmann::json& entities, AssetDependencies& dependencies,
+                                  const nlohmann::json& prefabs){
+        if(!entities.is_array()) return;
+        for(auto& entity : entities){
+            if(entity.contains("prefab") && prefabs.is_object()){
+                std::string prefab = entity["prefab"].get<std::string>();
+                if(prefabs.contains(prefab))
+                    collectAssetDependencies(nlohmann::json::array({prefabs[prefab]}), dependencies, prefabs);
+            }
+            if(entity.contains("components") && entity["components"].is_array()){
+                for(auto& component : entity["components"]){
+                    if(component.value("type", "") != "Mesh Renderer") continue;
+                    if(component.contains("mesh")) dependencies.meshes.insert(component["mesh"].get<std::string>());
+                    if(component.contains("material")) dependencies.materials.insert(component["material"].get<std::string>());
+                }
+            }
+            if(entity.contains("children"))
+                collectAssetDependencies(entity["children"], dependencies, prefabs);
+        }
+    }
+
+    void collectMaterialDependencies(const nlohmann::json& materials, AssetDependencies& dependencies){
+        if(!materials.is_object()) return;
+        // These are all the keys used by the material types to refer to other assets (see "material.cpp")
+        static const char* textureKeys[] = {"texture", "albedo", "specular", "roughness", "ambient_occlusion", "emissive"};
+        for(auto& [name, desc] : materials.items()){
+            if(desc.contains("shader")) dependencies.shaders.insert(desc["shader"].get<std::string>());
+            for(auto key : textureKeys)
+                if(desc.contains(key)) dependencies.textures.insert(desc[key].get<std::string>());
+            if(desc.contains("sampler")) dependencies.samplers.insert(desc["sampler"].get<std::string>());
+        }
+    }
+
     void deserializeAllAssets(const nlohmann::json& assetData){
         if(!assetData.is_object()) return;
-        if(assetData.contains("shaders"))
-            AssetLoader<ShaderProgram>::deserialize(assetData["shaders"]);
+        if(assetData.contains("shaders")){
+            auto shaders = resolveGroup(assetData, "shaders");
+            AssetLoader<ShaderProgram>::deserialize(shaders);
+            AssetLoader<ShaderVariants>::deserialize(shaders);
+        }
         if(assetData.contains("textures"))
-            AssetLoader<Texture2D>::deserialize(assetData["textures"]);
+            AssetLoader<Texture2D>::deserialize(resolveGroup(assetData, "textures"));
         if(assetData.contains("samplers"))
-            AssetLoader<Sampler>::deserialize(assetData["samplers"]);
+            AssetLoader<Sampler>::deserialize(resolveGroup(assetData, "samplers"));
         if(assetData.contains("meshes"))
-            AssetLoader<Mesh>::deserialize(assetData["meshes"]);
+            AssetLoader<Mesh>::deserialize(resolveGroup(assetData, "meshes"));
         if(assetData.contains("materials"))
-            AssetLoader<Material>::deserialize(assetData["materials"]);
+            AssetLoader<Material>::deserialize(resolveGroup(assetData, "materials"));
+        if(assetData.contains("texture-arrays")){
+            textureArrayOptions = resolveConfig(assetData["texture-arrays"]);
+            AssetLoader<TextureArray>::deserialize(textureArrayOptions);
+        }
+    }
+
+    void deserializeAssets(const nlohmann::json& assetData, AssetDependencies dependencies){
+        if(!assetData.is_object()) return;
+        // The materials are read first since they tell us which shaders, textures & samplers are needed
+        nlohmann::json materials;
+        if(assetData.contains("materials")){
+            materials = resolveGroup(assetData, "materials", dependencies.materials);
+            collectMaterialDependencies(materials, dependencies);
+        }
+        // Then the other groups are loaded in the same order as "deserializeAllAssets"
+        if(assetData.contains("shaders")){
+            auto shaders = resolveGroup(assetData, "shaders", dependencies.shaders);
+            AssetLoader<ShaderProgram>::deserialize(shaders);
+            AssetLoader<ShaderVariants>::deserialize(shaders);
+        }
+        if(assetData.contains("textures"))
+            AssetLoader<Texture2D>::deserialize(resolveGroup(assetData, "textures", dependencies.textures));
+        if(assetData.contains("samplers"))
+            AssetLoader<Sampler>::deserialize(resolveGroup(assetData, "samplers", dependencies.samplers));
+        if(assetData.contains("meshes"))
+            AssetLoader<Mesh>::deserialize(resolveGroup(assetData, "meshes", dependencies.meshes));
+        AssetLoader<Material>::deserialize(materials);
+        if(assetData.contains("texture-arrays")){
+            textureArrayOptions = resolveConfig(assetData["texture-arrays"]);
+            AssetLoader<TextureArray>::deserialize(textureArrayOptions);
+        }
+    }
+
+    // Returns the shaders, textures & samplers referred to by the materials that aren't loaded
+    static AssetDependencies findMissingDependencies(const nlohmann::json& materials){
+        AssetDependencies needed, missing;
+        collectMaterialDependencies(materials, needed);
+        for(auto& name : needed.shaders)
+            if(!AssetLoader<ShaderProgram>::get(name) && !AssetLoader<ShaderVariants>::get(name)) missing.shaders.insert(name);
+        for(auto& name : needed.textures)
+            if(!AssetLoader<Texture2D>::get(name)) missing.textures.insert(name);
+        for(auto& name : needed.samplers)
+            if(!AssetLoader<Sampler>::get(name)) missing.samplers.insert(name);
+        return missing;
+    }
+
+    // Loads the shaders, textures & samplers that the materials need and that the level didn't load
+    // (only the groups that came from a file can be read again)
+    static void loadMissingDependencies(const nlohmann::json& materials){
+        AssetDependencies missing = findMissingDependencies(materials);
+        if(!missing.shaders.empty() && groupFiles.count("shaders")){
+            auto shaders = resolveConfig(nlohmann::json(groupFiles["shaders"]), missing.shaders);
+            AssetLoader<ShaderProgram>::deserialize(shaders);
+            AssetLoader<ShaderVariants>::deserialize(shaders);
+        }
+        if(!missing.textures.empty() && groupFiles.count("textures"))
+            AssetLoader<Texture2D>::deserialize(resolveConfig(nlohmann::json(groupFiles["textures"]), missing.textures));
+        if(!missing.samplers.empty() && groupFiles.count("samplers"))
+            AssetLoader<Sampler>::deserialize(resolveConfig(nlohmann::json(groupFiles["samplers"]), missing.samplers));
+    }
+
+    void reloadAssets(const std::vector<std::string>& changedFiles){
+        std::unordered_set<std::string> changed;
+        for(auto& file : changedFiles) changed.insert(normalizePath(file));
+        auto groupChanged = [&](const std::string& group){
+            auto it = groupFiles.find(group);
+            return it != groupFiles.end() && changed.count(it->second) != 0;
+        };
+        int shaders = 0, textures = 0, samplers = 0, materials = 0;
+
+        // Every shader program using a changed file is rebuilt (including the ones owned by the renderer)
+        shaders = ShaderProgram::reloadChanged(changedFiles);
+
+        // The textures are loaded again in the same texture objects so the materials still point to them
+        // If the textures group changed, a texture may now point to another image
+        if(groupChanged("textures")){
+            nlohmann::json data = parseConfigFile(groupFiles["textures"]);
+            if(data.is_object())
+                for(auto& [name, desc] : data.items())
+                    if(textureFiles.count(name) && desc.is_string() && normalizePath(desc.get<std::string>()) != textureFiles[name]){
+                        textureFiles[name] = normalizePath(desc.get<std::string>());
+                        changed.insert(textureFiles[name]);
+                    }
+        }
+        for(auto& [name, path] : textureFiles){
+            auto texture = AssetLoader<Texture2D>::get(name);
+            if(texture && changed.count(path) && texture_utils::loadImage(texture, path))
+                ++textures;
+        }
+
+        if(groupChanged("samplers")){
+            nlohmann::json data = parseConfigFile(groupFiles["samplers"]);
+            if(data.is_object())
+                for(auto& [name, desc] : data.items())
+                    if(auto sampler = AssetLoader<Sampler>::get(name)){
+                        sampler->deserialize(desc);
+                        ++samplers;
+                    }
+        }
+
+        // The materials are deserialized again in place (only the materials that were loaded are updated)
+        // The assets they now refer to are loaded first, and a material that refers to an asset that doesn't exist
+        // keeps its last values (instead of drawing with a missing texture)
+        if(groupChanged("materials")){
+            nlohmann::json data = parseConfigFile(groupFiles["materials"]);
+            nlohmann::json loaded = nlohmann::json::object();
+            if(data.is_object())
+                for(auto& [name, desc] : data.items())
+                    if(AssetLoader<Material>::get(name)) loaded[name] = desc;
+            loadMissingDependencies(loaded);
+            for(auto& [name, desc] : loaded.items()){
+                auto material = AssetLoader<Material>::get(name);
+                if(desc.value("type", "") != materialTypes[name]){
+                    std::cerr << "The type of the material \"" << name << "\" can't be changed while running" << std::endl;
+                    continue;
+                }
+                AssetDependencies missing = findMissingDependencies(nlohmann::json::object({{name, desc}}));
+                if(!missing.shaders.empty() || !missing.textures.empty() || !missing.samplers.empty()){
+                    std::cerr << "The material \"" << name << "\" refers to assets that don't exist, it isn't reloaded" << std::endl;
+                    continue;
+                }
+                // The pipeline state is only read if the data has it, so it is reset in case it was removed
+                material->pipelineState = PipelineState();
+                material->deserialize(desc);
+                ++materials;
+            }
+        }
+
+        // The texture arrays hold copies of the textures, so they are packed again if a texture or a material changed
+        if((textures > 0 || materials > 0) && textureArrayOptions.is_object())
+            AssetLoader<TextureArray>::deserialize(textureArrayOptions);
+
+        if(shaders + textures + samplers + materials > 0)
+            std::cout << "Reloaded " << shaders << " shaders, " << textures << " textures, " << samplers << " samplers & "
+                      << materials << " materials" << std::endl;
     }
 
     void clearAllAssets(){
         AssetLoader<ShaderProgram>::clear();
+        AssetLoader<ShaderVariants>::clear();
         AssetLoader<Texture2D>::clear();
         AssetLoader<Sampler>::clear();
         AssetLoader<Mesh>::clear();
         AssetLoader<Material>::clear();
+        AssetLoader<TextureArray>::clear();
+        textureFiles.clear();
+        materialTypes.clear();
+        groupFiles.clear();
+        textureArrayOptions = nullptr;
     }
 
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
+#include <vector>
 #include <json/json.hpp>
 
 namespace our {
@@ -41,11 +43,39 @@ namespace our {
         }
     };
 
+    // This struct holds the names of the assets needed by a level (grouped by the asset type)
+    struct AssetDependencies {
+        std::unordered_set<std::string> shaders, textures, samplers, meshes, materials;
+    };
+
+    // Scans a json array of entities (in the form read by "World::deserialize") including their children
+    // and adds the meshes & materials used by their mesh renderers to "dependencies"
+    // If an entity is instantiated from a prefab, the prefab (found in the "prefabs" json object) is scanned too
+    void collectAssetDependencies(const nlohmann::json& entities, AssetDependencies& dependencies,
+                                  const nlohmann::json& prefabs = nlohmann::json::object());
+    // Scans a json object of materials (in the form read by "AssetLoader<Material>::deserialize")
+    // and adds the shaders, textures & samplers they use to "dependencies"
+    void collectMaterialDependencies(const nlohmann::json& materials, AssetDependencies& dependencies);
+
     // Given a json holding the data for all the assets
     // This function will call "AssetLoader<T>::deserialize" for all the different asset types T
     // For example, a json in the form {"shaders": ... , "textures": ... } will call "deserialize" for:
-    // AssetLoader<ShaderProgram> and AssetLoader<Texture2D>
+    // AssetLoader<ShaderProgram> and AssetLoader<Texture2D> (the shaders group is also read by AssetLoader<ShaderVariants>)
+    // The "texture-arrays" object (if any) is given to AssetLoader<TextureArray> after the materials are loaded
+    // Each asset group can be written inline or given as a path to a json document holding the group (see "config-utils.hpp")
     void deserializeAllAssets(const nlohmann::json& assetData);
+    // Same as "deserializeAllAssets" but only loads the meshes & materials in "dependencies"
+    // and the shaders, textures & samplers used by these materials
+    // Groups given as paths are parsed such that the assets that are not needed are skipped while parsing
+    void deserializeAssets(const nlohmann::json& assetData, AssetDependencies dependencies);
+    // Updates the loaded assets that depend on the given files (e.g. reported by a "FileWatcher") without replacing them,
+    // so everything pointing to the assets keeps working:
+    // - The shader programs using a changed file (or including it) are compiled again (see "ShaderProgram::reloadChanged")
+    // - The textures whose image changed are loaded again
+    // - If the file of the textures, samplers or materials group changed, the loaded assets of the group are read again
+    // - The texture arrays are packed again if a texture or a material changed
+    // It should be called between two frames
+    void reloadAssets(const std::vector<std::string>& changedFiles);
     // This will call "AssetLoader<T>::clear" for all the different asset types T
     void clearAllAssets();
 }
\ No newline at end of file
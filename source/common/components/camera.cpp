@@ -1,5 +1,6 @@
 #include "camera.hpp"
 #include "../ecs/entity.hpp"
+#include "../serialize-utils.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -80,4 +81,24 @@ namespace our
         }
         return P;
     }
+
+    // Writes the camera parameters in binary form
+    void CameraComponent::writeBinary(ByteWriter &writer) const
+    {
+        writer.write(cameraType);
+        writer.write(near);
+        writer.write(far);
+        writer.write(fovY);
+        writer.write(orthoHeight);
+    }
+
+    // Reads the camera parameters in the same order they were written
+    void CameraComponent::readBinary(ByteReader &reader)
+    {
+        reader.read(cameraType);
+        reader.read(near);
+        reader.read(far);
+        reader.read(fovY);
+        reader.read(orthoHeight);
+    }
 }
\ No newline at end of file
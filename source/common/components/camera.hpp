@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../ecs/component.hpp"
+#include "../ecs/component-pool.hpp"
 
 #include <glm/mat4x4.hpp>
 
@@ -14,7 +14,7 @@ namespace our {
 
     // This component denotes that any renderer should draw the scene relative to this camera.
     // We do not define the eye, center or up here since they can be extracted from the entity local to world matrix
-    class CameraComponent : public Component {
+    class CameraComponent : public PooledComponent<CameraComponent> {
     public:
         CameraType cameraType; // The type of the camera
         float near, far; // The distance from the camera center to the near and far plane
@@ -23,9 +23,14 @@ namespace our {
 
         // The ID of this component type is "Camera"
         static std::string getID() { return "Camera"; }
+        std::string getTypeID() const override { return getID(); }
+        Component *clone() const override { return new CameraComponent(*this); }
 
         // Reads camera parameters from the given json object
         void deserialize(const nlohmann::json& data) override;
+        // Writes & reads the component data in binary form (see "serialize-utils.hpp")
+        void writeBinary(ByteWriter &writer) const override;
+        void readBinary(ByteReader &reader) override;
 
         // Creates and returns the camera view matrix
         glm::mat4 getViewMatrix() const;
@@ -1,6 +1,7 @@
 #include "collision.hpp"
 #include "../ecs/entity.hpp"
 #include "../deserialize-utils.hpp"
+#include "../serialize-utils.hpp"
 
 namespace our {
     // Reads linearVelocity & angularVelocity from the given json object
@@ -9,4 +10,16 @@ namespace our {
         start = data.value("start", start);
         end = data.value("end", end);
     }
+
+    // Writes the collision box (start & end) in binary form
+    void CollisionComponent::writeBinary(ByteWriter &writer) const {
+        writer.write(start);
+        writer.write(end);
+    }
+
+    // Reads the collision box in the same order it was written
+    void CollisionComponent::readBinary(ByteReader &reader) {
+        reader.read(start);
+        reader.read(end);
+    }
 }
\ No newline at end of file
@@ -20,11 +20,10 @@
 namespace our
 {
 
-    // Given a json object, this function picks and creates a component in the given entity
-    // based on the "type" specified in the json object which is later deserialized from the rest of the json object
-    inline void deserializeComponent(const nlohmann::json &data, Entity *entity)
+    // Given a component type ID, this function picks and creates a component of that type in the given entity
+    // If the type is unknown, nothing is created and a nullptr is returned
+    inline Component *createComponent(const std::string &type, Entity *entity)
     {
-        std::string type = data.value("type", "");
         Component *component = nullptr;
         // (Req 8) Add an option to deserialize a "MeshRendererComponent" to the following if-else statement
         if (type == CameraComponent::getID())
@@ -83,6 +82,15 @@ namespace our
         {                                                       // check if the type is a GemHeart renderer component
             component = entity->addComponent<GemHeartComponent>(); // add a GemHeart component to the entity
         }
+        return component;
+    }
+
+    // Given a json object, this function picks and creates a component in the given entity
+    // based on the "type" specified in the json object which is later deserialized from the rest of the json object
+    inline void deserializeComponent(const nlohmann::json &data, Entity *entity)
+    {
+        std::string type = data.value("type", "");
+        Component *component = createComponent(type, entity);
         if (component)
             component->deserialize(data);
     }
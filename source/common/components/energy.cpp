@@ -1,10 +1,19 @@
 #include "energy.hpp"
 #include "../ecs/entity.hpp"
 #include "../deserialize-utils.hpp"
+#include "../serialize-utils.hpp"
 
 namespace our {
     // Reads linearVelocity & angularVelocity from the given json object
     void EnergyComponent::deserialize(const nlohmann::json &data) {
         if (!data.is_object()) return;
     }
+
+    void EnergyComponent::writeBinary(ByteWriter &writer) const {
+        writer.write(count);
+    }
+
+    void EnergyComponent::readBinary(ByteReader &reader) {
+        reader.read(count);
+    }
 }
\ No newline at end of file
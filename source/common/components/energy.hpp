@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../ecs/component.hpp"
+#include "../ecs/component-pool.hpp"
 
 #include <glm/glm.hpp>
 
@@ -10,13 +10,21 @@ namespace our {
     // This component is added as a simple example for how use the ECS framework to implement logic.
     // For more information, see "common/systems/movement.hpp"
     // For a more complex example of how to use the ECS framework, see "free-camera-controller.hpp"
-    class EnergyComponent : public Component {
+    class EnergyComponent : public PooledComponent<EnergyComponent> {
     public:
+        // The pepsi count shown by the energy bar (-1 until it is first set)
+        // Change it through "Entity::getMutableComponent" so the collision system resizes the bar (see "CollisionSystem::observe")
+        int count = -1;
         // The ID of this component type is "Movement"
         static std::string getID() { return "Energy"; }
+        std::string getTypeID() const override { return getID(); }
+        Component *clone() const override { return new EnergyComponent(*this); }
 
         // Reads linearVelocity & angularVelocity from the given json object
         void deserialize(const nlohmann::json &data) override;
+        // Writes & reads the component data in binary form (see "serialize-utils.hpp")
+        void writeBinary(ByteWriter &writer) const override;
+        void readBinary(ByteReader &reader) override;
     };
 
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "free-camera-controller.hpp"
 #include "../ecs/entity.hpp"
 #include "../deserialize-utils.hpp"
+#include "../serialize-utils.hpp"
 
 namespace our {
     // Reads sensitivities & speedupFactor from the given json object
@@ -11,4 +12,20 @@ namespace our {
         positionSensitivity = data.value("positionSensitivity", positionSensitivity);
         speedupFactor = data.value("speedupFactor", speedupFactor);
     }
+
+    // Writes sensitivities & speedupFactor in binary form
+    void FreeCameraControllerComponent::writeBinary(ByteWriter& writer) const {
+        writer.write(rotationSensitivity);
+        writer.write(fovSensitivity);
+        writer.write(positionSensitivity);
+        writer.write(speedupFactor);
+    }
+
+    // Reads sensitivities & speedupFactor in the same order they were written
+    void FreeCameraControllerComponent::readBinary(ByteReader& reader) {
+        reader.read(rotationSensitivity);
+        reader.read(fovSensitivity);
+        reader.read(positionSensitivity);
+        reader.read(speedupFactor);
+    }
 }
\ No newline at end of file
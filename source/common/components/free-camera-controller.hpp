@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../ecs/component.hpp"
+#include "../ecs/component-pool.hpp"
 
 #include <glm/glm.hpp> 
 
@@ -11,7 +11,7 @@ namespace our {
     // This component is added as a slightly complex example for how use the ECS framework to implement logic.
     // For more information, see "common/systems/free-camera-controller.hpp"
     // For a more simple example of how to use the ECS framework, see "movement.hpp"
-    class FreeCameraControllerComponent : public Component {
+    class FreeCameraControllerComponent : public PooledComponent<FreeCameraControllerComponent> {
     public:
         // The senstivity paramter defined sensitive the camera rotation & fov is to the mouse moves and wheel scrolling
         float rotationSensitivity = 0.01f; // The angle change per pixel of mouse movement
@@ -21,9 +21,14 @@ namespace our {
 
         // The ID of this component type is "Free Camera Controller"
         static std::string getID() { return "Free Camera Controller"; }
+        std::string getTypeID() const override { return getID(); }
+        Component *clone() const override { return new FreeCameraControllerComponent(*this); }
 
         // Reads sensitivities & speedupFactor from the given json object
         void deserialize(const nlohmann::json& data) override;
+        // Writes & reads the component data in binary form (see "serialize-utils.hpp")
+        void writeBinary(ByteWriter &writer) const override;
+        void readBinary(ByteReader &reader) override;
     };
 
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "heart.hpp"
 #include "../ecs/entity.hpp"
 #include "../deserialize-utils.hpp"
+#include "../serialize-utils.hpp"
 
 namespace our {
 
@@ -8,4 +9,14 @@ namespace our {
         if (!data.is_object()) return;
         heartNumber = data.value("number", heartNumber);
     }
+
+    void HeartComponent::writeBinary(ByteWriter &writer) const {
+        writer.write(heartNumber);
+        writer.write(visible);
+    }
+
+    void HeartComponent::readBinary(ByteReader &reader) {
+        reader.read(heartNumber);
+        reader.read(visible);
+    }
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../ecs/component.hpp"
+#include "../ecs/component-pool.hpp"
 
 #include <glm/glm.hpp>
 
@@ -10,14 +10,21 @@ namespace our {
     // This component is added as a simple example for how use the ECS framework to implement logic.
     // For more information, see "common/systems/movement.hpp"
     // For a more complex example of how to use the ECS framework, see "free-camera-controller.hpp"
-    class HeartComponent : public Component {
+    class HeartComponent : public PooledComponent<HeartComponent> {
     public:
         int heartNumber = 0;
+        // Whether the heart is shown (change it through "Entity::getMutableComponent" so the heart is scaled accordingly)
+        bool visible = true;
         // The ID of this component type is "Movement"
         static std::string getID() { return "Heart"; }
+        std::string getTypeID() const override { return getID(); }
+        Component *clone() const override { return new HeartComponent(*this); }
 
         // Reads linearVelocity & angularVelocity from the given json object
         void deserialize(const nlohmann::json &data) override;
+        // Writes & reads the component data in binary form (see "serialize-utils.hpp")
+        void writeBinary(ByteWriter &writer) const override;
+        void readBinary(ByteReader &reader) override;
     };
 
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "light.hpp"
 #include "../ecs/entity.hpp"
 #include "../deserialize-utils.hpp"
+#include "../serialize-utils.hpp"
 
 namespace our
 {
@@ -28,4 +29,26 @@ namespace our
         // Read the "cone_angles" value from the JSON object or use the default value from the member variable
         cone_angles = data.value("cone_angles", cone_angles);
     }
+
+    // Writes the light data in binary form
+    void LightComponent::writeBinary(ByteWriter &writer) const
+    {
+        writer.write(lightType);
+        writer.write(position);
+        writer.write(direction);
+        writer.write(color);
+        writer.write(attenuation);
+        writer.write(cone_angles);
+    }
+
+    // Reads the light data in the same order it was written
+    void LightComponent::readBinary(ByteReader &reader)
+    {
+        reader.read(lightType);
+        reader.read(position);
+        reader.read(direction);
+        reader.read(color);
+        reader.read(attenuation);
+        reader.read(cone_angles);
+    }
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../ecs/component.hpp"
+#include "../ecs/component-pool.hpp"
 
 #include <glm/gtx/euler_angles.hpp>
 #include <glm/glm.hpp>
@@ -12,7 +12,7 @@ namespace our
     // This component is added as a simple example for how use the ECS framework to implement logic.
     // For more information, see "common/systems/movement.hpp"
     // For a more complex example of how to use the ECS framework, see "free-camera-controller.hpp"
-    class LightComponent : public Component
+    class LightComponent : public PooledComponent<LightComponent>
     {
     public:
         // data members :
@@ -28,9 +28,14 @@ namespace our
 
         // The ID of this component type is "Light"
         static std::string getID() { return "Light"; }
+        std::string getTypeID() const override { return getID(); }
+        Component *clone() const override { return new LightComponent(*this); }
 
         // Reads light component data from the given JSON object
         void deserialize(const nlohmann::json &data) override;
+        // Writes & reads the component data in binary form (see "serialize-utils.hpp")
+        void writeBinary(ByteWriter &writer) const override;
+        void readBinary(ByteReader &reader) override;
     };
 
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include "mesh-renderer.hpp"
 #include "../asset-loader.hpp"
+#include "../serialize-utils.hpp"
 
 namespace our
 {
@@ -19,7 +20,25 @@ namespace our
         // AssetLoader<Mesh>::deserialize(data["mesh"]);
         // AssetLoader<Material>::deserialize(data["material"]);
 
-        mesh = AssetLoader<Mesh>::get(data["mesh"].get<std::string>());             // get the mesh from the asset loader
-        material = AssetLoader<Material>::get(data["material"].get<std::string>()); // get the material from the asset loader
+        meshName = data["mesh"].get<std::string>();
+        materialName = data["material"].get<std::string>();
+        mesh = AssetLoader<Mesh>::get(meshName);             // get the mesh from the asset loader
+        material = AssetLoader<Material>::get(materialName); // get the material from the asset loader
+    }
+
+    // Writes the mesh & material names (not the pointers) so that they can be resolved again on load
+    void MeshRendererComponent::writeBinary(ByteWriter &writer) const
+    {
+        writer.writeString(meshName);
+        writer.writeString(materialName);
+    }
+
+    // Reads the mesh & material names then gets the actual assets from the AssetLoader
+    void MeshRendererComponent::readBinary(ByteReader &reader)
+    {
+        meshName = reader.readString();
+        materialName = reader.readString();
+        mesh = AssetLoader<Mesh>::get(meshName);
+        material = AssetLoader<Material>::get(materialName);
     }
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../ecs/component.hpp"
+#include "../ecs/component-pool.hpp"
 #include "../mesh/mesh.hpp"
 #include "../material/material.hpp"
 #include "../asset-loader.hpp"
@@ -8,16 +8,23 @@
 namespace our {
 
     // This component denotes that any renderer should draw the given mesh using the given material at the transformation of the owning entity.
-    class MeshRendererComponent : public Component {
+    class MeshRendererComponent : public PooledComponent<MeshRendererComponent> {
     public:
         Mesh* mesh; // The mesh that should be drawn
         Material* material; // The material used to draw the mesh
+        std::string meshName, materialName; // The asset names of the mesh & material (kept to be able to write the component back)
+        int lod = 0; // The level of detail of the mesh that the renderer picked in the last frame (see "Mesh::selectLOD")
 
         // The ID of this component type is "Mesh Renderer"
         static std::string getID() { return "Mesh Renderer"; }
+        std::string getTypeID() const override { return getID(); }
+        Component *clone() const override { return new MeshRendererComponent(*this); }
 
         // Receives the mesh & material from the AssetLoader by the names given in the json object
         void deserialize(const nlohmann::json& data) override;
+        // Writes & reads the component data in binary form (see "serialize-utils.hpp")
+        void writeBinary(ByteWriter &writer) const override;
+        void readBinary(ByteReader &reader) override;
     };
 
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "movement.hpp"
 #include "../ecs/entity.hpp"
 #include "../deserialize-utils.hpp"
+#include "../serialize-utils.hpp"
 
 namespace our {
     // Reads linearVelocity & angularVelocity from the given json object
@@ -9,4 +10,16 @@ namespace our {
         linearVelocity = data.value("linearVelocity", linearVelocity);
         angularVelocity = glm::radians(data.value("angularVelocity", angularVelocity));
     }
+
+    // Writes linearVelocity & angularVelocity (in radians) in binary form
+    void MovementComponent::writeBinary(ByteWriter& writer) const {
+        writer.write(linearVelocity);
+        writer.write(angularVelocity);
+    }
+
+    // Reads linearVelocity & angularVelocity in the same order they were written
+    void MovementComponent::readBinary(ByteReader& reader) {
+        reader.read(linearVelocity);
+        reader.read(angularVelocity);
+    }
 }
\ No newline at end of file
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "../ecs/component.hpp"
+#include "../ecs/component-pool.hpp"
 
 #include <glm/glm.hpp>
 
@@ -10,10 +10,12 @@ namespace our {
     // This component is added as a simple example for how use the ECS framework to implement logic.
     // For more information, see "common/systems/movement.hpp"
     // For a more complex example of how to use the ECS framework, see "free-camera-controller.hpp"
-    class ObstacleComponent : public Component {
+    class ObstacleComponent : public PooledComponent<ObstacleComponent> {
     public:
         // The ID of this component type is "Movement"
         static std::string getID() { return "Obstacle"; }
+        std::string getTypeID() const override { return getID(); }
+        Component *clone() const override { return new ObstacleComponent(*this); }
 
         // Reads linearVelocity & angularVelocity from the given json object
         void deserialize(const nlohmann::json &data) override;
@@ -1,6 +1,7 @@
 #include "player.hpp"
 #include "../ecs/entity.hpp"
 #include "../deserialize-utils.hpp"
+#include "../serialize-utils.hpp"
 
 namespace our {
     // Reads linearVelocity & angularVelocity from the given json object
@@ -8,4 +9,14 @@ namespace our {
         if (!data.is_object()) return;
         this->speed = data.value("speed", this->speed);
     }
+
+    // Writes the player speed in binary form
+    void PlayerComponent::writeBinary(ByteWriter &writer) const {
+        writer.write(speed);
+    }
+
+    // Reads the player speed
+    void PlayerComponent::readBinary(ByteReader &reader) {
+        reader.read(speed);
+    }
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "repeat.hpp"
 #include "../ecs/entity.hpp"
 #include "../deserialize-utils.hpp"
+#include "../serialize-utils.hpp"
 
 namespace our {
     // Reads linearVelocity & angularVelocity from the given json object
@@ -8,4 +9,14 @@ namespace our {
         if (!data.is_object()) return;
         translation = data.value("translation", translation);
     }
+
+    // Writes the repeat translation in binary form
+    void RepeatComponent::writeBinary(ByteWriter &writer) const {
+        writer.write(translation);
+    }
+
+    // Reads the repeat translation
+    void RepeatComponent::readBinary(ByteReader &reader) {
+        reader.read(translation);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include "config-utils.hpp"
+
+#include <fstream>
+#include <iostream>
+
+namespace our {
+
+    nlohmann::json parseConfigFile(const std::string &path) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr << "Couldn't open file: " << path << std::endl;
+            return nullptr;
+        }
+        return nlohmann::json::parse(file, nullptr, true, true);
+    }
+
+    nlohmann::json parseConfigFile(const std::string &path, const std::unordered_set<std::string> &keys) {
+        std::ifstream file(path);
+        if (!file) {
+            std::cerr << "Couldn't open file: " << path << std::endl;
+            return nullptr;
+        }
+        // The parser calls this function for every event (e.g. object start, key, value) as it streams through the file
+        // Returning false for a key of the root object (depth 1) discards the key and its whole value
+        nlohmann::json::parser_callback_t filter = [&keys](int depth, nlohmann::json::parse_event_t event,
+                                                           nlohmann::json &parsed) {
+            if (depth == 1 && event == nlohmann::json::parse_event_t::key)
+                return keys.count(parsed.get<std::string>()) != 0;
+            return true;
+        };
+        return nlohmann::json::parse(file, filter, true, true);
+    }
+
+    nlohmann::json resolveConfig(const nlohmann::json &value) {
+        if (value.is_string()) return parseConfigFile(value.get<std::string>());
+        return value;
+    }
+
+    nlohmann::json resolveConfig(const nlohmann::json &value, const std::unordered_set<std::string> &keys) {
+        if (value.is_string()) return parseConfigFile(value.get<std::string>(), keys);
+        nlohmann::json result = nlohmann::json::object();
+        if (value.is_object()) {
+            for (auto &[key, member]: value.items())
+                if (keys.count(key)) result[key] = member;
+        }
+        return result;
+    }
+
+}
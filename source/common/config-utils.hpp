@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <unordered_set>
+#include <json/json.hpp>
+
+// This file contains some helper code for reading the configuration which includes:
+// - Parsing a json document from a file (comments are allowed)
+// - Parsing only some members of a json document (members not needed are skipped while parsing)
+// - Resolving config values that can either be written inline or given as a path to a separate document
+
+namespace our {
+
+    // Parses the whole json document in the file at "path"
+    // If the file couldn't be opened, an error is printed and a null json is returned
+    nlohmann::json parseConfigFile(const std::string &path);
+
+    // Parses the json object in the file at "path" but only keeps the top level members whose keys are in "keys"
+    // The file is streamed through the parser and the skipped members are discarded while parsing
+    // so no memory is spent building the parts of the document that are not needed
+    nlohmann::json parseConfigFile(const std::string &path, const std::unordered_set<std::string> &keys);
+
+    // If the value is a string, it is treated as the path to a json document which is parsed and returned
+    // Otherwise, the value is returned as is (i.e. the data was written inline)
+    nlohmann::json resolveConfig(const nlohmann::json &value);
+
+    // Same as "resolveConfig" but for json objects only the members whose keys are in "keys" are kept
+    nlohmann::json resolveConfig(const nlohmann::json &value, const std::unordered_set<std::string> &keys);
+
+}
@@ -0,0 +1,145 @@
+#include "dynamic-buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace our {
+
+    static GLsizeiptr alignUp(GLsizeiptr size) {
+        return (size + DynamicBuffer::ALIGNMENT - 1) / DynamicBuffer::ALIGNMENT * DynamicBuffer::ALIGNMENT;
+    }
+
+    void DynamicBuffer::initialize(const nlohmann::json &config) {
+        if (buffer) return;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        persistent = config.value("persistent", true) && (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage);
+        frame = 0;
+        used = 0;
+        allocate(alignUp(std::max<GLsizeiptr>(config.value("frame-size", GLsizeiptr(1) << 20), ALIGNMENT)));
+    }
+
+    void DynamicBuffer::destroy() {
+        for (GLsync &fence: fences) {
+            if (fence) glDeleteSync(fence);
+            fence = nullptr;
+        }
+        for (auto &[texture, format]: textures) glDeleteTextures(1, &texture);
+        textures.clear();
+        // Deleting the buffer also unmaps it
+        if (buffer) glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        mapping = nullptr;
+    }
+
+    GLuint DynamicBuffer::createTexture(GLenum format) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        textures.emplace_back(texture, format);
+        return texture;
+    }
+
+    void DynamicBuffer::allocate(GLsizeiptr size) {
+        frameSize = size;
+        GLsizeiptr total = frameSize * (persistent ? FRAMES : 1);
+        // The buffer textures can't read past "maxTexels" texels (the smallest texel of the formats used is 4 bytes)
+        if (total / 4 > maxTexels)
+            std::cerr << "The dynamic buffer (" << total << " bytes) is bigger than a buffer texture can read" << std::endl;
+
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+        if (persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_TEXTURE_BUFFER, total, nullptr, flags);
+            mapping = static_cast<unsigned char *>(glMapBufferRange(GL_TEXTURE_BUFFER, 0, total, flags));
+            if (!mapping) {
+                std::cerr << "Failed to map the dynamic buffer, falling back to orphaning it every frame" << std::endl;
+                glBindBuffer(GL_TEXTURE_BUFFER, 0);
+                glDeleteBuffers(1, &buffer);
+                persistent = false;
+                frame = 0;
+                allocate(size);
+                return;
+            }
+        } else {
+            glBufferData(GL_TEXTURE_BUFFER, total, nullptr, GL_STREAM_DRAW);
+            mapping = nullptr;
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        for (auto &[texture, format]: textures) {
+            glBindTexture(GL_TEXTURE_BUFFER, texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+        }
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void DynamicBuffer::beginFrame() {
+        if (!buffer) return;
+        used = 0;
+        if (persistent) {
+            frame = (frame + 1) % FRAMES;
+            // The region was used FRAMES frames ago, so the GPU is usually done with it by now
+            if (GLsync fence = fences[frame]) {
+                GLbitfield flags = 0;
+                GLenum result;
+                while ((result = glClientWaitSync(fence, flags, 1000000000)) == GL_TIMEOUT_EXPIRED)
+                    flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+                if (result == GL_WAIT_FAILED)
+                    std::cerr << "Failed to wait for the dynamic buffer fence" << std::endl;
+                glDeleteSync(fence);
+                fences[frame] = nullptr;
+            }
+        } else {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+            glBufferData(GL_TEXTURE_BUFFER, frameSize, nullptr, GL_STREAM_DRAW);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        }
+    }
+
+    void DynamicBuffer::endFrame() {
+        if (!persistent) return;
+        if (fences[frame]) glDeleteSync(fences[frame]);
+        fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    GLsizeiptr DynamicBuffer::upload(const void *data, GLsizeiptr size) {
+        GLsizeiptr offset = used;
+        if (offset + size > frameSize) grow(offset + size);
+        if (size > 0) {
+            if (persistent) {
+                std::memcpy(mapping + frame * frameSize + offset, data, size_t(size));
+            } else {
+                glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+                glBufferSubData(GL_TEXTURE_BUFFER, offset, size, data);
+                glBindBuffer(GL_TEXTURE_BUFFER, 0);
+            }
+        }
+        used = alignUp(offset + size);
+        return offset;
+    }
+
+    void DynamicBuffer::grow(GLsizeiptr size) {
+        GLuint oldBuffer = buffer;
+        GLsizeiptr oldOffset = frame * frameSize;
+        // The new buffer isn't used by the GPU yet, so the fences of the old one aren't needed anymore
+        // (the driver keeps the old storage alive until the commands reading it are done)
+        for (GLsync &fence: fences) {
+            if (fence) glDeleteSync(fence);
+            fence = nullptr;
+        }
+        allocate(alignUp(std::max(frameSize * 2, size)));
+        if (used > 0) {
+            glBindBuffer(GL_COPY_READ_BUFFER, oldBuffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, oldOffset, frame * frameSize, used);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &oldBuffer);
+    }
+
+}
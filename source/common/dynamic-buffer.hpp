@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <json/json.hpp>
+#include <utility>
+#include <vector>
+
+namespace our {
+
+    // A dynamic buffer is the upload path of the data that the renderer sends to the GPU every frame (the lights, the clusters
+    // and the instance data of the shadow casters & the material batches). The data of all of them is packed one after the
+    // other in the region of the current frame, and the shaders read it through buffer textures that view the whole buffer.
+    //  - If the driver supports buffer storage (OpenGL 4.4 or ARB_buffer_storage), the buffer holds FRAMES regions that are
+    //    used in turn and it is mapped once with a persistent & coherent mapping, so an upload is a plain copy. A fence is put
+    //    after the commands of each frame, and a region is only written again once the GPU is done with it (this only waits
+    //    if the CPU gets FRAMES frames ahead of the GPU).
+    //  - Otherwise, the buffer has a single region which is orphaned at the start of every frame (so the driver gives it new
+    //    memory instead of waiting for the last frame) and the uploads use glBufferSubData.
+    // The uploads return their offset from the start of the region, and the offsets are turned into texels (see "getTexel")
+    // only when the data is bound, since the buffer grows (and the data of the frame moves) if a frame doesn't fit in a region.
+    class DynamicBuffer {
+    public:
+        static constexpr int FRAMES = 3;
+        // Every upload starts at a multiple of this (so it starts at a texel of any buffer texture format up to a vec4)
+        static constexpr GLsizeiptr ALIGNMENT = 16;
+
+        DynamicBuffer() = default;
+        DynamicBuffer(const DynamicBuffer &) = delete;
+        DynamicBuffer &operator=(const DynamicBuffer &) = delete;
+        ~DynamicBuffer() { destroy(); }
+
+        // Creates the buffer (should be called after OpenGL is loaded). The options can be changed in the config:
+        // { "frame-size": 1048576, "persistent": true } where "persistent": false forces the orphaning fallback
+        void initialize(const nlohmann::json &config);
+        // Deletes the buffer and its buffer textures
+        void destroy();
+
+        // Returns a new buffer texture of the given format that views the whole buffer
+        // The texture is owned by the dynamic buffer and it is attached again to the new buffer when the buffer grows
+        GLuint createTexture(GLenum format);
+
+        // Starts writing to the region of the next frame (waits if the GPU is still reading it)
+        void beginFrame();
+        // Puts a fence after the commands that read the region of this frame
+        void endFrame();
+
+        // Copies the data to the region of this frame and returns its offset from the start of the region (in bytes)
+        GLsizeiptr upload(const void *data, GLsizeiptr size);
+
+        // Returns the texel where the data uploaded at the given offset starts in a buffer texture with the given texel size
+        GLint getTexel(GLsizeiptr offset, GLsizeiptr texelSize) const {
+            return GLint((frame * frameSize + offset) / texelSize);
+        }
+
+        bool isPersistent() const { return persistent; }
+        GLsizeiptr getFrameSize() const { return frameSize; }
+        GLsizeiptr getUsedSize() const { return used; }
+
+    private:
+        GLuint buffer = 0;
+        std::vector<std::pair<GLuint, GLenum>> textures; // The buffer textures & their formats
+        bool persistent = false;
+        unsigned char *mapping = nullptr; // The persistent mapping of the whole buffer
+        GLsync fences[FRAMES] = {};
+        int frame = 0;
+        GLsizeiptr frameSize = 0, used = 0;
+        GLint maxTexels = 65536; // The maximum size of a buffer texture (queried from the driver)
+
+        // Creates the buffer with regions of the given size (and maps it if it is persistent) then attaches the textures to it
+        void allocate(GLsizeiptr size);
+        // Moves to a bigger buffer where the region of this frame can hold "size" bytes (the data written so far is copied)
+        void grow(GLsizeiptr size);
+    };
+
+}
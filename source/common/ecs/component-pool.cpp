@@ -0,0 +1,82 @@
+#include "component-pool.hpp"
+
+#include <algorithm>
+
+namespace our {
+
+    ComponentPool::ComponentPool(std::string name, size_t slotSize, size_t slotAlignment, size_t slotsPerChunk)
+            : name(std::move(name)), slotAlignment(std::max(slotAlignment, alignof(FreeSlot))),
+              slotsPerChunk(std::max<size_t>(slotsPerChunk, 1)) {
+        // Every slot must be able to hold a free list node and keep the next slot aligned
+        this->slotSize = std::max(slotSize, sizeof(FreeSlot));
+        this->slotSize = (this->slotSize + this->slotAlignment - 1) / this->slotAlignment * this->slotAlignment;
+        registry().push_back(this);
+    }
+
+    ComponentPool::~ComponentPool() {
+        releaseChunks();
+        auto &pools = registry();
+        pools.erase(std::remove(pools.begin(), pools.end(), this), pools.end());
+    }
+
+    void ComponentPool::addChunk() {
+        std::pmr::memory_resource *resource = upstream();
+        auto memory = static_cast<std::byte *>(resource->allocate(chunkSize(), slotAlignment));
+        chunks.push_back({memory, resource});
+        // Push the new slots to the free list in reverse so that they are handed out in memory order
+        for (size_t index = slotsPerChunk; index-- > 0;) {
+            auto slot = reinterpret_cast<FreeSlot *>(memory + index * slotSize);
+            slot->next = freeList;
+            freeList = slot;
+        }
+    }
+
+    void ComponentPool::releaseChunks() {
+        for (auto &chunk: chunks) chunk.resource->deallocate(chunk.memory, chunkSize(), slotAlignment);
+        chunks.clear();
+        freeList = nullptr;
+    }
+
+    void *ComponentPool::allocate() {
+        if (!freeList) addChunk();
+        FreeSlot *slot = freeList;
+        freeList = slot->next;
+        peakCount = std::max(peakCount, ++count);
+        return slot;
+    }
+
+    void ComponentPool::deallocate(void *pointer) {
+        if (!pointer) return;
+        auto slot = static_cast<FreeSlot *>(pointer);
+        slot->next = freeList;
+        freeList = slot;
+        --count;
+    }
+
+    void ComponentPool::trim() {
+        if (count == 0) releaseChunks();
+    }
+
+    const std::vector<ComponentPool *> &ComponentPool::getPools() {
+        return registry();
+    }
+
+    void ComponentPool::trimAll() {
+        for (auto pool: registry()) pool->trim();
+    }
+
+    void ComponentPool::setUpstream(std::pmr::memory_resource *resource) {
+        upstream() = resource ? resource : std::pmr::get_default_resource();
+    }
+
+    std::vector<ComponentPool *> &ComponentPool::registry() {
+        static std::vector<ComponentPool *> pools;
+        return pools;
+    }
+
+    std::pmr::memory_resource *&ComponentPool::upstream() {
+        static std::pmr::memory_resource *resource = std::pmr::get_default_resource();
+        return resource;
+    }
+
+}
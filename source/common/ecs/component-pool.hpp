@@ -0,0 +1,95 @@
+#pragma once
+
+#include "component.hpp"
+
+#include <cstddef>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace our {
+
+    // A component pool allocates the components of one type from big chunks of fixed-size slots.
+    // Freed slots are kept in a free list, so creating & destroying a component is O(1) and only calls the upstream allocator
+    // when all the chunks are full. Since the components of one type are packed together, iterating over them is cache friendly.
+    // The chunks are kept when the components are destroyed (so a level reload reuses them) until the pool is destroyed or "trim"
+    // is called.
+    // The chunks are allocated from a pmr memory resource (the default resource unless "setUpstream" is called).
+    // Every pool registers itself in a global list so that the engine can report how much memory each component type uses.
+    class ComponentPool {
+    public:
+        ComponentPool(std::string name, size_t slotSize, size_t slotAlignment, size_t slotsPerChunk = 64);
+        ~ComponentPool();
+
+        ComponentPool(const ComponentPool &) = delete;
+        ComponentPool &operator=(const ComponentPool &) = delete;
+
+        void *allocate();
+        void deallocate(void *pointer);
+        // Gives the chunks back to the resources that allocated them if no component of the pool is alive
+        void trim();
+
+        const std::string &getName() const { return name; }
+        size_t getSlotSize() const { return slotSize; }
+        size_t getCount() const { return count; }                                 // The number of live components
+        size_t getPeakCount() const { return peakCount; }                         // The largest number of live components so far
+        size_t getBytesUsed() const { return count * slotSize; }                  // The memory used by the live components
+        size_t getBytesReserved() const { return chunks.size() * chunkSize(); }   // The memory owned by the pool
+
+        // Returns all the pools that were created so far
+        static const std::vector<ComponentPool *> &getPools();
+        // Calls "trim" on all the pools (e.g. when the level is unloaded for good)
+        static void trimAll();
+        // Sets the memory resource from which the chunks of all the pools are allocated (null restores the default resource)
+        // The chunks that are already allocated are returned to the resource that allocated them.
+        static void setUpstream(std::pmr::memory_resource *resource);
+
+    private:
+        struct Chunk {
+            void *memory;
+            std::pmr::memory_resource *resource; // The resource that allocated the chunk
+        };
+        // A free slot stores the pointer to the next free slot
+        struct FreeSlot {
+            FreeSlot *next;
+        };
+
+        size_t chunkSize() const { return slotSize * slotsPerChunk; }
+        void addChunk();
+        void releaseChunks();
+
+        std::string name;
+        size_t slotSize, slotAlignment, slotsPerChunk;
+        std::vector<Chunk> chunks;
+        FreeSlot *freeList = nullptr;
+        size_t count = 0, peakCount = 0;
+
+        static std::vector<ComponentPool *> &registry();
+        static std::pmr::memory_resource *&upstream();
+    };
+
+    // Derive a component from "PooledComponent<T>" (instead of "Component") to allocate it from its type's pool.
+    // This only replaces "operator new" & "operator delete" of the component, so it is still created with "new T()"
+    // (e.g. by "Entity::addComponent" and "clone") and deleted with "delete" through a Component pointer.
+    template<typename T>
+    class PooledComponent : public Component {
+    public:
+        // Returns the pool that holds all the components of type T
+        static ComponentPool &getPool() {
+            static ComponentPool pool(T::getID(), sizeof(T), alignof(T));
+            return pool;
+        }
+
+        static void *operator new(size_t size) {
+            // A type derived from T is bigger than the slots, so it goes to the global allocator instead
+            if (size != sizeof(T)) return ::operator new(size);
+            return getPool().allocate();
+        }
+
+        static void operator delete(void *pointer, size_t size) {
+            if (size != sizeof(T)) return ::operator delete(pointer);
+            getPool().deallocate(pointer);
+        }
+    };
+
+}
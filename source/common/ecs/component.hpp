@@ -2,10 +2,14 @@
 
 #include <json/json.hpp>
 #include <string>
+#include <cstdint>
 
 namespace our {
 
     class Entity; // A forward declaration of the Entity Class
+    class World;  // A forward declaration of the World Class
+    class ByteWriter; // Forward declarations of the binary serialization helpers (see "serialize-utils.hpp")
+    class ByteReader;
 
     // A component is a data container that can be added to an entity.
     // The role of the entity in the world is defined by the components it holds.
@@ -14,6 +18,13 @@ namespace our {
     class Component {
         Entity* owner; // A pointer to the entity that owns this component
         friend Entity; // The entity is a friend since it is the only one allowed to set itself as an owner of a certain component.
+        uint64_t version = 0;       // The world change version at which this component was last added or changed
+        // Where this component waits in the event queues of the world (NOT_PENDING if it isn't waiting for the event)
+        // The slots let the world drop the events of a removed component in constant time (see "World::componentRemoved")
+        static constexpr uint32_t NOT_PENDING = 0xFFFFFFFFu;
+        uint32_t addedSlot = NOT_PENDING;   // The slot of the component in the queue of "added" events
+        uint32_t changedSlot = NOT_PENDING; // The slot of the component in the queue of "changed" events
+        friend World;  // The world is a friend since it tracks the changes of the components (see "World::markChanged")
     public:
         // This static method returns a unique string that identifies each type of components
         // This ID will be used as the key to store a component into the entity's component map 
@@ -22,8 +33,25 @@ namespace our {
         // Reads the data of the component from a json object
         // It is abstract since it must be overriden by derived components
         virtual void deserialize(const nlohmann::json& data) = 0;
+        // Returns the ID of the concrete component type (the same string returned by its static "getID")
+        // This is used to recreate the component when it is read back from binary data
+        virtual std::string getTypeID() const = 0;
+        // Returns a new copy of this component (used to instantiate prefabs without deserializing them again)
+        // The copy has no owner until it is added to an entity
+        virtual Component* clone() const = 0;
+        // Writes the component data in a compact binary form (used by cooked scenes)
+        // Components that hold no data can keep the default implementation
+        virtual void writeBinary(ByteWriter& /*writer*/) const {}
+        // Reads the component data written by "writeBinary" in the same order
+        virtual void readBinary(ByteReader& /*reader*/) {}
         // Returns the owner of this component
         Entity* getOwner() const { return owner; }
+        // Returns the world change version at which this component was last added or changed
+        // A system can store it and compare it later to know if the component changed in between
+        uint64_t getVersion() const { return version; }
+        // Tells the world of the owner that this component was changed (see "World::markChanged")
+        // Call it after changing the component data so that the observers and versions stay up to date
+        void markChanged();
         // Define a virtual destructor
         virtual ~Component(){}
     };
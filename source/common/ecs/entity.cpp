@@ -1,4 +1,5 @@
 #include "entity.hpp"
+#include "world.hpp"
 #include "../deserialize-utils.hpp"
 #include "../components/component-deserializer.hpp"
 
@@ -18,12 +19,22 @@ namespace our
         Entity *Parent = parent;
         while (Parent)
         {                                                          // check if there is a parent
-            finalMat = parent->localTransform.toMat4() * finalMat; // multiply the parent's local to world matrix with the current matrix
+            finalMat = Parent->localTransform.toMat4() * finalMat; // multiply the parent's local to world matrix with the current matrix
             Parent = Parent->parent;                               // get parent of parent
         }
         return finalMat; // return the final matrix
     }
 
+    // The inverse transpose of a product is the product of the inverse transposes (in the same order)
+    // so we can chain the cached normal matrices of the ancestors the same way we chain their transforms
+    glm::mat3 Entity::getNormalMatrix() const
+    {
+        glm::mat3 normalMatrix = localTransform.getNormalMatrix();
+        for (Entity *ancestor = parent; ancestor; ancestor = ancestor->parent)
+            normalMatrix = ancestor->localTransform.getNormalMatrix() * normalMatrix;
+        return normalMatrix;
+    }
+
     // Deserializes the entity data and components from a json object
     void Entity::deserialize(const nlohmann::json &data)
     {
@@ -43,4 +54,17 @@ namespace our
         }
     }
 
-}
\ No newline at end of file
+
+    void Entity::notifyAdded(Component *component)
+    {
+        if (world)
+            world->componentAdded(component);
+    }
+
+    void Entity::notifyRemoved(Component *component)
+    {
+        if (world)
+            world->componentRemoved(component);
+    }
+
+}
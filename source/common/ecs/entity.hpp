@@ -15,10 +15,15 @@ namespace our
     class Entity
     {
         World *world;                      // This defines what world own this entity
+        uint32_t id = 0;                   // A unique id given by the world (stays the same as long as the entity lives)
         std::list<Component *> components; // A list of components that are owned by this entity
 
         friend World;       // The world is a friend since it is the only class that is allowed to instantiate an entity
         Entity() = default; // The entity constructor is private since only the world is allowed to instantiate an entity
+
+        // These tell the world (if any) that a component was added to or is about to be removed from this entity
+        void notifyAdded(Component *component);
+        void notifyRemoved(Component *component);
     public:
         std::string name; // The name of the entity. It could be useful to refer to an entity by its name
         Entity *parent;   // The parent of the entity. The transform of the entity is relative to its parent.
@@ -27,8 +32,13 @@ namespace our
 
         World *getWorld() const { return world; } // Returns the world to which this entity belongs
 
+        uint32_t getId() const { return id; } // Returns the id of the entity which is unique within its world
+
+        const std::list<Component *> &getComponents() const { return components; } // Returns the components owned by this entity
+
         glm::mat4
         getLocalToWorldMatrix() const;            // Computes and returns the transformation from the entities local space to the world space
+        glm::mat3 getNormalMatrix() const;        // Computes and returns the matrix that transforms normals from the local space to the world space
         void deserialize(const nlohmann::json &); // Deserializes the entity data and components from a json object
 
         // This template method create a component of type T,
@@ -43,9 +53,20 @@ namespace our
             T *comp = new T();          // create a new component of type T
             comp->owner = this;         // set the owner of the component to be this entity
             components.push_back(comp); // push the component into the components list
+            notifyAdded(comp);          // let the world know about the new component
             return comp;                // return pointer of new component
         }
 
+        // This method adds an already created component (e.g. a clone of another component) to this entity
+        // The entity becomes the owner of the component and returns it
+        Component *addComponent(Component *component)
+        {
+            component->owner = this;
+            components.push_back(component);
+            notifyAdded(component);
+            return component;
+        }
+
         // This template method searhes for a component of type T and returns a pointer to it
         // If no component of type T was found, it returns a nullptr
         template <typename T>
@@ -73,6 +94,17 @@ namespace our
             return nullptr; // return null if nothing was found
         }
 
+        // Same as "getComponent" but for writing: the component (if found) is marked as changed (see "Component::markChanged")
+        // so its version is increased and the "changed" observers get it. Use "getComponent" when only reading.
+        template <typename T>
+        T *getMutableComponent()
+        {
+            T *component = getComponent<T>();
+            if (component)
+                component->markChanged();
+            return component;
+        }
+
         // This template method dynami and returns a pointer to it
         // If no component of type T was found, it returns a nullptr
         template <typename T>
@@ -106,6 +138,7 @@ namespace our
             { // loop over the components list
                 if (dynamic_cast<T *>(*it))
                 {                         // check if the current component can be casted to type T
+                    notifyRemoved(*it);   // let the world know that the component is going away
                     delete *it;           // delete the component
                     components.erase(it); // remove the component from the components list
                     break;                // break the loop
@@ -120,6 +153,7 @@ namespace our
             std::advance(it, index); // advance the iterator to the index
             if (it != components.end())
             {                         // if the iterator is not at the end of the list (found the component to be del)
+                notifyRemoved(*it);   // let the world know that the component is going away
                 delete *it;           // delete the component
                 components.erase(it); // remove the component from the components list
             }
@@ -135,6 +169,7 @@ namespace our
             { // loop over the components list
                 if (component == dynamic_cast<T *>(*it))
                 {                         // check if the current component can be casted to type T
+                    notifyRemoved(*it);   // let the world know that the component is going away
                     delete *it;           // delete the component
                     components.erase(it); // remove the component from the components list
                     // break;
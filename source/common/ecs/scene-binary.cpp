@@ -0,0 +1,260 @@
+#include "scene-binary.hpp"
+#include "../serialize-utils.hpp"
+#include "../components/component-deserializer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+namespace our::scene_binary {
+
+    // Returns how many ancestors the entity has (used to write the parents before their children)
+    static int depthOf(const Entity *entity) {
+        int depth = 0;
+        for (Entity *parent = entity->parent; parent; parent = parent->parent) ++depth;
+        return depth;
+    }
+
+    // Appends a trivially copyable struct to a byte buffer
+    template<typename T>
+    static void append(std::vector<uint8_t> &buffer, const T &value) {
+        auto bytes = reinterpret_cast<const uint8_t *>(&value);
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    }
+
+    // Hashes the given bytes (FNV-1a)
+    static uint64_t hashBytes(const void *data, size_t size, uint64_t hash) {
+        auto bytes = static_cast<const uint8_t *>(data);
+        for (size_t index = 0; index < size; ++index)
+            hash = (hash ^ bytes[index]) * 1099511628211ull;
+        return hash;
+    }
+
+    // Hashes the file content if the value is a path, otherwise hashes the inline json
+    static uint64_t hashSource(const nlohmann::json &value, uint64_t hash) {
+        std::string content;
+        if (value.is_string()) {
+            std::ifstream in(value.get<std::string>(), std::ios::binary);
+            content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        } else {
+            content = value.dump();
+        }
+        // The length is hashed too so that moving bytes from one source to the other changes the hash
+        uint64_t length = content.size();
+        hash = hashBytes(&length, sizeof(length), hash);
+        return hashBytes(content.data(), content.size(), hash);
+    }
+
+    uint64_t hashSources(const nlohmann::json &level, const nlohmann::json &prefabs) {
+        return hashSource(prefabs, hashSource(level, 14695981039346656037ull));
+    }
+
+    bool save(World *world, const std::string &path, uint64_t sourceHash) {
+        // Sort the entities such that every parent is written before its children
+        std::vector<Entity *> entities(world->getEntities().begin(), world->getEntities().end());
+        std::stable_sort(entities.begin(), entities.end(), [](const Entity *a, const Entity *b) {
+            return depthOf(a) < depthOf(b);
+        });
+        std::unordered_map<const Entity *, uint32_t> indices;
+        for (uint32_t index = 0; index < entities.size(); ++index) indices[entities[index]] = index;
+
+        StringTable strings;
+        std::vector<uint8_t> blob;
+        ByteWriter writer(blob, &strings);
+        std::vector<SceneEntityRecord> entityRecords;
+        std::vector<SceneComponentRecord> componentRecords;
+        entityRecords.reserve(entities.size());
+
+        for (auto entity: entities) {
+            SceneEntityRecord record{};
+            record.name = strings.intern(entity->name);
+            record.parent = NO_PARENT;
+            if (auto it = indices.find(entity->parent); entity->parent && it != indices.end())
+                record.parent = it->second;
+            record.transformOffset = static_cast<uint32_t>(blob.size());
+            entity->localTransform.writeBinary(writer);
+            record.transformSize = static_cast<uint32_t>(blob.size()) - record.transformOffset;
+            record.firstComponent = static_cast<uint32_t>(componentRecords.size());
+            for (auto component: entity->getComponents()) {
+                SceneComponentRecord componentRecord{};
+                componentRecord.type = strings.intern(component->getTypeID());
+                componentRecord.dataOffset = static_cast<uint32_t>(blob.size());
+                component->writeBinary(writer);
+                componentRecord.dataSize = static_cast<uint32_t>(blob.size()) - componentRecord.dataOffset;
+                componentRecords.push_back(componentRecord);
+            }
+            record.componentCount = static_cast<uint32_t>(componentRecords.size()) - record.firstComponent;
+            entityRecords.push_back(record);
+        }
+
+        // Now we know the size of every section so we can compute the offsets and write the file in one go
+        SceneFileHeader header{};
+        std::copy(std::begin(MAGIC), std::end(MAGIC), header.magic);
+        header.version = VERSION;
+        header.sourceHash = sourceHash;
+        header.stringCount = static_cast<uint32_t>(strings.size());
+        header.entityCount = static_cast<uint32_t>(entityRecords.size());
+        header.componentCount = static_cast<uint32_t>(componentRecords.size());
+
+        std::vector<uint8_t> stringSection;
+        std::vector<SceneStringRecord> stringRecords;
+        uint32_t charactersOffset = sizeof(SceneFileHeader) + header.stringCount * sizeof(SceneStringRecord);
+        for (auto &string: strings.getStrings()) {
+            stringRecords.push_back({charactersOffset + static_cast<uint32_t>(stringSection.size()),
+                                     static_cast<uint32_t>(string.size())});
+            stringSection.insert(stringSection.end(), string.begin(), string.end());
+        }
+        header.stringTableOffset = sizeof(SceneFileHeader);
+        header.entityTableOffset = charactersOffset + static_cast<uint32_t>(stringSection.size());
+        // Keep the tables 4-byte aligned so that they can be read in place
+        header.entityTableOffset = (header.entityTableOffset + 3u) & ~3u;
+        header.componentTableOffset = header.entityTableOffset + header.entityCount * sizeof(SceneEntityRecord);
+        header.blobOffset = header.componentTableOffset + header.componentCount * sizeof(SceneComponentRecord);
+        header.blobSize = static_cast<uint32_t>(blob.size());
+
+        std::vector<uint8_t> file;
+        file.reserve(header.blobOffset + header.blobSize);
+        append(file, header);
+        for (auto &record: stringRecords) append(file, record);
+        file.insert(file.end(), stringSection.begin(), stringSection.end());
+        file.resize(header.entityTableOffset, 0);
+        for (auto &record: entityRecords) append(file, record);
+        for (auto &record: componentRecords) append(file, record);
+        file.insert(file.end(), blob.begin(), blob.end());
+
+        std::ofstream out(path, std::ios::binary);
+        if (!out) {
+            std::cerr << "Couldn't open file for writing: " << path << std::endl;
+            return false;
+        }
+        out.write(reinterpret_cast<const char *>(file.data()), static_cast<std::streamsize>(file.size()));
+        return out.good();
+    }
+
+    bool load(World *world, const std::string &path, Entity *parent) {
+        // Read the whole file with a single read
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) return false;
+        auto size = static_cast<size_t>(in.tellg());
+        if (size < sizeof(SceneFileHeader)) return false;
+        std::vector<uint8_t> file(size);
+        in.seekg(0);
+        if (!in.read(reinterpret_cast<char *>(file.data()), static_cast<std::streamsize>(size))) return false;
+
+        // Validate the header and the table ranges before touching anything
+        SceneFileHeader header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (!std::equal(std::begin(MAGIC), std::end(MAGIC), header.magic) || header.version != VERSION) {
+            std::cerr << "Invalid or outdated cooked scene: " << path << std::endl;
+            return false;
+        }
+        auto inRange = [size](uint64_t offset, uint64_t count, uint64_t itemSize) {
+            return offset + count * itemSize <= size;
+        };
+        if (!inRange(header.stringTableOffset, header.stringCount, sizeof(SceneStringRecord)) ||
+            !inRange(header.entityTableOffset, header.entityCount, sizeof(SceneEntityRecord)) ||
+            !inRange(header.componentTableOffset, header.componentCount, sizeof(SceneComponentRecord)) ||
+            !inRange(header.blobOffset, header.blobSize, 1)) {
+            std::cerr << "Corrupted cooked scene: " << path << std::endl;
+            return false;
+        }
+
+        // Fix-up 1: build the string table
+        StringTable strings;
+        auto stringRecords = reinterpret_cast<const SceneStringRecord *>(file.data() + header.stringTableOffset);
+        for (uint32_t index = 0; index < header.stringCount; ++index) {
+            auto &record = stringRecords[index];
+            if (!inRange(record.offset, record.length, 1)) {
+                std::cerr << "Corrupted cooked scene: " << path << std::endl;
+                return false;
+            }
+            strings.push(std::string(reinterpret_cast<const char *>(file.data() + record.offset), record.length));
+        }
+
+        auto entityRecords = reinterpret_cast<const SceneEntityRecord *>(file.data() + header.entityTableOffset);
+        auto componentRecords = reinterpret_cast<const SceneComponentRecord *>(file.data() + header.componentTableOffset);
+        const uint8_t *blob = file.data() + header.blobOffset;
+        auto inBlob = [&header](uint32_t offset, uint32_t count) {
+            return uint64_t(offset) + count <= header.blobSize;
+        };
+
+        // Check every record before creating anything, so a corrupted file doesn't leave half a scene in the world
+        for (uint32_t index = 0; index < header.entityCount; ++index) {
+            auto &record = entityRecords[index];
+            bool valid = record.name < header.stringCount &&
+                         (record.parent == NO_PARENT || record.parent < index) &&
+                         inBlob(record.transformOffset, record.transformSize) &&
+                         uint64_t(record.firstComponent) + record.componentCount <= header.componentCount;
+            for (uint32_t c = 0; valid && c < record.componentCount; ++c) {
+                auto &componentRecord = componentRecords[record.firstComponent + c];
+                valid = componentRecord.type < header.stringCount &&
+                        inBlob(componentRecord.dataOffset, componentRecord.dataSize);
+            }
+            if (!valid) {
+                std::cerr << "Corrupted cooked scene: " << path << std::endl;
+                return false;
+            }
+        }
+
+        // Fix-up 2: create the entities, turning parent indices into pointers and reading the packed data
+        std::vector<Entity *> created(header.entityCount, nullptr);
+        for (uint32_t index = 0; index < header.entityCount; ++index) {
+            auto &record = entityRecords[index];
+            Entity *entity = world->add();
+            created[index] = entity;
+            entity->name = strings.get(record.name);
+            entity->parent = record.parent == NO_PARENT ? parent : created[record.parent];
+            ByteReader transformReader(blob + record.transformOffset, record.transformSize, &strings);
+            entity->localTransform.readBinary(transformReader);
+            for (uint32_t c = 0; c < record.componentCount; ++c) {
+                auto &componentRecord = componentRecords[record.firstComponent + c];
+                // Fix-up 3: turn the type index into a component (and asset names into asset pointers inside readBinary)
+                Component *component = createComponent(strings.get(componentRecord.type), entity);
+                if (!component) continue;
+                ByteReader reader(blob + componentRecord.dataOffset, componentRecord.dataSize, &strings);
+                component->readBinary(reader);
+            }
+        }
+        return true;
+    }
+
+    bool readStrings(const std::string &path, std::vector<std::string> &strings, uint64_t *sourceHash) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) return false;
+        SceneFileHeader header;
+        if (!in.read(reinterpret_cast<char *>(&header), sizeof(header))) return false;
+        if (!std::equal(std::begin(MAGIC), std::end(MAGIC), header.magic) || header.version != VERSION) return false;
+        // The string records are followed by the characters so we can read the whole table with one more read
+        std::vector<SceneStringRecord> records(header.stringCount);
+        in.seekg(header.stringTableOffset);
+        if (!in.read(reinterpret_cast<char *>(records.data()),
+                     static_cast<std::streamsize>(records.size() * sizeof(SceneStringRecord))))
+            return false;
+        uint32_t charactersOffset = header.stringTableOffset + header.stringCount * sizeof(SceneStringRecord);
+        if (header.entityTableOffset < charactersOffset) return false;
+        std::string characters(header.entityTableOffset - charactersOffset, '\0');
+        if (!in.read(characters.data(), static_cast<std::streamsize>(characters.size()))) return false;
+        strings.reserve(strings.size() + records.size());
+        for (auto &record: records) {
+            if (record.offset < charactersOffset || record.offset + uint64_t(record.length) > header.entityTableOffset)
+                return false;
+            strings.push_back(characters.substr(record.offset - charactersOffset, record.length));
+        }
+        if (sourceHash) *sourceHash = header.sourceHash;
+        return true;
+    }
+
+    bool cook(const nlohmann::json &entities, int level, const std::string &path, const nlohmann::json &prefabs,
+              uint64_t sourceHash) {
+        World world;
+        world.level = level;
+        world.deserializePrefabs(prefabs);
+        world.deserialize(entities);
+        return save(&world, path, sourceHash);
+    }
+
+}
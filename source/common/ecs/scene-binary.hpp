@@ -0,0 +1,84 @@
+#pragma once
+
+#include "world.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <json/json.hpp>
+
+namespace our::scene_binary {
+
+    // A cooked scene is a binary snapshot of the entities produced by "World::deserialize"
+    // It is produced once by a cook step (see "cook") and then loaded with a single file read plus some fix-ups
+    // (parent indices to pointers & asset names to asset pointers), skipping the json parsing altogether.
+    // The file layout is:
+    //  - A header (SceneFileHeader)
+    //  - A string table: "stringCount" records of (offset, length) followed by the characters
+    //  - An entity table: "entityCount" records (SceneEntityRecord) where parents always come before their children
+    //  - A component table: "componentCount" records (SceneComponentRecord)
+    //  - A blob holding the packed transform & component data (written by "writeBinary")
+    // All offsets are relative to the start of the file.
+    // The header keeps a hash of the json the scene was cooked from (see "hashSources") so a scene cooked before the json
+    // was edited can be detected and skipped.
+    // NOTE: cooked scenes are only meant to be read by the same build on the same machine (native byte order & layout).
+
+    constexpr char MAGIC[4] = {'P', 'S', 'C', 'N'};
+    constexpr uint32_t VERSION = 4; // Bump this whenever the binary form of a component or the transform changes
+    constexpr uint32_t NO_PARENT = 0xFFFFFFFFu;
+
+    struct SceneFileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t stringCount, entityCount, componentCount;
+        uint32_t stringTableOffset, entityTableOffset, componentTableOffset;
+        uint32_t blobOffset, blobSize;
+        uint32_t reserved;   // Keeps "sourceHash" aligned without leaving uninitialized padding in the file
+        uint64_t sourceHash; // The hash of the level & prefabs json that were cooked (0 if unknown)
+    };
+
+    struct SceneStringRecord {
+        uint32_t offset, length;
+    };
+
+    struct SceneEntityRecord {
+        uint32_t name;                           // The index of the entity name in the string table
+        uint32_t parent;                         // The index of the parent in the entity table (or NO_PARENT)
+        uint32_t transformOffset, transformSize; // Where the local transform is stored in the blob
+        uint32_t firstComponent, componentCount; // The range of the entity components in the component table
+    };
+
+    struct SceneComponentRecord {
+        uint32_t type;                   // The index of the component type ID in the string table
+        uint32_t dataOffset, dataSize;   // Where the component data is stored in the blob
+    };
+
+    // Hashes the sources of a level: for each of "level" & "prefabs", if it is a path (as accepted by "resolveConfig"),
+    // the bytes of the file are hashed (without parsing it), otherwise the inline json is hashed.
+    uint64_t hashSources(const nlohmann::json &level, const nlohmann::json &prefabs);
+
+    // Writes all the entities in the world to a cooked scene file. Returns false if the file couldn't be written.
+    // "sourceHash" is stored in the header (see "hashSources").
+    bool save(World *world, const std::string &path, uint64_t sourceHash = 0);
+
+    // Reads a cooked scene file and adds its entities to the world.
+    // Root entities in the file will have their parent set to "parent".
+    // Assets referenced by name (e.g. meshes & materials) are fetched from the AssetLoader,
+    // so the assets should be loaded before calling this function.
+    // The tables are all checked before any entity is created, so if the file is missing or invalid, false is returned
+    // and nothing is added to the world. Components of an unknown type are skipped (as "World::deserialize" does).
+    bool load(World *world, const std::string &path, Entity *parent = nullptr);
+
+    // Reads only the string table of a cooked scene file into "strings" (e.g. to find the assets the scene refers to
+    // before loading it). If "sourceHash" is given, it receives the source hash stored in the header.
+    // Returns false if the file is missing or invalid.
+    bool readStrings(const std::string &path, std::vector<std::string> &strings, uint64_t *sourceHash = nullptr);
+
+    // The cook step: deserializes a json array of entities (as "World::deserialize" would do) into a temporary world
+    // then saves it as a cooked scene file. The prefabs used by the entities (if any) should be given in "prefabs".
+    // Since the prefab instances are fully expanded, loading a cooked scene does not need the prefabs.
+    // NOTE: Randomly placed duplicates are placed once while cooking so every load of the cooked scene gets the same placement.
+    bool cook(const nlohmann::json &entities, int level, const std::string &path,
+              const nlohmann::json &prefabs = nlohmann::json::object(), uint64_t sourceHash = 0);
+
+}
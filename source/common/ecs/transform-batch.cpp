@@ -0,0 +1,280 @@
+#include "transform-batch.hpp"
+
+#include <cmath>
+#include <glm/gtc/quaternion.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OUR_TRANSFORM_BATCH_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC & Clang only allow the AVX2 intrinsics inside functions compiled for AVX2, while MSVC allows them anywhere
+#if defined(OUR_TRANSFORM_BATCH_X86) && (defined(__GNUC__) || defined(__clang__))
+#define OUR_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define OUR_TARGET_AVX2
+#endif
+
+namespace our {
+
+    void TransformBatch::clear() {
+        for (auto array: {&positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ, &scaleX, &scaleY, &scaleZ})
+            array->clear();
+        quaternionIndices.clear();
+        quaternions.clear();
+    }
+
+    void TransformBatch::reserve(size_t count) {
+        for (auto array: {&positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ, &scaleX, &scaleY, &scaleZ})
+            array->reserve(count);
+    }
+
+    void TransformBatch::push(const Transform &transform) {
+        positionX.push_back(transform.position.x);
+        positionY.push_back(transform.position.y);
+        positionZ.push_back(transform.position.z);
+        if (transform.useQuaternion) {
+            quaternionIndices.push_back(positionX.size() - 1);
+            quaternions.push_back(transform.orientation);
+        }
+        glm::vec3 rotation = transform.useQuaternion ? glm::vec3(0, 0, 0) : transform.rotation;
+        rotationX.push_back(rotation.x);
+        rotationY.push_back(rotation.y);
+        rotationZ.push_back(rotation.z);
+        scaleX.push_back(transform.scale.x);
+        scaleY.push_back(transform.scale.y);
+        scaleZ.push_back(transform.scale.z);
+    }
+
+    static SimdLevel querySimdLevel() {
+#if defined(OUR_TRANSFORM_BATCH_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+        // The OS must save the YMM registers on context switches (XCR0 bits 1 & 2) for AVX to be usable
+        if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5)) return SimdLevel::AVX2;
+        }
+        return SimdLevel::SSE;
+#elif defined(OUR_TRANSFORM_BATCH_X86)
+        // The builtin also checks that the OS supports the AVX state
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+        return SimdLevel::SSE;
+#else
+        return SimdLevel::SCALAR;
+#endif
+    }
+
+    SimdLevel detectSimdLevel() {
+        static const SimdLevel level = querySimdLevel();
+        return level;
+    }
+
+    const char *simdLevelName(SimdLevel level) {
+        switch (level) {
+            case SimdLevel::SSE:
+                return "SSE";
+            case SimdLevel::AVX2:
+                return "AVX2";
+            default:
+                return "scalar";
+        }
+    }
+
+    // Writes the matrix T * R * S where R = glm::yawPitchRoll(yaw: rotation.y, pitch: rotation.x, roll: rotation.z)
+    // given the sines & cosines of the angles. This is the formula that the SIMD kernels evaluate lane by lane.
+    static void composeOne(const TransformBatch &batch, size_t i, glm::mat4 &matrix) {
+        float sh = std::sin(batch.rotationY[i]), ch = std::cos(batch.rotationY[i]);
+        float sp = std::sin(batch.rotationX[i]), cp = std::cos(batch.rotationX[i]);
+        float sb = std::sin(batch.rotationZ[i]), cb = std::cos(batch.rotationZ[i]);
+        float sx = batch.scaleX[i], sy = batch.scaleY[i], sz = batch.scaleZ[i];
+        matrix[0] = glm::vec4(ch * cb + sh * sp * sb, sb * cp, -sh * cb + ch * sp * sb, 0) * sx;
+        matrix[1] = glm::vec4(-ch * sb + sh * sp * cb, cb * cp, sb * sh + ch * sp * cb, 0) * sy;
+        matrix[2] = glm::vec4(sh * cp, -sp, ch * cp, 0) * sz;
+        matrix[3] = glm::vec4(batch.positionX[i], batch.positionY[i], batch.positionZ[i], 1);
+    }
+
+    static void composeScalar(const TransformBatch &batch, size_t begin, glm::mat4 *matrices) {
+        for (size_t i = begin, count = batch.size(); i < count; ++i) composeOne(batch, i, matrices[i]);
+    }
+
+    // The constants used by the vectorized sincos (from the cephes library)
+    // The angle is reduced to r = x - j * (pi/2) where j is the nearest integer to x * (2/pi) and pi/2 is split into 3 parts
+    // so that the subtraction stays exact. Then sin(r) & cos(r) are approximated by minimax polynomials on [-pi/4, pi/4].
+    namespace sincos_constants {
+        constexpr float TWO_OVER_PI = 0.636619772367581343f;
+        constexpr float PI_OVER_2_A = 1.5703125f;
+        constexpr float PI_OVER_2_B = 4.837512969970703125e-4f;
+        constexpr float PI_OVER_2_C = 7.54978995489188216e-8f;
+        constexpr float SIN_1 = -1.6666654611e-1f, SIN_2 = 8.3321608736e-3f, SIN_3 = -1.9515295891e-4f;
+        constexpr float COS_1 = 4.166664568298827e-2f, COS_2 = -1.388731625493765e-3f, COS_3 = 2.443315711809948e-5f;
+    }
+
+#if defined(OUR_TRANSFORM_BATCH_X86)
+
+    // Computes the sine & cosine of 4 angles at once
+    static inline void sincos4(__m128 x, __m128 &s, __m128 &c) {
+        using namespace sincos_constants;
+        // Range reduction (the conversion rounds to the nearest integer)
+        __m128i j = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(TWO_OVER_PI)));
+        __m128 jf = _mm_cvtepi32_ps(j);
+        __m128 r = _mm_sub_ps(x, _mm_mul_ps(jf, _mm_set1_ps(PI_OVER_2_A)));
+        r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(PI_OVER_2_B)));
+        r = _mm_sub_ps(r, _mm_mul_ps(jf, _mm_set1_ps(PI_OVER_2_C)));
+        __m128 r2 = _mm_mul_ps(r, r);
+
+        // sin(r) = r + r^3 * (SIN_1 + r^2 * (SIN_2 + r^2 * SIN_3))
+        __m128 ps = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_3), r2), _mm_set1_ps(SIN_2));
+        ps = _mm_add_ps(_mm_mul_ps(ps, r2), _mm_set1_ps(SIN_1));
+        ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, r2), r), r);
+        // cos(r) = 1 - r^2 / 2 + r^4 * (COS_1 + r^2 * (COS_2 + r^2 * COS_3))
+        __m128 pc = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_3), r2), _mm_set1_ps(COS_2));
+        pc = _mm_add_ps(_mm_mul_ps(pc, r2), _mm_set1_ps(COS_1));
+        pc = _mm_mul_ps(_mm_mul_ps(pc, r2), r2);
+        pc = _mm_add_ps(_mm_sub_ps(pc, _mm_mul_ps(r2, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+        // Quadrant fix-up: odd quadrants swap sin & cos, sin is negated in quadrants 2 & 3 and cos in quadrants 1 & 2
+        __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+        __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), 30));
+        __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+        s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, pc), _mm_andnot_ps(swap, ps)), sinSign);
+        c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, ps), _mm_andnot_ps(swap, pc)), cosSign);
+    }
+
+    // Stores 4 columns (each holding the same column of 4 matrices) into the 4 matrices
+    static inline void storeColumns(glm::mat4 *matrices, int column, __m128 x, __m128 y, __m128 z, __m128 w) {
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(&matrices[0][column][0], x);
+        _mm_storeu_ps(&matrices[1][column][0], y);
+        _mm_storeu_ps(&matrices[2][column][0], z);
+        _mm_storeu_ps(&matrices[3][column][0], w);
+    }
+
+    static void composeSSE(const TransformBatch &batch, glm::mat4 *matrices) {
+        size_t count = batch.size(), i = 0;
+        const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+        for (; i + 4 <= count; i += 4) {
+            __m128 sh, ch, sp, cp, sb, cb;
+            sincos4(_mm_loadu_ps(&batch.rotationY[i]), sh, ch);
+            sincos4(_mm_loadu_ps(&batch.rotationX[i]), sp, cp);
+            sincos4(_mm_loadu_ps(&batch.rotationZ[i]), sb, cb);
+            __m128 sx = _mm_loadu_ps(&batch.scaleX[i]), sy = _mm_loadu_ps(&batch.scaleY[i]), sz = _mm_loadu_ps(&batch.scaleZ[i]);
+            __m128 shsp = _mm_mul_ps(sh, sp), chsp = _mm_mul_ps(ch, sp);
+
+            __m128 m00 = _mm_add_ps(_mm_mul_ps(ch, cb), _mm_mul_ps(shsp, sb));
+            __m128 m01 = _mm_mul_ps(sb, cp);
+            __m128 m02 = _mm_sub_ps(_mm_mul_ps(chsp, sb), _mm_mul_ps(sh, cb));
+            storeColumns(matrices + i, 0, _mm_mul_ps(m00, sx), _mm_mul_ps(m01, sx), _mm_mul_ps(m02, sx), zero);
+
+            __m128 m10 = _mm_sub_ps(_mm_mul_ps(shsp, cb), _mm_mul_ps(ch, sb));
+            __m128 m11 = _mm_mul_ps(cb, cp);
+            __m128 m12 = _mm_add_ps(_mm_mul_ps(sb, sh), _mm_mul_ps(chsp, cb));
+            storeColumns(matrices + i, 1, _mm_mul_ps(m10, sy), _mm_mul_ps(m11, sy), _mm_mul_ps(m12, sy), zero);
+
+            __m128 m20 = _mm_mul_ps(sh, cp);
+            __m128 m22 = _mm_mul_ps(ch, cp);
+            storeColumns(matrices + i, 2, _mm_mul_ps(m20, sz), _mm_mul_ps(_mm_sub_ps(zero, sp), sz), _mm_mul_ps(m22, sz), zero);
+
+            storeColumns(matrices + i, 3, _mm_loadu_ps(&batch.positionX[i]), _mm_loadu_ps(&batch.positionY[i]),
+                         _mm_loadu_ps(&batch.positionZ[i]), one);
+        }
+        composeScalar(batch, i, matrices);
+    }
+
+    // Same as "sincos4" but for 8 angles at once
+    OUR_TARGET_AVX2 static inline void sincos8(__m256 x, __m256 &s, __m256 &c) {
+        using namespace sincos_constants;
+        __m256i j = _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(TWO_OVER_PI)));
+        __m256 jf = _mm256_cvtepi32_ps(j);
+        __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(jf, _mm256_set1_ps(PI_OVER_2_A)));
+        r = _mm256_sub_ps(r, _mm256_mul_ps(jf, _mm256_set1_ps(PI_OVER_2_B)));
+        r = _mm256_sub_ps(r, _mm256_mul_ps(jf, _mm256_set1_ps(PI_OVER_2_C)));
+        __m256 r2 = _mm256_mul_ps(r, r);
+
+        __m256 ps = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SIN_3), r2), _mm256_set1_ps(SIN_2));
+        ps = _mm256_add_ps(_mm256_mul_ps(ps, r2), _mm256_set1_ps(SIN_1));
+        ps = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(ps, r2), r), r);
+        __m256 pc = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(COS_3), r2), _mm256_set1_ps(COS_2));
+        pc = _mm256_add_ps(_mm256_mul_ps(pc, r2), _mm256_set1_ps(COS_1));
+        pc = _mm256_mul_ps(_mm256_mul_ps(pc, r2), r2);
+        pc = _mm256_add_ps(_mm256_sub_ps(pc, _mm256_mul_ps(r2, _mm256_set1_ps(0.5f))), _mm256_set1_ps(1.0f));
+
+        __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+        __m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), 30));
+        __m256 cosSign = _mm256_castsi256_ps(
+                _mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+        s = _mm256_xor_ps(_mm256_blendv_ps(ps, pc, swap), sinSign);
+        c = _mm256_xor_ps(_mm256_blendv_ps(pc, ps, swap), cosSign);
+    }
+
+    // Stores 4 columns of 8 matrices as two groups of 4 matrices
+    OUR_TARGET_AVX2 static inline void storeColumns8(glm::mat4 *matrices, int column, __m256 x, __m256 y, __m256 z, __m256 w) {
+        storeColumns(matrices, column, _mm256_castps256_ps128(x), _mm256_castps256_ps128(y),
+                     _mm256_castps256_ps128(z), _mm256_castps256_ps128(w));
+        storeColumns(matrices + 4, column, _mm256_extractf128_ps(x, 1), _mm256_extractf128_ps(y, 1),
+                     _mm256_extractf128_ps(z, 1), _mm256_extractf128_ps(w, 1));
+    }
+
+    OUR_TARGET_AVX2 static void composeAVX2(const TransformBatch &batch, glm::mat4 *matrices) {
+        size_t count = batch.size(), i = 0;
+        const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+        for (; i + 8 <= count; i += 8) {
+            __m256 sh, ch, sp, cp, sb, cb;
+            sincos8(_mm256_loadu_ps(&batch.rotationY[i]), sh, ch);
+            sincos8(_mm256_loadu_ps(&batch.rotationX[i]), sp, cp);
+            sincos8(_mm256_loadu_ps(&batch.rotationZ[i]), sb, cb);
+            __m256 sx = _mm256_loadu_ps(&batch.scaleX[i]), sy = _mm256_loadu_ps(&batch.scaleY[i]), sz = _mm256_loadu_ps(&batch.scaleZ[i]);
+            __m256 shsp = _mm256_mul_ps(sh, sp), chsp = _mm256_mul_ps(ch, sp);
+
+            __m256 m00 = _mm256_add_ps(_mm256_mul_ps(ch, cb), _mm256_mul_ps(shsp, sb));
+            __m256 m01 = _mm256_mul_ps(sb, cp);
+            __m256 m02 = _mm256_sub_ps(_mm256_mul_ps(chsp, sb), _mm256_mul_ps(sh, cb));
+            storeColumns8(matrices + i, 0, _mm256_mul_ps(m00, sx), _mm256_mul_ps(m01, sx), _mm256_mul_ps(m02, sx), zero);
+
+            __m256 m10 = _mm256_sub_ps(_mm256_mul_ps(shsp, cb), _mm256_mul_ps(ch, sb));
+            __m256 m11 = _mm256_mul_ps(cb, cp);
+            __m256 m12 = _mm256_add_ps(_mm256_mul_ps(sb, sh), _mm256_mul_ps(chsp, cb));
+            storeColumns8(matrices + i, 1, _mm256_mul_ps(m10, sy), _mm256_mul_ps(m11, sy), _mm256_mul_ps(m12, sy), zero);
+
+            __m256 m20 = _mm256_mul_ps(sh, cp);
+            __m256 m22 = _mm256_mul_ps(ch, cp);
+            storeColumns8(matrices + i, 2, _mm256_mul_ps(m20, sz), _mm256_mul_ps(_mm256_sub_ps(zero, sp), sz),
+                          _mm256_mul_ps(m22, sz), zero);
+
+            storeColumns8(matrices + i, 3, _mm256_loadu_ps(&batch.positionX[i]), _mm256_loadu_ps(&batch.positionY[i]),
+                          _mm256_loadu_ps(&batch.positionZ[i]), one);
+        }
+        composeScalar(batch, i, matrices);
+    }
+
+#endif
+
+    void composeTransforms(const TransformBatch &batch, glm::mat4 *matrices) {
+        composeTransforms(batch, matrices, detectSimdLevel());
+    }
+
+    void composeTransforms(const TransformBatch &batch, glm::mat4 *matrices, SimdLevel level) {
+        // Never run a kernel that the CPU doesn't support
+        if (static_cast<int>(level) > static_cast<int>(detectSimdLevel())) level = SimdLevel::SCALAR;
+#if defined(OUR_TRANSFORM_BATCH_X86)
+        if (level == SimdLevel::AVX2) composeAVX2(batch, matrices);
+        else if (level == SimdLevel::SSE) composeSSE(batch, matrices);
+        else
+#endif
+        composeScalar(batch, 0, matrices);
+        // The kernels used an identity rotation for these, so we only need to rotate their scaled axes
+        for (size_t index = 0; index < batch.quaternionIndices.size(); ++index) {
+            glm::mat4 &matrix = matrices[batch.quaternionIndices[index]];
+            glm::mat3 rotation = glm::mat3_cast(batch.quaternions[index]);
+            for (int column = 0; column < 3; ++column) matrix[column] = glm::vec4(rotation * glm::vec3(matrix[column]), 0.0f);
+        }
+    }
+
+}
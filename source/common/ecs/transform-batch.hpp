@@ -0,0 +1,59 @@
+#pragma once
+
+#include "transform.hpp"
+
+#include <cstddef>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// This file contains a batched version of "Transform::toMat4" that composes the matrices of many transforms at once.
+// The transforms are stored as a structure of arrays (one array per float) so that the SIMD kernels can load
+// the same field of 4 (SSE) or 8 (AVX2) transforms with a single instruction and compute all of them in parallel.
+// The best kernel supported by the CPU is picked at runtime, and a scalar kernel is used on other CPUs/architectures.
+
+namespace our {
+
+    // The instruction sets that the batch kernels can use
+    enum class SimdLevel {
+        SCALAR,
+        SSE,
+        AVX2
+    };
+
+    // Returns the best instruction set supported by the CPU (and the OS) running the application
+    // The detection runs once and the result is cached
+    SimdLevel detectSimdLevel();
+
+    // Returns a readable name for the given instruction set (used when printing the benchmark results)
+    const char *simdLevelName(SimdLevel level);
+
+    // A batch of transforms stored as a structure of arrays
+    struct TransformBatch {
+        std::vector<float> positionX, positionY, positionZ;
+        std::vector<float> rotationX, rotationY, rotationZ;
+        std::vector<float> scaleX, scaleY, scaleZ;
+        // The transforms that use a quaternion rotation don't go through the kernels (they need no trigonometry)
+        // Their indices and orientations are kept here and their matrices are filled after the kernel runs
+        std::vector<size_t> quaternionIndices;
+        std::vector<glm::quat> quaternions;
+
+        size_t size() const { return positionX.size(); }
+
+        // Removes all the transforms (but keeps the memory to avoid reallocating it next time)
+        void clear();
+        // Reserves memory for "count" transforms
+        void reserve(size_t count);
+        // Appends a transform to the end of the batch
+        void push(const Transform &transform);
+    };
+
+    // Computes the matrix of every transform in the batch and writes it to "matrices" (which should hold "batch.size()" matrices)
+    // The result is the same as calling "Transform::toMat4" on every transform, except that the SIMD kernels compute the
+    // sines & cosines using a polynomial approximation (the error is within a few float ulps for angles in [-1000, 1000] radians)
+    void composeTransforms(const TransformBatch &batch, glm::mat4 *matrices);
+
+    // Same as above but using the given instruction set (if the CPU doesn't support it, the scalar kernel is used instead)
+    void composeTransforms(const TransformBatch &batch, glm::mat4 *matrices, SimdLevel level);
+
+}
@@ -1,7 +1,9 @@
 #include "entity.hpp"
 #include "../deserialize-utils.hpp"
+#include "../serialize-utils.hpp"
 
 #include <glm/gtx/euler_angles.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 /// @Author: Abdelaziz Salah Mohammed Abdou.
 /// @Date: 24/3/2023
@@ -14,18 +16,81 @@ namespace our
     // HINT: to convert euler angles to a rotation matrix, you can use glm::yawPitchRoll
     glm::mat4 Transform::toMat4() const
     {
-        // TODO: (Req 3) Write this function
-        // first we need to apply the scaling
-        glm::mat4 ScalingMat = glm::scale(glm::mat4(1.0f), scale); // scale is defined in the .hpp file.
+        // The result is Translation * Rotation * Scaling, but instead of multiplying 3 matrices
+        // we scale the columns of the (cached) rotation matrix and put the position in the last column
+        glm::mat3 R = getRotationMatrix();
+        return glm::mat4(glm::vec4(R[0] * scale.x, 0.0f),
+                         glm::vec4(R[1] * scale.y, 0.0f),
+                         glm::vec4(R[2] * scale.z, 0.0f),
+                         glm::vec4(position, 1.0f));
+    }
 
-        // then we need to apply the rotation using euler
-        glm::mat4 RotationMat = glm::yawPitchRoll(rotation.y, rotation.x, rotation.z); // rotation is defined in the .hpp file.
+    // Returns the rotation matrix, recomputing it only if the rotation changed since the last call
+    glm::mat3 Transform::getRotationMatrix() const
+    {
+        glm::vec4 current = useQuaternion ? glm::vec4(orientation.x, orientation.y, orientation.z, orientation.w)
+                                          : glm::vec4(rotation, 0.0f);
+        if (current != cachedRotation || useQuaternion != cachedQuaternion)
+        {
+            // The quaternion to matrix conversion needs no trigonometry, unlike the euler angles
+            cachedRotationMatrix = useQuaternion ? glm::mat3_cast(orientation)
+                                                 : glm::mat3(glm::yawPitchRoll(rotation.y, rotation.x, rotation.z));
+            cachedRotation = current;
+            cachedQuaternion = useQuaternion;
+        }
+        return cachedRotationMatrix;
+    }
+
+    // Returns the normal matrix, recomputing it only if the rotation or the scale changed since the last call
+    glm::mat3 Transform::getNormalMatrix() const
+    {
+        glm::vec4 current = useQuaternion ? glm::vec4(orientation.x, orientation.y, orientation.z, orientation.w)
+                                          : glm::vec4(rotation, 0.0f);
+        if (current == normalCachedRotation && useQuaternion == normalCachedQuaternion && scale == normalCachedScale)
+            return cachedNormalMatrix;
+        glm::mat3 R = getRotationMatrix();
+        if (scale.x == scale.y && scale.y == scale.z)
+        {
+            // Uniform scale (the common case): the normal matrix is just the rotation divided by the scale
+            float inverse = scale.x != 0.0f ? 1.0f / scale.x : 0.0f;
+            cachedNormalMatrix = R * inverse;
+        }
+        else
+        {
+            // Non-uniform scale: (R * S)^-T = R * S^-1. A zero scale flattens the object so we drop that axis instead of dividing by zero
+            glm::vec3 inverse = glm::vec3(scale.x != 0.0f ? 1.0f / scale.x : 0.0f,
+                                          scale.y != 0.0f ? 1.0f / scale.y : 0.0f,
+                                          scale.z != 0.0f ? 1.0f / scale.z : 0.0f);
+            cachedNormalMatrix = glm::mat3(R[0] * inverse.x, R[1] * inverse.y, R[2] * inverse.z);
+        }
+        normalCachedRotation = current;
+        normalCachedQuaternion = useQuaternion;
+        normalCachedScale = scale;
+        return cachedNormalMatrix;
+    }
+
+    glm::quat Transform::getOrientation() const
+    {
+        return useQuaternion ? orientation : glm::quat_cast(glm::yawPitchRoll(rotation.y, rotation.x, rotation.z));
+    }
 
-        // after that we need to apply the translation
-        glm::mat4 TranslationMat = glm::translate(glm::mat4(1.0f), position); // position is defined in the .hpp file.
+    void Transform::setOrientation(const glm::quat &value)
+    {
+        useQuaternion = true;
+        orientation = glm::normalize(value);
+    }
 
-        // then we just need to return the Translation as it is the final matrix
-        return TranslationMat * RotationMat * ScalingMat;
+    void Transform::rotate(const glm::vec3 &angularVelocity, float deltaTime)
+    {
+        if (!useQuaternion)
+        {
+            rotation += deltaTime * angularVelocity;
+            return;
+        }
+        // The derivative of the orientation is dq/dt = 0.5 * w * q (where w is the angular velocity as a pure quaternion)
+        // One euler step followed by a normalization is accurate enough for the small rotations done in one frame
+        glm::quat spin = glm::quat(0.0f, angularVelocity) * orientation;
+        orientation = glm::normalize(orientation + spin * (0.5f * deltaTime));
     }
 
     // Deserializes the entity data and components from a json object
@@ -34,6 +99,31 @@ namespace our
         position = data.value("position", position);
         rotation = glm::radians(data.value("rotation", glm::degrees(rotation)));
         scale = data.value("scale", scale);
+        // "quaternion": true keeps the rotation as a quaternion (the "rotation" is still written in degrees in the json)
+        bool wasQuaternion = useQuaternion;
+        useQuaternion = data.value("quaternion", useQuaternion);
+        if (useQuaternion && (!wasQuaternion || data.contains("rotation")))
+            orientation = glm::quat_cast(glm::yawPitchRoll(rotation.y, rotation.x, rotation.z));
+    }
+
+    // Writes the transform in binary form (the rotation is written in radians)
+    void Transform::writeBinary(ByteWriter &writer) const
+    {
+        writer.write(position);
+        writer.write(rotation);
+        writer.write(scale);
+        writer.write(useQuaternion);
+        writer.write(orientation);
+    }
+
+    // Reads the transform in the same order it was written
+    void Transform::readBinary(ByteReader &reader)
+    {
+        reader.read(position);
+        reader.read(rotation);
+        reader.read(scale);
+        reader.read(useQuaternion);
+        reader.read(orientation);
     }
 
 }
\ No newline at end of file
@@ -1,21 +1,57 @@
 #pragma once
 
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <json/json.hpp>
 
 namespace our {
 
+    class ByteWriter; // Forward declarations of the binary serialization helpers (see "serialize-utils.hpp")
+    class ByteReader;
+
     // A transform defines the translation, rotation & scale of an object relative to its parent
     struct Transform {
     public:
         glm::vec3 position = glm::vec3(0, 0, 0); // The position is defined as a vec3. (0,0,0) means no translation
         glm::vec3 rotation = glm::vec3(0, 0, 0); // The rotation is defined using euler angles (y: yaw, x: pitch, z: roll). (0,0,0) means no rotation
         glm::vec3 scale = glm::vec3(1, 1, 1); // The scale is defined as a vec3. (1,1,1) means no scaling.
+        // If true, the rotation is defined by "orientation" instead of the euler angles in "rotation" (which are then ignored)
+        // Quaternions don't suffer from gimbal lock and are cheaper to integrate & convert to a matrix (no trigonometry)
+        bool useQuaternion = false;
+        glm::quat orientation = glm::quat(1, 0, 0, 0); // The rotation as a unit quaternion (only used if "useQuaternion" is true)
 
         // This function computes and returns a matrix that represents this transform
         glm::mat4 toMat4() const;
+        // Returns the rotation matrix of this transform. The matrix is cached and only recomputed when the rotation changes.
+        glm::mat3 getRotationMatrix() const;
+        // Returns the matrix that transforms the normals by this transform (the inverse transpose of the upper 3x3 of "toMat4")
+        // Since the rotation is orthonormal, it is simply R * inverse(S) so no matrix inverse is needed.
+        // Like the rotation matrix, it is cached and only recomputed when the rotation or the scale changes.
+        glm::mat3 getNormalMatrix() const;
+        // Returns the rotation as a quaternion (whichever representation is used)
+        glm::quat getOrientation() const;
+        // Switches the transform to the quaternion representation and sets its orientation (the quaternion is normalized)
+        void setOrientation(const glm::quat &value);
+        // Rotates the transform by the given angular velocity (in radians per second) over "deltaTime" seconds
+        // For euler angles, the angular velocity is added to the angles (as the MovementSystem always did)
+        // For quaternions, it is treated as a rotation vector around the parent axes and integrated in quaternion space
+        void rotate(const glm::vec3 &angularVelocity, float deltaTime);
          // Deserializes the entity data and components from a json object
         void deserialize(const nlohmann::json&);
+        // Writes & reads the transform in binary form (see "serialize-utils.hpp")
+        void writeBinary(ByteWriter&) const;
+        void readBinary(ByteReader&);
+
+    private:
+        // The rotation matrix cache, it stores the rotation it was computed from (the euler angles or the quaternion)
+        mutable glm::vec4 cachedRotation = glm::vec4(0, 0, 0, 0);
+        mutable bool cachedQuaternion = false;
+        mutable glm::mat3 cachedRotationMatrix = glm::mat3(1.0f);
+        // The normal matrix cache, it stores the rotation & scale it was computed from
+        mutable glm::vec4 normalCachedRotation = glm::vec4(0, 0, 0, 0);
+        mutable bool normalCachedQuaternion = false;
+        mutable glm::vec3 normalCachedScale = glm::vec3(1, 1, 1);
+        mutable glm::mat3 cachedNormalMatrix = glm::mat3(1.0f);
     };
 
-}
\ No newline at end of file
+}
@@ -1,7 +1,11 @@
 #include "world.hpp"
 #include "../deserialize-utils.hpp"
+#include "../components/component-deserializer.hpp"
 #include <vector>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <unordered_map>
 
 #include "../components/can.hpp"
 #include "../components/obstacle.hpp"
@@ -29,8 +33,18 @@ namespace our {
             return;
         for (const auto &entityData: data) {
             //(Req 8) Create an entity, make its parent "parent" and call its deserialize with "entityData".
-            Entity *newEntity = add();           // create a new entity using the add function in world.hpp
-            newEntity->parent = parent;          // set the parent of the new entity to the given parent
+            Entity *newEntity;
+            if (entityData.contains("prefab")) {
+                // Instantiate the prefab then apply the instance overrides on top of it
+                newEntity = instantiate(entityData["prefab"].get<std::string>(), parent);
+                if (!newEntity) {
+                    std::cerr << "Unknown prefab: " << entityData["prefab"] << std::endl;
+                    continue;
+                }
+            } else {
+                newEntity = add();               // create a new entity using the add function in world.hpp
+                newEntity->parent = parent;      // set the parent of the new entity to the given parent
+            }
             newEntity->deserialize(entityData);  // deserialize the new entity using the given entityData
             if (entityData.contains("children")) // check if the entity has children
             {
@@ -41,10 +55,8 @@ namespace our {
             if (entityData.contains("duplicates")) {
                 glm::vec3 duplicates = glm::vec3(entityData.value("duplicates", duplicates));
                 for (int i = 1; i < (int) duplicates[0]; ++i) {
-                    Entity *newDuplicateEntity = add();           // create a new entity using the add function in world.hpp
-                    newDuplicateEntity->parent = parent;          // set the parent of the new entity to the given parent
-                    newDuplicateEntity->deserialize(
-                            entityData);  // deserialize the new entity using the given entityData
+                    // The duplicate is a copy of the first entity, so we clone it instead of deserializing the same data again
+                    Entity *newDuplicateEntity = clone(newEntity, parent);
                     if ((bool) duplicates[2]) {
                         int horizontal = generateRandomNumber(0, 2);
                         int vertical = generateRandomNumber(0, ENTITIES_UPPER_LIMIT - 1);
@@ -88,4 +100,265 @@ namespace our {
         }
     }
 
-}
\ No newline at end of file
+
+    void Component::markChanged() {
+        if (owner && owner->getWorld())
+            owner->getWorld()->markChanged(this);
+    }
+
+    void World::bumpVersion(Component *component) {
+        component->version = ++changeVersion;
+        typeVersions[component->getTypeID()] = changeVersion;
+    }
+
+    void World::componentAdded(Component *component) {
+        bumpVersion(component);
+        if (component->addedSlot == Component::NOT_PENDING) {
+            component->addedSlot = static_cast<uint32_t>(pendingAdded.size());
+            pendingAdded.push_back(component);
+        }
+    }
+
+    void World::componentRemoved(Component *component) {
+        bumpVersion(component);
+        // The component is deleted after this, so its queued events are replaced by a null that "dispatchEvents" skips
+        if (component->changedSlot != Component::NOT_PENDING) {
+            pendingChanged[component->changedSlot] = nullptr;
+            component->changedSlot = Component::NOT_PENDING;
+        }
+        if (component->addedSlot != Component::NOT_PENDING) {
+            // The observers never knew about this component, so there is nothing to tell them
+            pendingAdded[component->addedSlot] = nullptr;
+            component->addedSlot = Component::NOT_PENDING;
+            return;
+        }
+        if (auto it = observers.find(component->getTypeID()); it != observers.end())
+            for (auto &[id, callback]: it->second.removed) callback(component);
+    }
+
+    void World::markChanged(Component *component) {
+        bumpVersion(component);
+        // A newly added component will be reported as added, so there is no need to report it as changed too
+        if (component->addedSlot != Component::NOT_PENDING || component->changedSlot != Component::NOT_PENDING) return;
+        component->changedSlot = static_cast<uint32_t>(pendingChanged.size());
+        pendingChanged.push_back(component);
+    }
+
+    void World::dispatchEvents() {
+        // The observers can add, change or remove components while handling an event, so the queues are walked in place
+        // (new events are appended & the events of removed components become nulls) till there are no more events
+        size_t added = 0, changed = 0;
+        while (added < pendingAdded.size() || changed < pendingChanged.size()) {
+            for (; added < pendingAdded.size(); ++added) {
+                Component *component = pendingAdded[added];
+                if (!component) continue;
+                component->addedSlot = Component::NOT_PENDING;
+                if (auto it = observers.find(component->getTypeID()); it != observers.end())
+                    for (auto &[id, callback]: it->second.added) callback(component);
+            }
+            for (; changed < pendingChanged.size() && added == pendingAdded.size(); ++changed) {
+                Component *component = pendingChanged[changed];
+                if (!component) continue;
+                component->changedSlot = Component::NOT_PENDING;
+                if (auto it = observers.find(component->getTypeID()); it != observers.end())
+                    for (auto &[id, callback]: it->second.changed) callback(component);
+            }
+        }
+        pendingAdded.clear();
+        pendingChanged.clear();
+    }
+
+    uint32_t World::addObserver(const std::string &type, int event, std::function<void(Component *)> callback) {
+        auto &list = observers[type];
+        auto &callbacks = event == 0 ? list.added : (event == 1 ? list.removed : list.changed);
+        uint32_t id = nextObserverId++;
+        callbacks.emplace_back(id, std::move(callback));
+        return id;
+    }
+
+    void World::removeObserver(uint32_t id) {
+        auto removeFrom = [id](auto &callbacks) {
+            callbacks.erase(std::remove_if(callbacks.begin(), callbacks.end(),
+                                           [id](auto &observer) { return observer.first == id; }), callbacks.end());
+        };
+        for (auto &[type, list]: observers) {
+            removeFrom(list.added);
+            removeFrom(list.removed);
+            removeFrom(list.changed);
+        }
+    }
+
+    void World::deserializePrefabs(const nlohmann::json &data) {
+        if (!data.is_object())
+            return;
+        for (auto &[name, prefabData]: data.items()) {
+            if (auto it = prefabs.find(name); it != prefabs.end()) {
+                deletePrefab(it->second);
+                prefabs.erase(it);
+            }
+            prefabs[name] = createPrefab(prefabData);
+        }
+    }
+
+    Prefab World::createPrefab(const nlohmann::json &data) {
+        Prefab prefab;
+        // The prototype belongs to this world but it is not added to the entities set so no system will ever see it
+        // It also has no world while deserializing so that its components are not reported to the observers
+        prefab.prototype = new Entity();
+        prefab.prototype->world = nullptr;
+        prefab.prototype->parent = nullptr;
+        prefab.prototype->deserialize(data);
+        if (data.contains("children") && data["children"].is_array()) {
+            for (auto &childData: data["children"])
+                prefab.children.push_back(createPrefab(childData));
+        }
+        return prefab;
+    }
+
+    void World::deletePrefab(Prefab &prefab) {
+        for (auto &child: prefab.children) deletePrefab(child);
+        delete prefab.prototype;
+        prefab.prototype = nullptr;
+        prefab.children.clear();
+    }
+
+    void World::clearPrefabs() {
+        for (auto &[name, prefab]: prefabs) deletePrefab(prefab);
+        prefabs.clear();
+    }
+
+    Entity *World::instantiate(const std::string &prefabName, Entity *parent) {
+        auto it = prefabs.find(prefabName);
+        if (it == prefabs.end()) return nullptr;
+        // Instantiates a prefab and its children recursively
+        auto instantiatePrefab = [this](const Prefab &prefab, Entity *parent, auto &self) -> Entity * {
+            Entity *entity = clone(prefab.prototype, parent);
+            for (auto &child: prefab.children) self(child, entity, self);
+            return entity;
+        };
+        return instantiatePrefab(it->second, parent, instantiatePrefab);
+    }
+
+    Entity *World::clone(const Entity *source, Entity *parent) {
+        Entity *entity = add();
+        entity->parent = parent;
+        entity->name = source->name;
+        entity->localTransform = source->localTransform;
+        for (auto component: source->components) {
+            Component *copy = component->clone();
+            copy->addedSlot = copy->changedSlot = Component::NOT_PENDING; // The copy has its own events
+            entity->addComponent(copy);
+        }
+        return entity;
+    }
+
+    // The snapshot layout is:
+    //  - entity count (u32) & the next entity id (u32)
+    //  - for each entity: id (u32), parent id (u32, 0 for root entities), name (string), transform,
+    //    component count (u32) then for each component: type (string), data size (u32) & data
+    WorldSnapshot World::snapshot() const {
+        WorldSnapshot snapshot;
+        ByteWriter writer(snapshot.data, &snapshot.strings);
+        writer.write<uint32_t>(0); // The entity count is patched at the end
+        writer.write<uint32_t>(nextEntityId);
+        uint32_t count = 0;
+        for (auto entity: entities) {
+            if (markedForRemoval.count(entity)) continue; // This entity is about to be deleted
+            ++count;
+            writer.write<uint32_t>(entity->id);
+            writer.write<uint32_t>(entity->parent ? entity->parent->id : 0);
+            writer.writeString(entity->name);
+            entity->localTransform.writeBinary(writer);
+            writer.write<uint32_t>(static_cast<uint32_t>(entity->components.size()));
+            for (auto component: entity->components) {
+                writer.writeString(component->getTypeID());
+                size_t sizeOffset = writer.size();
+                writer.write<uint32_t>(0); // The data size is patched after the component writes its data
+                component->writeBinary(writer);
+                auto dataSize = static_cast<uint32_t>(writer.size() - sizeOffset - sizeof(uint32_t));
+                std::memcpy(snapshot.data.data() + sizeOffset, &dataSize, sizeof(uint32_t));
+            }
+        }
+        std::memcpy(snapshot.data.data(), &count, sizeof(uint32_t));
+        return snapshot;
+    }
+
+    void World::restore(const WorldSnapshot &snapshot) {
+        if (snapshot.empty()) return;
+        ByteReader reader(snapshot.data.data(), snapshot.data.size(), &snapshot.strings);
+
+        // The entities that are currently in the world identified by their ids
+        std::unordered_map<uint32_t, Entity *> entitiesById;
+        for (auto entity: entities) entitiesById[entity->id] = entity;
+        markedForRemoval.clear();
+
+        auto count = reader.read<uint32_t>();
+        auto snapshotNextEntityId = reader.read<uint32_t>();
+        std::unordered_set<Entity *> restored;
+        std::vector<std::pair<Entity *, uint32_t>> parents;
+        parents.reserve(count);
+        for (uint32_t index = 0; index < count && reader.ok(); ++index) {
+            auto id = reader.read<uint32_t>();
+            auto parentId = reader.read<uint32_t>();
+            Entity *entity;
+            if (auto it = entitiesById.find(id); it != entitiesById.end()) {
+                entity = it->second;
+            } else {
+                // The entity was deleted after the snapshot was taken so we recreate it with the same id
+                entity = add();
+                entity->id = id;
+                entitiesById[id] = entity;
+            }
+            restored.insert(entity);
+            parents.emplace_back(entity, parentId);
+            entity->name = reader.readString();
+            entity->localTransform.readBinary(reader);
+
+            // The components are reused as long as their types match the snapshot (which is almost always the case)
+            // Otherwise, the mismatching components are deleted and new ones are created
+            auto componentCount = reader.read<uint32_t>();
+            auto it = entity->components.begin();
+            for (uint32_t c = 0; c < componentCount && reader.ok(); ++c) {
+                std::string type = reader.readString();
+                auto dataSize = reader.read<uint32_t>();
+                const uint8_t *data = snapshot.data.data() + reader.tell();
+                reader.skip(dataSize);
+                if (!reader.ok()) break;
+                Component *component;
+                if (it != entity->components.end() && (*it)->getTypeID() == type) {
+                    component = *it++;
+                } else {
+                    while (it != entity->components.end()) {
+                        componentRemoved(*it);
+                        delete *it;
+                        it = entity->components.erase(it);
+                    }
+                    component = createComponent(type, entity);
+                }
+                if (component) {
+                    ByteReader componentReader(data, dataSize, &snapshot.strings);
+                    component->readBinary(componentReader);
+                    markChanged(component);
+                }
+            }
+            // Delete any component added after the snapshot was taken
+            while (it != entity->components.end()) {
+                componentRemoved(*it);
+                delete *it;
+                it = entity->components.erase(it);
+            }
+        }
+
+        // Now that all the entities exist, we can link each entity to its parent
+        for (auto &[entity, parentId]: parents) {
+            auto it = entitiesById.find(parentId);
+            entity->parent = parentId != 0 && it != entitiesById.end() ? it->second : nullptr;
+        }
+        // Finally, delete the entities that were added after the snapshot was taken
+        for (auto entity: entities)
+            if (!restored.count(entity)) markedForRemoval.insert(entity);
+        deleteMarkedEntities();
+        nextEntityId = std::max(nextEntityId, snapshotNextEntityId);
+    }
+
+}
@@ -1,15 +1,64 @@
 #pragma once
 
+#include <functional>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 #include "entity.hpp"
+#include "../serialize-utils.hpp"
 
 namespace our {
 
+    // A snapshot holds the state of all the entities in a world (their names, parents, transforms & components)
+    // in a compact byte buffer. It is created by "World::snapshot" and applied by "World::restore".
+    class WorldSnapshot {
+        std::vector<uint8_t> data; // The packed entity & component data
+        StringTable strings;       // The names & component types are stored once here and referred to by index
+        friend class World;
+    public:
+        // Returns the size of the packed data in bytes
+        size_t size() const { return data.size(); }
+
+        bool empty() const { return data.empty(); }
+    };
+
+    // A prefab is a named entity template. It is deserialized once into a prototype entity (which is not part of the world)
+    // then every instance is created by cloning the prototype components instead of deserializing the json again
+    struct Prefab {
+        Entity *prototype = nullptr;  // The prototype is owned by the world
+        std::vector<Prefab> children; // The children of the prefab are instantiated along with it
+    };
+
     // This class holds a set of entities
     class World {
         std::unordered_set<Entity *> entities;         // These are the entities held by this world
         std::unordered_set<Entity *> markedForRemoval; // These are the entities that are awaiting to be deleted
         // when deleteMarkedEntities is called
+        uint32_t nextEntityId = 1;                     // The id that will be given to the next added entity (0 means no entity)
+        std::unordered_map<std::string, Prefab> prefabs; // The prefabs that can be instantiated by name
+
+        // The observers of each component type (identified by the type ID) for each kind of event
+        struct Observers {
+            std::vector<std::pair<uint32_t, std::function<void(Component *)>>> added, removed, changed;
+        };
+        std::unordered_map<std::string, Observers> observers;
+        uint32_t nextObserverId = 1;
+        uint64_t changeVersion = 0;                            // Increased on every component add, change or removal
+        std::unordered_map<std::string, uint64_t> typeVersions; // The change version of the last event of each component type
+        // The events waiting for "dispatchEvents" (the events of a removed component are replaced by a null)
+        std::vector<Component *> pendingAdded, pendingChanged;
+
+        // Updates the change version of the component & its type
+        void bumpVersion(Component *component);
+
+        // Adds an observer to the given event list and returns its id
+        uint32_t addObserver(const std::string &type, int event, std::function<void(Component *)> callback);
+
+        // Creates a prototype (and its children) from the json data of an entity
+        Prefab createPrefab(const nlohmann::json &data);
+
+        // Deletes the prototype of a prefab and its children
+        static void deletePrefab(Prefab &prefab);
     public:
         World() = default;
 
@@ -18,8 +67,26 @@ namespace our {
         // This will deserialize a json array of entities and add the new entities to the current world
         // If parent pointer is not null, the new entities will be have their parent set to that given pointer
         // If any of the entities has children, this function will be called recursively for these children
+        // If an entity has a "prefab" key, it is instantiated from that prefab (see "deserializePrefabs")
+        // then the rest of its data (e.g. "name", "position", "rotation", "scale" & extra "components") is applied on top
         void deserialize(const nlohmann::json &data, Entity *parent = nullptr);
 
+        // This will deserialize a json object of prefabs in the form { prefab_name: entity_data, ... }
+        // where the entity data is in the same form read by "deserialize" (including "children")
+        // A prefab with the same name as an existing one replaces it
+        void deserializePrefabs(const nlohmann::json &data);
+
+        // Creates a new entity (with its children) from the prefab with the given name
+        // Returns nullptr if there is no prefab with that name
+        Entity *instantiate(const std::string &prefabName, Entity *parent = nullptr);
+
+        // Creates a new entity with the same name, transform & components (copied) of the given entity
+        // The children of the given entity are not cloned
+        Entity *clone(const Entity *source, Entity *parent = nullptr);
+
+        // Deletes all the prefabs
+        void clearPrefabs();
+
         // This adds an entity to the entities set and returns a pointer to that entity
         // WARNING The entity is owned by this world so don't use "delete" to delete it, instead, call "markForRemoval"
         // to put it in the "markedForRemoval" set. The elements in the "markedForRemoval" set will be removed and
@@ -29,6 +96,7 @@ namespace our {
             // and don't forget to insert it in the suitable container.
             Entity *newEntity = new Entity(); // create a new entity
             newEntity->world = this;          // set the world of the new entity to this
+            newEntity->id = nextEntityId++;   // give the new entity a unique id
             entities.insert(newEntity);       // insert the new entity into the entities set
             return newEntity;                 // return the new entity
         }
@@ -55,6 +123,8 @@ namespace our {
             //     delete *it;
             // }
             for (auto entity: markedForRemoval) {                           // loop over the markedForRemoval set
+                for (auto component: entity->components)
+                    componentRemoved(component); // let the observers know that the components are going away
                 entities.erase(entity); // remove the entity from the entities set
                 delete entity;          // delete the entity
             }
@@ -79,10 +149,82 @@ namespace our {
             }
             deleteMarkedEntities(); // delete the marked entities
             entities.clear();       // clear the entities set
+            clearPrefabs();         // and the prefabs since their prototypes could refer to assets of the cleared level
         }
 
+        // This captures the state of all the entities in the world (except those marked for removal) into a snapshot
+        // Only the component data written by "Component::writeBinary" is captured
+        WorldSnapshot snapshot() const;
+
+        // This restores the world to the state captured in the snapshot
+        // The restore happens in place: entities that still exist (identified by their id) are reused along with their components,
+        // entities removed since the snapshot was taken are recreated and entities added since then are deleted.
+        // WARNING: the snapshot must be taken from this world, entities from another world would be matched by id only.
+        void restore(const WorldSnapshot &snapshot);
+
+        // Change tracking:
+        // The world keeps a change version for each component & each component type which is increased whenever a component is
+        // added, removed or marked as changed. Systems can compare versions to skip the work if nothing changed since their last update.
+        // Observers can also be registered to react to these events:
+        //  - "added" & "changed" events are queued and dispatched when "dispatchEvents" is called
+        //    (so the component data is fully read by then and each component is reported once per dispatch)
+        //  - "removed" events are dispatched immediately since the component is deleted right after
+        // If a component is removed before its "added" event is dispatched, no events are dispatched for it at all.
+
+        // These are called by the entities when a component is added to or is about to be removed from them
+        void componentAdded(Component *component);
+        void componentRemoved(Component *component);
+
+        // This marks the component as changed (call it after changing the component data)
+        void markChanged(Component *component);
+
+        // This dispatches the queued "added" & "changed" events to the observers (usually called once per frame)
+        void dispatchEvents();
+
+        // Returns the change version of the last event of the given component type (0 if there were none)
+        template<typename T>
+        uint64_t getVersion() const {
+            auto it = typeVersions.find(T::getID());
+            return it != typeVersions.end() ? it->second : 0;
+        }
+
+        // Registers a callback to be called whenever a component of type T is added to an entity in this world
+        // The callback is called right away for all the components of type T that are already in the world
+        // Returns an id that can be used to remove the observer (see "removeObserver")
+        template<typename T>
+        uint32_t onAdded(std::function<void(T *)> callback) {
+            for (auto entity: entities)
+                for (auto component: entity->components)
+                    if (component->addedSlot == Component::NOT_PENDING && component->getTypeID() == T::getID())
+                        callback(static_cast<T *>(component));
+            return addObserver(T::getID(), 0, [callback](Component *component) {
+                callback(static_cast<T *>(component));
+            });
+        }
+
+        // Registers a callback to be called whenever a component of type T is about to be removed (or its entity is deleted)
+        template<typename T>
+        uint32_t onRemoved(std::function<void(T *)> callback) {
+            return addObserver(T::getID(), 1, [callback](Component *component) {
+                callback(static_cast<T *>(component));
+            });
+        }
+
+        // Registers a callback to be called whenever a component of type T is marked as changed
+        template<typename T>
+        uint32_t onChanged(std::function<void(T *)> callback) {
+            return addObserver(T::getID(), 2, [callback](Component *component) {
+                callback(static_cast<T *>(component));
+            });
+        }
+
+        // Removes the observer with the given id
+        void removeObserver(uint32_t id);
+
         // Since the world owns all of its entities, they should be deleted alongside it.
         ~World() {
+            // The observers could be already destroyed so we don't tell them about the deleted components
+            observers.clear();
             clear();
         }
 
@@ -0,0 +1,117 @@
+#include "file-watcher.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace our {
+
+    FileWatcher::FileWatcher(const std::vector<std::string> &directories, double pollInterval)
+        : directories(directories), pollInterval(pollInterval) {
+#if defined(__linux__)
+        inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify >= 0) {
+            for (auto &directory: directories)
+                watch(directory);
+            return;
+        }
+        std::cerr << "Couldn't start inotify, the watched files are polled instead" << std::endl;
+#endif
+        // The first scan only records the modification times
+        scan(nullptr);
+        lastScan = std::chrono::steady_clock::now();
+    }
+
+    FileWatcher::~FileWatcher() {
+#if defined(__linux__)
+        if (inotify >= 0)
+            close(inotify);
+#endif
+    }
+
+    void FileWatcher::watch(const std::filesystem::path &directory) {
+#if defined(__linux__)
+        std::error_code error;
+        if (!std::filesystem::is_directory(directory, error))
+            return;
+        // The files are reported when they are closed after writing (not on every write) or when they are moved in
+        // (editors often save to a temporary file then rename it), the created directories are watched too
+        int descriptor = inotify_add_watch(inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (descriptor < 0) {
+            std::cerr << "Couldn't watch the directory: " << directory.generic_string() << std::endl;
+            return;
+        }
+        watchedDirectories[descriptor] = directory.lexically_normal().generic_string();
+        for (auto &entry: std::filesystem::directory_iterator(directory, error))
+            if (entry.is_directory(error))
+                watch(entry.path());
+#endif
+    }
+
+    void FileWatcher::scan(std::vector<std::string> *changed) {
+        for (auto &directory: directories) {
+            std::error_code error;
+            for (auto it = std::filesystem::recursive_directory_iterator(directory, error);
+                 it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+                if (error)
+                    break;
+                if (!it->is_regular_file(error))
+                    continue;
+                auto time = it->last_write_time(error);
+                if (error)
+                    continue;
+                std::string path = it->path().lexically_normal().generic_string();
+                // The new files count as changed too
+                auto [entry, inserted] = modificationTimes.try_emplace(path, time);
+                if (inserted || entry->second != time) {
+                    entry->second = time;
+                    if (changed)
+                        changed->push_back(path);
+                }
+            }
+        }
+    }
+
+    std::vector<std::string> FileWatcher::poll() {
+        std::vector<std::string> changed;
+#if defined(__linux__)
+        if (inotify >= 0) {
+            alignas(inotify_event) char buffer[4096];
+            ssize_t length;
+            while ((length = read(inotify, buffer, sizeof(buffer))) > 0) {
+                for (char *pointer = buffer; pointer < buffer + length;) {
+                    auto event = reinterpret_cast<const inotify_event *>(pointer);
+                    pointer += sizeof(inotify_event) + event->len;
+                    if (event->mask & IN_Q_OVERFLOW)
+                        std::cerr << "Too many files changed at once, some changes were missed" << std::endl;
+                    auto directory = watchedDirectories.find(event->wd);
+                    if (directory == watchedDirectories.end() || event->len == 0)
+                        continue;
+                    std::string path = directory->second + "/" + event->name;
+                    if (event->mask & IN_ISDIR) {
+                        if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                            watch(path);
+                    } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                        changed.push_back(path);
+                }
+            }
+        } else
+#endif
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (std::chrono::duration<double>(now - lastScan).count() < pollInterval)
+                return changed;
+            lastScan = now;
+            scan(&changed);
+        }
+        // A file can be written many times between two calls
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+        return changed;
+    }
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace our {
+
+    // A file watcher reports the files that were written in some directories (and their subdirectories).
+    // On Linux, it uses inotify so the changes are reported by the kernel and checking for them costs nothing when nothing changed.
+    // Elsewhere (or if inotify fails), the modification times of the files are compared every "pollInterval" seconds instead.
+    class FileWatcher {
+        std::vector<std::string> directories;
+        double pollInterval;
+
+        int inotify = -1;                                   // The inotify instance (-1 if the watcher is polling)
+        std::unordered_map<int, std::string> watchedDirectories; // The directory of each inotify watch
+
+        // The last modification time of every file (only used while polling)
+        std::unordered_map<std::string, std::filesystem::file_time_type> modificationTimes;
+        std::chrono::steady_clock::time_point lastScan;
+
+        // Adds an inotify watch to the directory & its subdirectories
+        void watch(const std::filesystem::path &directory);
+        // Compares the modification times of the files to the ones seen before and adds the changed files to "changed"
+        void scan(std::vector<std::string> *changed);
+
+    public:
+        // Starts watching the given directories (the reported paths start with these directories)
+        FileWatcher(const std::vector<std::string> &directories, double pollInterval = 0.5);
+        ~FileWatcher();
+
+        // Returns the files that were written (or created or moved into the directories) since the last call
+        // Each file is listed once with "/" as the separator (e.g. "assets/shaders/lighted.frag")
+        std::vector<std::string> poll();
+
+        bool isPolling() const { return inotify < 0; }
+
+        FileWatcher(const FileWatcher &) = delete;
+        FileWatcher &operator=(const FileWatcher &) = delete;
+    };
+
+}
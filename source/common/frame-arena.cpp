@@ -0,0 +1,58 @@
+#include "frame-arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace our {
+
+    FrameArena::FrameArena(size_t blockSize) : blockSize(std::max<size_t>(blockSize, 64)) {}
+
+    void FrameArena::addBlock(Buffer &buffer, size_t size) {
+        buffer.blocks.push_back({std::make_unique<std::byte[]>(size), size});
+        buffer.offset = 0;
+        stats.capacity += size;
+        ++stats.growths;
+    }
+
+    void FrameArena::reset(Buffer &buffer) {
+        // If the buffer overflowed, replace its blocks with a single block big enough for all of them
+        // so that the next frames of the same size fit in one block
+        if (buffer.blocks.size() > 1) {
+            size_t total = 0;
+            for (auto &block: buffer.blocks) total += block.size;
+            stats.capacity -= total;
+            buffer.blocks.clear();
+            addBlock(buffer, total);
+        }
+        buffer.offset = 0;
+        buffer.used = 0;
+    }
+
+    void FrameArena::beginFrame() {
+        stats.lastFrame = buffers[current].used;
+        current = 1 - current;
+        reset(buffers[current]);
+        stats.used = 0;
+    }
+
+    void *FrameArena::do_allocate(size_t bytes, size_t alignment) {
+        Buffer &buffer = buffers[current];
+        if (!buffer.blocks.empty()) {
+            Block &block = buffer.blocks.back();
+            auto base = reinterpret_cast<uintptr_t>(block.data.get());
+            size_t aligned = ((base + buffer.offset + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base;
+            if (aligned + bytes <= block.size) {
+                buffer.offset = aligned + bytes;
+                buffer.used += bytes;
+                stats.used = buffer.used;
+                stats.peak = std::max(stats.peak, stats.used);
+                return block.data.get() + aligned;
+            }
+        }
+        // The current block is full, so we add a block that is at least as big as the last one (or as the request)
+        size_t size = std::max(buffer.blocks.empty() ? blockSize : buffer.blocks.back().size, bytes + alignment);
+        addBlock(buffer, size);
+        return do_allocate(bytes, alignment);
+    }
+
+}
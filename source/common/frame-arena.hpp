@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace our {
+
+    // A frame arena is a linear (bump) allocator for transient data that only lives for a frame or two
+    // (e.g. the render command lists). Allocating is just moving a pointer forward, deallocating does nothing,
+    // and all the memory is released at once when the frame ends.
+    // The arena is double-buffered: "beginFrame" only resets the memory used two frames ago, so anything allocated
+    // in the previous frame stays valid during the current frame (e.g. data produced by one frame and consumed by the next).
+    // It is a "std::pmr::memory_resource", so it can back any pmr container: std::pmr::vector<T> list(&arena);
+    // Once the arena has grown enough to hold a whole frame, allocating from it never calls malloc.
+    class FrameArena : public std::pmr::memory_resource {
+    public:
+        // The memory statistics of the arena (all sizes are in bytes)
+        struct Stats {
+            size_t used = 0;            // The memory allocated in the current frame so far
+            size_t lastFrame = 0;       // The memory allocated in the whole previous frame
+            size_t peak = 0;            // The largest amount of memory allocated in a single frame
+            size_t capacity = 0;        // The memory owned by both buffers of the arena
+            size_t growths = 0;         // How many times the arena had to allocate a new block from the heap
+        };
+
+        // "blockSize" is the initial size of each buffer. If a frame needs more, the buffer grows.
+        explicit FrameArena(size_t blockSize = 1 << 20);
+
+        FrameArena(const FrameArena &) = delete;
+        FrameArena &operator=(const FrameArena &) = delete;
+
+        // Should be called once at the start of every frame. It resets the buffer used two frames ago and makes it the current one.
+        void beginFrame();
+
+        const Stats &getStats() const { return stats; }
+
+    protected:
+        void *do_allocate(size_t bytes, size_t alignment) override;
+        // Individual allocations are never freed, the memory is reclaimed when the buffer is reset
+        void do_deallocate(void *, size_t, size_t) override {}
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override { return this == &other; }
+
+    private:
+        struct Block {
+            std::unique_ptr<std::byte[]> data;
+            size_t size = 0;
+        };
+        // A buffer is a list of blocks. Normally it has a single block, but if a frame overflows it, more blocks are added
+        // and they are merged into one bigger block the next time the buffer is reset.
+        struct Buffer {
+            std::vector<Block> blocks;
+            size_t offset = 0; // The position of the next allocation in the last block
+            size_t used = 0;   // The bytes allocated from this buffer since it was reset
+        };
+
+        void addBlock(Buffer &buffer, size_t size);
+        void reset(Buffer &buffer);
+
+        Buffer buffers[2];
+        int current = 0;
+        size_t blockSize;
+        Stats stats;
+    };
+
+}
@@ -0,0 +1,53 @@
+#include "gpu-timer.hpp"
+
+namespace our {
+
+    void GpuTimer::initialize() {
+        if (initialized) return;
+        glGenQueries(LATENCY, startQueries);
+        glGenQueries(LATENCY, endQueries);
+        for (bool &slot: pending) slot = false;
+        current = 0;
+        resultCount = 0;
+        lastMilliseconds = averageMilliseconds = 0;
+        initialized = true;
+    }
+
+    void GpuTimer::destroy() {
+        if (!initialized) return;
+        glDeleteQueries(LATENCY, startQueries);
+        glDeleteQueries(LATENCY, endQueries);
+        initialized = false;
+    }
+
+    void GpuTimer::begin() {
+        if (!initialized) return;
+        // The slot was used LATENCY frames ago, so its result should be ready by now
+        if (pending[current]) collect(current);
+        glQueryCounter(startQueries[current], GL_TIMESTAMP);
+    }
+
+    void GpuTimer::end() {
+        if (!initialized) return;
+        glQueryCounter(endQueries[current], GL_TIMESTAMP);
+        pending[current] = true;
+        current = (current + 1) % LATENCY;
+        // Read the oldest result early if the GPU is already done with it
+        if (pending[current]) {
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(endQueries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) collect(current);
+        }
+    }
+
+    void GpuTimer::collect(int slot) {
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(startQueries[slot], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(endQueries[slot], GL_QUERY_RESULT, &end);
+        pending[slot] = false;
+        lastMilliseconds = end > start ? double(end - start) * 1e-6 : 0.0;
+        averageMilliseconds = resultCount == 0 ? lastMilliseconds : averageMilliseconds * 0.9 + lastMilliseconds * 0.1;
+        ++resultCount;
+    }
+
+}
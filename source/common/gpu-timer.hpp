@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <cstddef>
+
+namespace our {
+
+    // A GPU timer measures how long the GPU spends executing the commands issued between "begin" and "end".
+    // It records a timestamp query at both ends, and since the GPU runs a few frames behind the CPU, every timer owns a ring
+    // of query pairs: the result of a frame is read a few frames later (when it is ready) so measuring never stalls the pipeline.
+    // Timestamps (instead of GL_TIME_ELAPSED queries) are used so that timers can be nested or overlapped.
+    class GpuTimer {
+    public:
+        // How many frames can be in flight before a result is read
+        static constexpr int LATENCY = 4;
+
+        GpuTimer() = default;
+        GpuTimer(const GpuTimer &) = delete;
+        GpuTimer &operator=(const GpuTimer &) = delete;
+        ~GpuTimer() { destroy(); }
+
+        // Creates the queries (should be called after OpenGL is loaded)
+        void initialize();
+        // Deletes the queries
+        void destroy();
+
+        // Marks the start & the end of the measured commands (should be called once per frame)
+        void begin();
+        void end();
+
+        // The time of the latest measured frame and a smoothed (exponential moving average) time, both in milliseconds
+        double getLastMilliseconds() const { return lastMilliseconds; }
+        double getMilliseconds() const { return averageMilliseconds; }
+        // Whether at least one result was read
+        bool hasResult() const { return resultCount > 0; }
+
+    private:
+        GLuint startQueries[LATENCY] = {}, endQueries[LATENCY] = {};
+        bool pending[LATENCY] = {};
+        int current = 0;
+        bool initialized = false;
+        size_t resultCount = 0;
+        double lastMilliseconds = 0, averageMilliseconds = 0;
+
+        // Reads the result of the given slot (waits for it if it is not ready yet)
+        void collect(int slot);
+    };
+
+}
@@ -2,6 +2,7 @@
 
 #include "../asset-loader.hpp"
 #include "deserialize-utils.hpp"
+#include <algorithm>
 #include <iostream>
 namespace our
 {
@@ -27,10 +28,33 @@ namespace our
         {
             pipelineState.deserialize(data["pipelineState"]);
         }
-        shader = AssetLoader<ShaderProgram>::get(data["shader"].get<std::string>());
+        std::string shaderName = data["shader"].get<std::string>();
+        variants = AssetLoader<ShaderVariants>::get(shaderName);
+        if (variants)
+        {
+            std::vector<std::string> features;
+            if (data.contains("features"))
+            {
+                features = data["features"].get<std::vector<std::string>>();
+                for (auto &feature : features)
+                    if (!variants->hasFeature(feature))
+                        std::cerr << "The shader \"" << shaderName << "\" doesn't have the feature \"" << feature << "\"" << std::endl;
+            }
+            else
+                features = getDefaultFeatures(data, *variants);
+            shader = variants->get(variants->getMask(features));
+            batchedMask = variants->getMask({"BATCHED"});
+        }
+        else
+            shader = AssetLoader<ShaderProgram>::get(shaderName);
         transparent = data.value("transparent", false);
     }
 
+    std::vector<std::string> Material::getDefaultFeatures(const nlohmann::json &/*data*/, const ShaderVariants &variants) const
+    {
+        return variants.getFeatures();
+    }
+
     // This function should call the setup of its parent and
     // set the "tint" uniform to the value in the member variable tint
     void TintedMaterial::setup() const
@@ -87,47 +111,69 @@ namespace our
     { /**
        * This function prepares the light material for rendering by performing the following steps:
        * 1. Calls the base class `TintedMaterial`'s `setup()` function to perform any necessary setup.
-       * 2. Activates texture unit 0 and binds the albedo texture to it.
-       * 3. Sets the shader uniform "material.albedo" to texture unit 0.
-       * 4. Binds the sampler to texture unit 0.
-       * 5. Repeat steps 2-4 for the specular, emissive, roughness, and ambient occlusion textures.
+       * 2. Binds the albedo, specular, emissive, roughness and ambient occlusion textures to the texture units 0 to 4.
+       * 3. Sets the shader uniforms "material.albedo", ... to their texture units.
        */
         // Call the setup() function of the base class TintedMaterial
         TintedMaterial::setup();
-        // Activate texture unit 0 and bind the albedo texture to it
-        glActiveTexture(GL_TEXTURE0);
-        albedo->bind();
+        bindTextures();
 
-        // Set the shader uniform "material.albedo" to texture unit 0
+        // Set the shader uniforms of the textures to their texture units
         shader->set("material.albedo", 0);
+        shader->set("material.specular", 1);
+        shader->set("material.emissive", 2);
+        shader->set("material.roughness", 3);
+        shader->set("material.ambient_occlusion", 4);
+        shader->set("material.emissive_intensity", emissiveIntensity);
+    }
 
-        // Bind the sampler to texture unit 0
+    std::vector<std::string> LightMaterial::getDefaultFeatures(const nlohmann::json &data, const ShaderVariants &variants) const
+    {
+        std::vector<std::string> defaults;
+        for (auto &feature : variants.getFeatures())
+        {
+            if (feature == "EMISSIVE" && !data.contains("emissive"))
+                continue;
+            if (feature == "AMBIENT_OCCLUSION" && !data.contains("ambient_occlusion"))
+                continue;
+            if (feature == "BATCHED")
+                continue;
+            defaults.push_back(feature);
+        }
+        return defaults;
+    }
+
+    void LightMaterial::bindTextures() const
+    {
+        // Activate texture unit 0 and bind the albedo texture (and the sampler) to it
+        glActiveTexture(GL_TEXTURE0);
+        albedo->bind();
         sampler->bind(0);
 
         // Repeat the above steps for the specular, emissive, roughness, and ambient occlusion textures,
         // using texture units 1, 2, 3, and 4 respectively.
-
         glActiveTexture(GL_TEXTURE1);
         specular->bind();
-        shader->set("material.specular", 1);
         sampler->bind(1);
 
-        glActiveTexture(GL_TEXTURE2);
-        emissive->bind();
-        shader->set("material.emissive", 2);
-        sampler->bind(2);
+        // The emissive & ambient occlusion textures are optional (the shader variant without them doesn't read them)
+        if (emissive)
+        {
+            glActiveTexture(GL_TEXTURE2);
+            emissive->bind();
+            sampler->bind(2);
+        }
 
         glActiveTexture(GL_TEXTURE3);
         roughness->bind();
-        shader->set("material.roughness", 3);
         sampler->bind(3);
 
-        glActiveTexture(GL_TEXTURE4);
-        ambient_occlusion->bind();
-        shader->set("material.ambient_occlusion", 4);
-        sampler->bind(4);
-
-        //
+        if (ambient_occlusion)
+        {
+            glActiveTexture(GL_TEXTURE4);
+            ambient_occlusion->bind();
+            sampler->bind(4);
+        }
     }
 
     void LightMaterial::deserialize(const nlohmann::json &data)
@@ -153,9 +199,14 @@ namespace our
 
         // Read the "emissive" value from the JSON object and assign the corresponding texture from the AssetLoader to the member variable
         emissive = AssetLoader<Texture2D>::get(data.value("emissive", ""));
+        emissiveIntensity = data.value("emissiveIntensity", 1.0f);
 
         // Read the "sampler" value from the JSON object and assign the corresponding sampler from the AssetLoader to the member variable
         sampler = AssetLoader<Sampler>::get(data.value("sampler", ""));
+
+        // The textures are packed after all the materials are loaded
+        textureArray = nullptr;
+        std::fill(std::begin(layers), std::end(layers), -1);
     }
 
 }
\ No newline at end of file
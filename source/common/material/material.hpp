@@ -2,8 +2,10 @@
 
 #include "pipeline-state.hpp"
 #include "../texture/texture2d.hpp"
+#include "../texture/texture-array.hpp"
 #include "../texture/sampler.hpp"
 #include "../shader/shader.hpp"
+#include "../shader/shader-variants.hpp"
 
 #include <glm/vec4.hpp>
 #include <json/json.hpp>
@@ -23,11 +25,25 @@ namespace our
         PipelineState pipelineState;
         ShaderProgram *shader;
         bool transparent;
+        // The variants that "shader" was picked from (null if the shader has no variants)
+        ShaderVariants *variants = nullptr;
+        // The mask of the "BATCHED" variant that the renderers use to draw this material in instanced batches
+        // (computed once in "deserialize" so the renderers don't look the feature up by name every frame)
+        uint32_t batchedMask = 0;
+
+        virtual ~Material() = default;
 
         // This function does 2 things: setup the pipeline state and set the shader program to be used
         virtual void setup() const;
         // This function read a material from a json object
+        // If the shader has variants (see "shader-variants.hpp"), the variant is picked using the list of "features" in the data
+        // (or using the default features of the material type if the data doesn't have this list)
         virtual void deserialize(const nlohmann::json &data);
+
+    protected:
+        // The features used when the data doesn't list them (all the features of the shader, unless the material type knows
+        // which features it needs from the rest of its data)
+        virtual std::vector<std::string> getDefaultFeatures(const nlohmann::json &data, const ShaderVariants &variants) const;
     };
 
     // This material adds a uniform for a tint (a color that will be sent to the shader)
@@ -67,9 +83,24 @@ namespace our
         Texture2D *emissive;
         Texture2D *roughness;
         Texture2D *ambient_occlusion;
+        // The emissive texture is multiplied by this value, so it can be brighter than 1 when the renderer uses HDR (then it blooms)
+        float emissiveIntensity = 1.0f;
+        // When the textures of the material are packed into a texture array (see "AssetLoader<TextureArray>"), this is the array
+        // and the layer of each texture in the order of their texture units (albedo, specular, emissive, roughness & ambient
+        // occlusion, -1 if the material doesn't have the texture). The renderers draw such materials in instanced batches.
+        TextureArray *textureArray = nullptr;
+        GLint layers[5] = {-1, -1, -1, -1, -1};
 
         void setup() const override;
+        // Binds the textures & the sampler to the texture units 0 to 4 (without touching the shader)
+        // The deferred renderer uses it to draw the material with its own G-buffer shader
+        void bindTextures() const;
         void deserialize(const nlohmann::json &data) override;
+
+    protected:
+        // The "EMISSIVE" & "AMBIENT_OCCLUSION" features are only used if the material has an emissive & an ambient occlusion texture
+        // and the "BATCHED" feature is left to the renderers
+        std::vector<std::string> getDefaultFeatures(const nlohmann::json &data, const ShaderVariants &variants) const override;
     };
     // This function returns a new material instance based on the given type
     inline Material *createMaterialFromType(const std::string &type)
@@ -87,6 +87,18 @@ namespace our
 
         // Given a json object, this function deserializes a PipelineState structure
         void deserialize(const nlohmann::json &data);
+
+        // Two states are equal if they configure OpenGL the same way (used to know if two materials can be drawn together)
+        bool operator==(const PipelineState &other) const
+        {
+            return faceCulling.enabled == other.faceCulling.enabled && faceCulling.culledFace == other.faceCulling.culledFace &&
+                   faceCulling.frontFace == other.faceCulling.frontFace && depthTesting.enabled == other.depthTesting.enabled &&
+                   depthTesting.function == other.depthTesting.function && blending.enabled == other.blending.enabled &&
+                   blending.equation == other.blending.equation && blending.sourceFactor == other.blending.sourceFactor &&
+                   blending.destinationFactor == other.blending.destinationFactor &&
+                   blending.constantColor == other.blending.constantColor && colorMask == other.colorMask && depthMask == other.depthMask;
+        }
+        bool operator!=(const PipelineState &other) const { return !(*this == other); }
     };
 
 }
\ No newline at end of file
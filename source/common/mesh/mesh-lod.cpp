@@ -0,0 +1,378 @@
+#include "mesh-lod.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <unordered_map>
+
+namespace
+{
+
+    // A quadric stores the sum of the squared distances from a point to a set of planes as a symmetric 4x4 matrix
+    // So the error of moving a vertex to a new position is the sum of the squared distances from that position to the
+    // planes of the triangles around it (including the triangles that were already collapsed into it)
+    struct Quadric
+    {
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0, a11 = 0, a12 = 0, a13 = 0, a22 = 0, a23 = 0, a33 = 0;
+        double weight = 0;
+
+        // Adds the plane "dot(normal, p) + d = 0" (the normal must be normalized)
+        void addPlane(const glm::dvec3 &normal, double d, double planeWeight)
+        {
+            a00 += planeWeight * normal.x * normal.x;
+            a01 += planeWeight * normal.x * normal.y;
+            a02 += planeWeight * normal.x * normal.z;
+            a03 += planeWeight * normal.x * d;
+            a11 += planeWeight * normal.y * normal.y;
+            a12 += planeWeight * normal.y * normal.z;
+            a13 += planeWeight * normal.y * d;
+            a22 += planeWeight * normal.z * normal.z;
+            a23 += planeWeight * normal.z * d;
+            a33 += planeWeight * d * d;
+            weight += planeWeight;
+        }
+
+        // Returns the weighted average of the squared distances from "p" to the planes
+        double evaluate(const glm::dvec3 &p) const
+        {
+            double sum = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z + a33 +
+                         2 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z + a03 * p.x + a13 * p.y + a23 * p.z);
+            return weight > 0 ? std::max(sum, 0.0) / weight : 0.0;
+        }
+
+        Quadric &operator+=(const Quadric &other)
+        {
+            a00 += other.a00, a01 += other.a01, a02 += other.a02, a03 += other.a03;
+            a11 += other.a11, a12 += other.a12, a13 += other.a13;
+            a22 += other.a22, a23 += other.a23, a33 += other.a33;
+            weight += other.weight;
+            return *this;
+        }
+    };
+
+    // A possible collapse of the vertex "from" into the vertex "to"
+    // The versions are the versions of the two vertices when the cost was computed (if any of them changed since, the cost is stale)
+    struct Collapse
+    {
+        double cost;
+        uint32_t from, to;
+        uint32_t fromVersion, toVersion;
+
+        bool operator>(const Collapse &other) const { return cost > other.cost; }
+    };
+
+    // The edges on the border of the mesh or on a seam (where the texture coordinates or the normals are split) get these
+    // extra planes (perpendicular to the triangle) so that the border keeps its shape while the rest is simplified
+    constexpr double BORDER_WEIGHT = 10.0;
+
+    // Returns a key for the edge between two positions that doesn't depend on the edge direction
+    uint64_t edgeKey(uint32_t a, uint32_t b)
+    {
+        if (a > b)
+            std::swap(a, b);
+        return (uint64_t(a) << 32) | b;
+    }
+
+    class Simplifier
+    {
+        const std::vector<our::Vertex> &vertices;
+        // The vertices that have the same position are welded together (a seam of the mesh splits a position into many vertices)
+        // So the collapses move positions, and every corner of a triangle remembers which vertex of its position it uses
+        std::vector<uint32_t> positionOf;                 // The position of each vertex
+        std::vector<glm::dvec3> positions;                // The unique positions
+        std::vector<std::vector<uint32_t>> verticesAt;    // The vertices at each position
+        std::vector<std::vector<uint32_t>> trianglesAt;   // The triangles around each position (some of them may be removed)
+        std::vector<Quadric> quadrics;
+        std::vector<uint32_t> versions;
+        std::vector<bool> removedPositions;
+        std::vector<uint32_t> corners; // 3 vertices per triangle
+        std::vector<bool> removedTriangles;
+        size_t triangleCount = 0;
+        double maxError = 0;
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+        // Kept here to avoid reallocating them for every collapse
+        std::vector<uint32_t> fromNeighbors, toNeighbors;
+
+        uint32_t positionOfCorner(size_t triangle, int corner) const { return positionOf[corners[3 * triangle + corner]]; }
+
+        bool hasPosition(size_t triangle, uint32_t position) const
+        {
+            return positionOfCorner(triangle, 0) == position || positionOfCorner(triangle, 1) == position ||
+                   positionOfCorner(triangle, 2) == position;
+        }
+
+        glm::dvec3 triangleNormal(size_t triangle, uint32_t replaced, uint32_t replacement) const
+        {
+            glm::dvec3 p[3];
+            for (int corner = 0; corner < 3; ++corner)
+            {
+                uint32_t position = positionOfCorner(triangle, corner);
+                p[corner] = positions[position == replaced ? replacement : position];
+            }
+            return glm::cross(p[1] - p[0], p[2] - p[0]);
+        }
+
+        void addCandidate(uint32_t a, uint32_t b)
+        {
+            Quadric sum = quadrics[a];
+            sum += quadrics[b];
+            double costAtB = sum.evaluate(positions[b]), costAtA = sum.evaluate(positions[a]);
+            if (costAtB <= costAtA)
+                queue.push({costAtB, a, b, versions[a], versions[b]});
+            else
+                queue.push({costAtA, b, a, versions[b], versions[a]});
+        }
+
+        // Collects the positions connected to the given position by an edge
+        void collectNeighbors(uint32_t position, std::vector<uint32_t> &neighbors) const
+        {
+            neighbors.clear();
+            for (auto triangle : trianglesAt[position])
+            {
+                if (removedTriangles[triangle])
+                    continue;
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    uint32_t other = positionOfCorner(triangle, corner);
+                    if (other != position)
+                        neighbors.push_back(other);
+                }
+            }
+            std::sort(neighbors.begin(), neighbors.end());
+            neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        }
+
+        // Checks that the collapse doesn't flip the triangles around "from" or tear the surface
+        bool isValid(uint32_t from, uint32_t to)
+        {
+            // If the two positions share more than 2 neighbors, the collapse would fold the surface onto itself
+            collectNeighbors(from, fromNeighbors);
+            collectNeighbors(to, toNeighbors);
+            size_t shared = 0;
+            for (auto neighbor : fromNeighbors)
+                if (std::binary_search(toNeighbors.begin(), toNeighbors.end(), neighbor))
+                    ++shared;
+            if (shared > 2)
+                return false;
+            for (auto triangle : trianglesAt[from])
+            {
+                if (removedTriangles[triangle] || hasPosition(triangle, to))
+                    continue;
+                glm::dvec3 before = triangleNormal(triangle, from, from), after = triangleNormal(triangle, from, to);
+                // Reject the collapse if a triangle turns by more than ~75 degrees (or becomes a line)
+                if (glm::dot(before, after) < 0.25 * glm::length(before) * glm::length(after) || glm::length(after) == 0.0)
+                    return false;
+            }
+            return true;
+        }
+
+        // Picks the vertex at the given position whose attributes are the closest to the given vertex
+        uint32_t matchVertex(uint32_t position, uint32_t vertex) const
+        {
+            const our::Vertex &original = vertices[vertex];
+            uint32_t best = verticesAt[position][0];
+            float bestDistance = INFINITY;
+            for (auto candidate : verticesAt[position])
+            {
+                glm::vec2 uv = vertices[candidate].tex_coord - original.tex_coord;
+                glm::vec3 normal = vertices[candidate].normal - original.normal;
+                float distance = glm::dot(uv, uv) + glm::dot(normal, normal);
+                if (distance < bestDistance)
+                {
+                    best = candidate;
+                    bestDistance = distance;
+                }
+            }
+            return best;
+        }
+
+        void collapse(uint32_t from, uint32_t to, double cost)
+        {
+            for (auto triangle : trianglesAt[from])
+            {
+                if (removedTriangles[triangle])
+                    continue;
+                if (hasPosition(triangle, to))
+                {
+                    // The triangles on the collapsed edge become lines
+                    removedTriangles[triangle] = true;
+                    --triangleCount;
+                    continue;
+                }
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    uint32_t &vertex = corners[3 * triangle + corner];
+                    if (positionOf[vertex] == from)
+                        vertex = matchVertex(to, vertex);
+                }
+                trianglesAt[to].push_back(triangle);
+            }
+            trianglesAt[from].clear();
+            removedPositions[from] = true;
+            quadrics[to] += quadrics[from];
+            ++versions[from];
+            ++versions[to];
+            maxError = std::max(maxError, std::sqrt(cost));
+
+            // Drop the removed triangles from the position & compute the new costs of its edges
+            auto &triangles = trianglesAt[to];
+            triangles.erase(std::remove_if(triangles.begin(), triangles.end(), [this](uint32_t triangle)
+                                           { return removedTriangles[triangle]; }),
+                            triangles.end());
+            collectNeighbors(to, toNeighbors);
+            for (auto neighbor : toNeighbors)
+                addCandidate(to, neighbor);
+        }
+
+    public:
+        Simplifier(const std::vector<our::Vertex> &vertices, const std::vector<unsigned int> &elements) : vertices(vertices)
+        {
+            // Weld the vertices by position
+            std::unordered_map<glm::vec3, uint32_t> positionIndices;
+            positionOf.resize(vertices.size());
+            for (size_t vertex = 0; vertex < vertices.size(); ++vertex)
+            {
+                auto [it, inserted] = positionIndices.emplace(vertices[vertex].position, uint32_t(positions.size()));
+                if (inserted)
+                {
+                    positions.push_back(glm::dvec3(vertices[vertex].position));
+                    verticesAt.emplace_back();
+                }
+                positionOf[vertex] = it->second;
+                verticesAt[it->second].push_back(uint32_t(vertex));
+            }
+            trianglesAt.resize(positions.size());
+            quadrics.resize(positions.size());
+            versions.resize(positions.size(), 0);
+            removedPositions.resize(positions.size(), false);
+
+            // Keep the triangles that aren't already degenerate & add their planes to the quadrics of their corners
+            // The edges are counted to find the borders, and the vertices on each side of an edge are compared to find the seams
+            struct EdgeUse
+            {
+                uint32_t count, a, b;
+                bool seam;
+            };
+            std::unordered_map<uint64_t, EdgeUse> edges;
+            for (size_t element = 0; element + 2 < elements.size(); element += 3)
+            {
+                uint32_t triangleCorners[3] = {elements[element], elements[element + 1], elements[element + 2]};
+                uint32_t p0 = positionOf[triangleCorners[0]], p1 = positionOf[triangleCorners[1]], p2 = positionOf[triangleCorners[2]];
+                if (p0 == p1 || p1 == p2 || p2 == p0)
+                    continue;
+                size_t triangle = corners.size() / 3;
+                corners.insert(corners.end(), triangleCorners, triangleCorners + 3);
+                glm::dvec3 normal = glm::cross(positions[p1] - positions[p0], positions[p2] - positions[p0]);
+                double area = glm::length(normal) * 0.5;
+                Quadric plane;
+                if (area > 0)
+                {
+                    normal = glm::normalize(normal);
+                    plane.addPlane(normal, -glm::dot(normal, positions[p0]), area);
+                }
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    uint32_t position = positionOf[triangleCorners[corner]];
+                    trianglesAt[position].push_back(uint32_t(triangle));
+                    quadrics[position] += plane;
+                    uint32_t a = triangleCorners[corner], b = triangleCorners[(corner + 1) % 3];
+                    auto [it, inserted] = edges.emplace(edgeKey(positionOf[a], positionOf[b]), EdgeUse{1, a, b, false});
+                    if (!inserted)
+                    {
+                        ++it->second.count;
+                        // The neighbor triangle walks the edge in the opposite direction
+                        if (it->second.a != b || it->second.b != a)
+                            it->second.seam = true;
+                    }
+                }
+            }
+            triangleCount = corners.size() / 3;
+            removedTriangles.resize(triangleCount, false);
+
+            // Add the border planes then queue the initial collapses
+            for (auto &[key, edge] : edges)
+            {
+                uint32_t a = uint32_t(key >> 32), b = uint32_t(key & 0xFFFFFFFFu);
+                if (edge.count == 1 || edge.seam)
+                {
+                    // The border plane contains the edge & is perpendicular to one of the triangles around it
+                    glm::dvec3 direction = positions[b] - positions[a];
+                    glm::dvec3 faceNormal(0.0);
+                    for (auto triangle : trianglesAt[a])
+                    {
+                        if (hasPosition(triangle, b))
+                        {
+                            faceNormal = triangleNormal(triangle, a, a);
+                            break;
+                        }
+                    }
+                    glm::dvec3 normal = glm::cross(direction, faceNormal);
+                    double length = glm::length(normal);
+                    if (length > 0)
+                    {
+                        normal /= length;
+                        Quadric border;
+                        border.addPlane(normal, -glm::dot(normal, positions[a]), glm::dot(direction, direction) * BORDER_WEIGHT);
+                        quadrics[a] += border;
+                        quadrics[b] += border;
+                    }
+                }
+            }
+            for (auto &[key, edge] : edges)
+                addCandidate(uint32_t(key >> 32), uint32_t(key & 0xFFFFFFFFu));
+        }
+
+        size_t getTriangleCount() const { return triangleCount; }
+        float getError() const { return float(maxError); }
+
+        // Collapses the cheapest edges until at most "target" triangles remain (or until nothing can be collapsed)
+        void simplify(size_t target)
+        {
+            while (triangleCount > target && !queue.empty())
+            {
+                Collapse candidate = queue.top();
+                queue.pop();
+                if (removedPositions[candidate.from] || removedPositions[candidate.to] ||
+                    versions[candidate.from] != candidate.fromVersion || versions[candidate.to] != candidate.toVersion)
+                    continue;
+                if (!isValid(candidate.from, candidate.to))
+                    continue;
+                collapse(candidate.from, candidate.to, candidate.cost);
+            }
+        }
+
+        std::vector<unsigned int> getElements() const
+        {
+            std::vector<unsigned int> elements;
+            elements.reserve(triangleCount * 3);
+            for (size_t triangle = 0; triangle < removedTriangles.size(); ++triangle)
+            {
+                if (!removedTriangles[triangle])
+                    elements.insert(elements.end(), corners.begin() + 3 * triangle, corners.begin() + 3 * triangle + 3);
+            }
+            return elements;
+        }
+    };
+
+}
+
+std::vector<our::MeshLOD> our::mesh_utils::generateLODs(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements,
+                                                        int count, float ratio)
+{
+    std::vector<MeshLOD> lods;
+    Simplifier simplifier(vertices, elements);
+    size_t previous = simplifier.getTriangleCount();
+    for (int level = 0; level < count; ++level)
+    {
+        size_t target = size_t(previous * ratio);
+        simplifier.simplify(target);
+        size_t remaining = simplifier.getTriangleCount();
+        // Stop if the level is not much simpler than the one before it (the rest of the edges can't be collapsed)
+        if (remaining == 0 || remaining > previous * 0.9)
+            break;
+        lods.push_back({simplifier.getElements(), simplifier.getError()});
+        previous = remaining;
+    }
+    return lods;
+}
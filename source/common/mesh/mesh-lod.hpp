@@ -0,0 +1,16 @@
+#pragma once
+
+#include "mesh.hpp"
+#include <vector>
+
+namespace our::mesh_utils {
+
+    // Generates up to "count" levels of detail for the given triangles. Each level keeps about "ratio" of the triangles of
+    // the level before it. The levels are made by collapsing the edges of the mesh one by one (the edge that changes the
+    // surface the least is collapsed first, where the change is measured using the quadric error metric). An edge is
+    // collapsed into one of its vertices, so the levels only contain new elements and they share the vertices of the mesh.
+    // The generation stops early if the mesh can't be simplified any further (e.g. a cube stays as it is).
+    std::vector<MeshLOD> generateLODs(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements,
+                                      int count, float ratio = 0.5f);
+
+}
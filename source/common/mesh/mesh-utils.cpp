@@ -1,4 +1,5 @@
 #include "mesh-utils.hpp"
+#include "mesh-lod.hpp"
 
 // We will use "Tiny OBJ Loader" to read and process '.obj" files
 #define TINYOBJLOADER_IMPLEMENTATION
@@ -8,7 +9,7 @@
 #include <vector>
 #include <unordered_map>
 
-our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
+our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename, int lods) {
 
     // The data that we will use to initialize our mesh
     std::vector<our::Vertex> vertices;
@@ -81,6 +82,8 @@ our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
         }
     }
 
+    if (lods > 0)
+        return new our::Mesh(vertices, elements, generateLODs(vertices, elements, lods));
     return new our::Mesh(vertices, elements);
 }
 
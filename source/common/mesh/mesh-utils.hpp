@@ -5,7 +5,8 @@
 
 namespace our::mesh_utils {
     // Load an ".obj" file into the mesh
-    Mesh* loadOBJ(const std::string& filename);
+    // If "lods" is more than 0, up to that many levels of detail are generated for the mesh (see "mesh-lod.hpp")
+    Mesh* loadOBJ(const std::string& filename, int lods = 0);
     // Create a sphere (the vertex order in the triangles are CCW from the outside)
     // Segments define the number of divisions on the both the latitude and the longitude
     Mesh* sphere(const glm::ivec2& segments);
@@ -4,6 +4,8 @@
 #pragma once
 
 #include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <vector>
 #include "vertex.hpp"
 
 namespace our
@@ -14,6 +16,13 @@ namespace our
 #define ATTRIB_LOC_TEXCOORD 2
 #define ATTRIB_LOC_NORMAL 3
 
+    // A simplified version of the mesh triangles that uses the same vertices (see "mesh-lod.hpp")
+    struct MeshLOD
+    {
+        std::vector<unsigned int> elements;
+        float error; // How far the simplified surface can be from the original one (in the local space of the mesh)
+    };
+
     class Mesh
     {
         // Here, we store the object names of the 3 main components of a mesh:
@@ -27,6 +36,16 @@ namespace our
         ////////////////////////////////////////////////////////////////////////////////
         // We need to remember the number of elements that will be draw by glDrawElements
         GLsizei elementCount;
+        // The levels of detail are stored after the original elements in the element buffer
+        // The level 0 is the original mesh, and each level after it has fewer triangles and a larger error
+        struct Level
+        {
+            GLsizei offset, count;
+            float error;
+        };
+        std::vector<Level> levels;
+        // The axis aligned bounding box of the vertices (used to cull the objects that are out of view)
+        glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
 
     public:
         // The constructor takes two vectors:
@@ -36,7 +55,8 @@ namespace our
         // a vertex buffer to store the vertex data on the VRAM,
         // an element buffer to store the element data on the VRAM,
         // a vertex array object to define how to read the vertex & element buffer during rendering
-        Mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements)
+        // The optional levels of detail are simplified versions of the elements (ordered from the finest to the coarsest)
+        Mesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &elements, const std::vector<MeshLOD> &lods = {})
         {
             /// keda lazm  el buffers tartebhom yefr2
             /// kman lazm lama tegy t3ml el attribute pointer lazm be3ml kol el elements el gowaha ,
@@ -78,24 +98,79 @@ namespace our
             // binding the name
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
             // defining the data to be sent, and defining how to send them
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(unsigned int), elements.data(), GL_STATIC_DRAW);
+            // (the levels of detail are appended after the original elements)
+            size_t totalCount = elements.size();
+            for (auto &lod : lods)
+                totalCount += lod.elements.size();
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, totalCount * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, elements.size() * sizeof(unsigned int), elements.data());
 
             //  remember to store the number of elements in "elementCount" since you will need it for drawing
             elementCount = elements.size();
+            levels.push_back({0, elementCount, 0.0f});
+            GLsizei offset = elementCount;
+            for (auto &lod : lods)
+            {
+                glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, offset * sizeof(unsigned int), lod.elements.size() * sizeof(unsigned int),
+                                lod.elements.data());
+                levels.push_back({offset, GLsizei(lod.elements.size()), lod.error});
+                offset += lod.elements.size();
+            }
+
+            // Compute the bounding box while we still have the vertices on the RAM
+            if (!vertices.empty())
+            {
+                boundsMin = boundsMax = vertices[0].position;
+                for (auto &vertex : vertices)
+                {
+                    boundsMin = glm::min(boundsMin, vertex.position);
+                    boundsMax = glm::max(boundsMax, vertex.position);
+                }
+            }
+        }
+
+        // The bounding sphere of the mesh (around the center of its bounding box)
+        glm::vec3 getBoundsCenter() const { return (boundsMin + boundsMax) * 0.5f; }
+        float getBoundsRadius() const { return glm::length(boundsMax - boundsMin) * 0.5f; }
+
+        int getLODCount() const { return int(levels.size()); }
+        float getLODError(int level) const { return levels[level].error; }
+        GLsizei getElementCount(int level = 0) const { return levels[level].count; }
+
+        // Picks the coarsest level whose error covers at most "threshold" pixels on the screen
+        // "pixelsPerUnit" is the number of pixels covered by one unit of the local space of the mesh where the object is
+        // "current" is the level picked for the object in the last frame. Switching to a coarser level requires the error to be
+        // below "threshold * (1 - hysteresis)" so that an object near the switching distance doesn't pop back and forth every frame.
+        int selectLOD(float pixelsPerUnit, int current, float threshold, float hysteresis) const
+        {
+            int level = 0;
+            while (level + 1 < int(levels.size()) && levels[level + 1].error * pixelsPerUnit <= threshold)
+                ++level;
+            while (level > current && levels[level].error * pixelsPerUnit > threshold * (1.0f - hysteresis))
+                --level;
+            return level;
         }
 
         // this function should render the mesh
         /*
             utility function to draw the mesh
         */
-        void draw()
+        void draw(int level = 0)
         {
             // TODO: (Req 2) Write this function
             glBindVertexArray(VAO);
-            glDrawElements(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT, (void *)0);
+            glDrawElements(GL_TRIANGLES, levels[level].count, GL_UNSIGNED_INT, (void *)(levels[level].offset * sizeof(unsigned int)));
             // glswap buffer should be here?
         }
 
+        // Draws "count" instances of the mesh (the shader picks the data of each instance using gl_InstanceID)
+        void drawInstanced(GLsizei count, int level = 0)
+        {
+            glBindVertexArray(VAO);
+            glDrawElementsInstanced(GL_TRIANGLES, levels[level].count, GL_UNSIGNED_INT,
+                                    (void *)(levels[level].offset * sizeof(unsigned int)), count);
+        }
+
         // this function should delete the vertex & element buffers and the vertex array object
         ~Mesh()
         {
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <type_traits>
+
+// This file contains some helper code for binary serialization which includes:
+// - A string table that interns strings (e.g. asset names) such that each unique string is stored once
+// - A writer that appends plain-old-data values and strings to a byte buffer
+// - A reader that reads them back in the same order
+// The byte layout is the native one (we only read data written by the same build on the same machine)
+
+namespace our {
+
+    // A string table stores each unique string once and refers to it by its index
+    class StringTable {
+        std::vector<std::string> strings;
+        std::unordered_map<std::string, uint32_t> indices;
+    public:
+        // Returns the index of the given string, adding it to the table if it was not added before
+        uint32_t intern(const std::string &value) {
+            if (auto it = indices.find(value); it != indices.end()) return it->second;
+            auto index = static_cast<uint32_t>(strings.size());
+            strings.push_back(value);
+            indices[value] = index;
+            return index;
+        }
+
+        // Returns the string at the given index or an empty string if the index is out of range
+        const std::string &get(uint32_t index) const {
+            static const std::string empty;
+            return index < strings.size() ? strings[index] : empty;
+        }
+
+        // Appends a string that was already interned somewhere else (used while reading a table from a file)
+        void push(std::string value) {
+            indices[value] = static_cast<uint32_t>(strings.size());
+            strings.push_back(std::move(value));
+        }
+
+        size_t size() const { return strings.size(); }
+
+        const std::vector<std::string> &getStrings() const { return strings; }
+
+        void clear() {
+            strings.clear();
+            indices.clear();
+        }
+    };
+
+    // This class appends binary data to a byte buffer
+    // If a string table is given, strings are written as indices into the table, otherwise they are written inline
+    class ByteWriter {
+        std::vector<uint8_t> &buffer;
+        StringTable *strings;
+    public:
+        explicit ByteWriter(std::vector<uint8_t> &buffer, StringTable *strings = nullptr) : buffer(buffer),
+                                                                                             strings(strings) {}
+
+        // Writes the raw bytes of a trivially copyable value (ints, floats, glm vectors & matrices, etc.)
+        template<typename T>
+        void write(const T &value) {
+            static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+            writeBytes(&value, sizeof(T));
+        }
+
+        void writeBytes(const void *data, size_t size) {
+            auto bytes = static_cast<const uint8_t *>(data);
+            buffer.insert(buffer.end(), bytes, bytes + size);
+        }
+
+        void writeString(const std::string &value) {
+            if (strings) {
+                write<uint32_t>(strings->intern(value));
+            } else {
+                write<uint32_t>(static_cast<uint32_t>(value.size()));
+                writeBytes(value.data(), value.size());
+            }
+        }
+
+        size_t size() const { return buffer.size(); }
+    };
+
+    // This class reads binary data written by the ByteWriter
+    // Reading past the end does not crash, instead it returns zeros and "ok" starts returning false
+    class ByteReader {
+        const uint8_t *data;
+        size_t size;
+        size_t offset = 0;
+        const StringTable *strings;
+        bool valid = true;
+    public:
+        ByteReader(const uint8_t *data, size_t size, const StringTable *strings = nullptr) : data(data), size(size),
+                                                                                             strings(strings) {}
+
+        template<typename T>
+        T read() {
+            static_assert(std::is_trivially_copyable<T>::value, "T must be trivially copyable");
+            T value{};
+            readBytes(&value, sizeof(T));
+            return value;
+        }
+
+        // Reads into an existing value (useful to keep the default value if the data is missing)
+        template<typename T>
+        void read(T &value) {
+            value = read<T>();
+        }
+
+        void readBytes(void *destination, size_t count) {
+            if (offset + count > size) {
+                valid = false;
+                std::memset(destination, 0, count);
+                offset = size;
+                return;
+            }
+            std::memcpy(destination, data + offset, count);
+            offset += count;
+        }
+
+        std::string readString() {
+            if (strings) return strings->get(read<uint32_t>());
+            auto length = read<uint32_t>();
+            if (offset + length > size) {
+                valid = false;
+                offset = size;
+                return {};
+            }
+            std::string value(reinterpret_cast<const char *>(data + offset), length);
+            offset += length;
+            return value;
+        }
+
+        // Skips the given number of bytes
+        void skip(size_t count) {
+            if (offset + count > size) {
+                valid = false;
+                offset = size;
+            } else offset += count;
+        }
+
+        size_t tell() const { return offset; }
+
+        size_t remaining() const { return size - offset; }
+
+        bool ok() const { return valid; }
+    };
+
+}
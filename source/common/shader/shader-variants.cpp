@@ -0,0 +1,58 @@
+#include "shader-variants.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace our
+{
+
+    ShaderVariants::ShaderVariants(const std::string &vertexShader, const std::string &fragmentShader,
+                                   const std::vector<std::string> &features, const std::vector<std::string> &defines)
+        : vertexShader(vertexShader), fragmentShader(fragmentShader), features(features), defines(defines)
+    {
+        if (this->features.size() > MAX_FEATURES)
+        {
+            std::cerr << "A shader can't have more than " << MAX_FEATURES << " features (" << fragmentShader << ")" << std::endl;
+            this->features.resize(MAX_FEATURES);
+        }
+    }
+
+    ShaderVariants::~ShaderVariants()
+    {
+        for (auto &[mask, program] : programs)
+            delete program;
+    }
+
+    uint32_t ShaderVariants::getMask(const std::vector<std::string> &names) const
+    {
+        uint32_t mask = 0;
+        for (size_t index = 0; index < features.size(); ++index)
+            if (std::find(names.begin(), names.end(), features[index]) != names.end())
+                mask |= 1u << index;
+        return mask;
+    }
+
+    bool ShaderVariants::hasFeature(const std::string &name) const
+    {
+        return std::find(features.begin(), features.end(), name) != features.end();
+    }
+
+    ShaderProgram *ShaderVariants::get(uint32_t mask)
+    {
+        mask &= getFullMask();
+        auto it = programs.find(mask);
+        if (it != programs.end())
+            return it->second;
+        std::vector<std::string> variantDefines = defines;
+        for (size_t index = 0; index < features.size(); ++index)
+            if (mask & (1u << index))
+                variantDefines.push_back(features[index]);
+        ShaderProgram *program = new ShaderProgram();
+        program->attach(vertexShader, GL_VERTEX_SHADER, variantDefines);
+        program->attach(fragmentShader, GL_FRAGMENT_SHADER, variantDefines);
+        program->startLink();
+        programs[mask] = program;
+        return program;
+    }
+
+}
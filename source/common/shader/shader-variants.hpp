@@ -0,0 +1,44 @@
+#pragma once
+
+#include "shader.hpp"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace our
+{
+
+    // A shader with optional features (e.g. "EMISSIVE" or "AMBIENT_OCCLUSION") that are turned on by defining them in the source
+    // (see "ShaderProgram::attach"). Each combination of features is a variant identified by a bit mask (the bit of a feature
+    // is its index in "features"), and the variants are compiled the first time they are requested then kept here.
+    // This way a material that doesn't need a feature can use a cheaper variant without writing another shader.
+    class ShaderVariants
+    {
+        std::string vertexShader, fragmentShader;
+        std::vector<std::string> features, defines; // "defines" are added to every variant
+        std::unordered_map<uint32_t, ShaderProgram *> programs;
+
+    public:
+        static constexpr size_t MAX_FEATURES = 32;
+
+        ShaderVariants(const std::string &vertexShader, const std::string &fragmentShader, const std::vector<std::string> &features,
+                       const std::vector<std::string> &defines = {});
+        ~ShaderVariants();
+
+        // Returns the mask of the given features (the features that the shader doesn't have are ignored)
+        uint32_t getMask(const std::vector<std::string> &names) const;
+        uint32_t getFullMask() const { return features.size() >= 32 ? ~0u : (1u << features.size()) - 1; }
+        bool hasFeature(const std::string &name) const;
+        const std::vector<std::string> &getFeatures() const { return features; }
+
+        // Returns the variant with the features of the mask (if it wasn't requested before, it starts compiling & linking
+        // and it is finished when it is first used, see "ShaderProgram::startLink")
+        ShaderProgram *get(uint32_t mask);
+
+        ShaderVariants(const ShaderVariants &) = delete;
+        ShaderVariants &operator=(const ShaderVariants &) = delete;
+    };
+
+}
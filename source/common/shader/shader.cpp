@@ -1,76 +1,182 @@
 #include "shader.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
 #include <fstream>
 #include <string>
 
+// Hashes the given bytes (FNV-1a)
+static uint64_t hashBytes(const void *data, size_t size, uint64_t hash) {
+    auto bytes = static_cast<const unsigned char *>(data);
+    for (size_t index = 0; index < size; ++index)
+        hash = (hash ^ bytes[index]) * 1099511628211ull;
+    return hash;
+}
+
 //Forward definition for error checking functions
 std::string checkForShaderCompilationErrors(GLuint shader);
 
 std::string checkForLinkingErrors(GLuint program);
 
-bool our::ShaderProgram::attach(const std::string &filename, GLenum type) const {
-    // Here, we open the file and read a string from it containing the GLSL code of our shader
-    std::ifstream file(filename);
+// Appends the lines of the file to "output" while replacing the "#include" lines by the files they name
+// "#line" directives are added around the included files so the compilation errors point to the right file & line
+// (the source string number of a file is its index in "files")
+static bool readSource(const std::filesystem::path &path, std::string &output, std::vector<std::string> &files) {
+    std::ifstream file(path);
     if (!file) {
-        std::cerr << "ERROR: Couldn't open shader file: " << filename << std::endl;
+        std::cerr << "ERROR: Couldn't open shader file: " << path.generic_string() << std::endl;
         return false;
     }
-    std::string sourceString = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
-    const char *sourceCStr = sourceString.c_str();
-    file.close();
+    int index = int(files.size());
+    files.push_back(path.lexically_normal().generic_string());
+    std::string line;
+    for (int number = 1; std::getline(file, line); ++number) {
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+            output += line;
+            output += '\n';
+            continue;
+        }
+        size_t open = line.find('"', start + 8), close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close == std::string::npos) {
+            std::cerr << "ERROR: Malformed include in " << files[index] << " at line " << number << std::endl;
+            return false;
+        }
+        auto included = (path.parent_path() / line.substr(open + 1, close - open - 1)).lexically_normal();
+        if (std::find(files.begin(), files.end(), included.generic_string()) == files.end()) {
+            output += "#line 1 " + std::to_string(files.size()) + "\n";
+            if (!readSource(included, output, files))
+                return false;
+        }
+        output += "#line " + std::to_string(number + 1) + " " + std::to_string(index) + "\n";
+    }
+    return true;
+}
 
-    //DONE: Complete this function
-    //Note: The function "checkForShaderCompilationErrors" checks if there is
-    // an error in the given shader. You should use it to check if there is a
-    // compilation error and print it so that you can know what is wrong with
-    // the shader. The returned string will be empty if there is no errors.
+bool our::ShaderProgram::attach(const std::string &filename, GLenum type, const std::vector<std::string> &defines) {
+    // Here, we read the file (and the files it includes) into a string containing the GLSL code of our shader
+    Source source = {type, filename, "", {}};
+    if (!readSource(filename, source.code, source.files))
+        return false;
 
-    // Create shader with received type (GL_VERTEX_SHADER or GL_FRAGMENT_SHADER)
-    uint8_t shaderID = glCreateShader(type);
+    // The defines must come after the "#version" line (which must be the first line of the shader)
+    if (!defines.empty()) {
+        size_t versionEnd = source.code.compare(0, 8, "#version") == 0 ? source.code.find('\n') + 1 : 0;
+        std::string lines;
+        for (auto &define: defines)
+            lines += "#define " + define + "\n";
+        lines += "#line " + std::to_string(versionEnd == 0 ? 1 : 2) + " 0\n";
+        source.code.insert(versionEnd, lines);
+    }
 
-    // Send shader source code
-    glShaderSource(shaderID, 1, &sourceCStr, NULL);
+    attachments.push_back({filename, type, defines});
+    for (auto &file: source.files)
+        if (std::find(files.begin(), files.end(), file) == files.end())
+            files.push_back(file);
 
-    // Compile the shader
-    glCompileShader(shaderID);
+    // The shader is compiled by "link" (only if the program isn't in the cache)
+    sources.push_back(std::move(source));
+    return true;
+}
 
-    // Check for errors in shader
-    std::string error = checkForShaderCompilationErrors(shaderID);
 
-    // If there is an error message
-    if (!error.empty()) {
-        // Print the error message
-        std::cerr << "ERROR::SHADER::" << (type == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT") << "::COMPILATION_FAILED\n"
-                  << error << std::endl;
+bool our::ShaderProgram::link() {
+    startLink();
+    return finishLink();
+}
 
-        // Delete the shader
-        glDeleteShader(shaderID);
+void our::ShaderProgram::startLink() {
+    if (pending || sources.empty())
+        return;
+    linked = false;
+    // The cache file of the program is named after the hash of its sources, and it holds the driver that made the binary
+    // (a binary can only be loaded by the same driver, so the file is replaced when the driver changes)
+    cachePath.clear();
+    if (!cacheDirectory.empty()) {
+        uint64_t hash = 1469598103934665603ull;
+        for (auto &source: sources) {
+            hash = hashBytes(&source.type, sizeof(source.type), hash);
+            hash = hashBytes(source.code.data(), source.code.size(), hash);
+        }
+        char name[17];
+        snprintf(name, sizeof(name), "%016llx", (unsigned long long) hash);
+        cachePath = (std::filesystem::path(cacheDirectory) / (std::string(name) + ".bin")).string();
+        driver = std::string(reinterpret_cast<const char *>(glGetString(GL_VENDOR))) + "|" +
+                 reinterpret_cast<const char *>(glGetString(GL_RENDERER)) + "|" +
+                 reinterpret_cast<const char *>(glGetString(GL_VERSION));
+        if (loadBinary(cachePath, driver)) {
+            sources.clear();
+            linked = true;
+            return;
+        }
+    }
 
-        // We return false if the compilation failed
-        return false;
+    // The statuses aren't checked here since asking for them waits for the driver to finish (see "finishLink")
+    for (auto &source: sources) {
+        const char *sourceCStr = source.code.c_str();
+
+        // Create shader with received type (GL_VERTEX_SHADER or GL_FRAGMENT_SHADER)
+        source.shader = glCreateShader(source.type);
+
+        // Send shader source code
+        glShaderSource(source.shader, 1, &sourceCStr, NULL);
+
+        // Compile the shader
+        glCompileShader(source.shader);
+
+        // Attach the shader to the program (if it fails to compile, the link fails too and "finishLink" reports the error)
+        glAttachShader(this->program, source.shader);
     }
 
-    // Attach the shader to the program
-    glAttachShader(this->program, shaderID);
+    // The driver has to be told before linking that we want to get the binary of the program
+    if (!cachePath.empty())
+        glProgramParameteri(this->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
-    // Delete the shader
-    glDeleteShader(shaderID);
-    //We return true if the compilation succeeded
-    return true;
+    // Link the program
+    glLinkProgram(this->program);
+    pending = true;
 }
 
+bool our::ShaderProgram::finishLink() {
+    if (!pending)
+        return linked;
+    pending = false;
 
-bool our::ShaderProgram::link() const {
     //DONE: Complete this function
-    //Note: The function "checkForLinkingErrors" checks if there is
-    // an error in the given program. You should use it to check if there is a
-    // linking error and print it so that you can know what is wrong with the
-    // program. The returned string will be empty if there is no errors.
+    //Note: The function "checkForShaderCompilationErrors" checks if there is
+    // an error in the given shader. You should use it to check if there is a
+    // compilation error and print it so that you can know what is wrong with
+    // the shader. The returned string will be empty if there is no errors.
+    bool compiled = true;
+    for (auto &source: sources) {
+        // Check for errors in shader
+        std::string error = checkForShaderCompilationErrors(source.shader);
 
-    // Link the program
-    glLinkProgram(this->program);
+        // If there is an error message
+        if (!error.empty()) {
+            // Print the error message
+            std::cerr << "ERROR::SHADER::" << (source.type == GL_VERTEX_SHADER ? "VERTEX" : "FRAGMENT")
+                      << "::COMPILATION_FAILED (" << source.filename << ")\n" << error;
+            // The errors are reported as "source string number(line)", so the files of the numbers are listed
+            if (source.files.size() > 1)
+                for (size_t index = 0; index < source.files.size(); ++index)
+                    std::cerr << "  " << index << ": " << source.files[index] << "\n";
+            std::cerr << std::endl;
+            compiled = false;
+        }
+
+        // The shaders aren't needed after linking
+        glDetachShader(this->program, source.shader);
+        glDeleteShader(source.shader);
+    }
+    sources.clear();
+    // We return false if the compilation failed (the linking errors would only repeat the compilation errors)
+    if (!compiled)
+        return false;
 
     // Check for linking errors
     std::string error = checkForLinkingErrors(this->program);
@@ -84,10 +190,198 @@ bool our::ShaderProgram::link() const {
         return false;
     }
 
-    // We return false if the linking succeeded
+    if (!cachePath.empty())
+        saveBinary(cachePath, driver);
+
+    // We return true if the linking succeeded
+    linked = true;
     return true;
 }
 
+bool our::ShaderProgram::isReady() const {
+    if (!pending)
+        return true;
+    GLint completed = GL_TRUE;
+    if (GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile)
+        glGetProgramiv(this->program, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed == GL_TRUE;
+}
+
+// Copies the values of the active uniforms of "from" to the uniforms of "to" that have the same name & type
+// (the uniforms in blocks are skipped since their values are in buffers)
+static void copyUniforms(GLuint from, GLuint to) {
+    GLint current = 0, count = 0, maxLength = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+    glUseProgram(to);
+    glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(from, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> nameBuffer(std::max(maxLength, 1));
+    for (GLint index = 0; index < count; ++index) {
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(from, GLuint(index), GLsizei(nameBuffer.size()), nullptr, &size, &type, nameBuffer.data());
+        std::string name = nameBuffer.data();
+        // The arrays are named "name[0]", so each of their elements is found by its own name
+        if (size > 1 && name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            name.resize(name.size() - 3);
+        for (GLint element = 0; element < size; ++element) {
+            std::string elementName = size > 1 ? name + "[" + std::to_string(element) + "]" : name;
+            GLint source = glGetUniformLocation(from, elementName.c_str());
+            GLint target = glGetUniformLocation(to, elementName.c_str());
+            if (source < 0 || target < 0)
+                continue;
+            GLint targetType = 0;
+            GLuint targetIndex = GL_INVALID_INDEX;
+            const char *elementNameCStr = elementName.c_str();
+            glGetUniformIndices(to, 1, &elementNameCStr, &targetIndex);
+            if (targetIndex == GL_INVALID_INDEX)
+                continue;
+            glGetActiveUniformsiv(to, 1, &targetIndex, GL_UNIFORM_TYPE, &targetType);
+            if (GLenum(targetType) != type)
+                continue;
+            GLfloat floats[16];
+            GLint ints[4];
+            GLuint uints[4];
+            switch (type) {
+                case GL_FLOAT: glGetUniformfv(from, source, floats); glUniform1fv(target, 1, floats); break;
+                case GL_FLOAT_VEC2: glGetUniformfv(from, source, floats); glUniform2fv(target, 1, floats); break;
+                case GL_FLOAT_VEC3: glGetUniformfv(from, source, floats); glUniform3fv(target, 1, floats); break;
+                case GL_FLOAT_VEC4: glGetUniformfv(from, source, floats); glUniform4fv(target, 1, floats); break;
+                case GL_FLOAT_MAT2: glGetUniformfv(from, source, floats); glUniformMatrix2fv(target, 1, false, floats); break;
+                case GL_FLOAT_MAT3: glGetUniformfv(from, source, floats); glUniformMatrix3fv(target, 1, false, floats); break;
+                case GL_FLOAT_MAT4: glGetUniformfv(from, source, floats); glUniformMatrix4fv(target, 1, false, floats); break;
+                case GL_INT_VEC2: case GL_BOOL_VEC2: glGetUniformiv(from, source, ints); glUniform2iv(target, 1, ints); break;
+                case GL_INT_VEC3: case GL_BOOL_VEC3: glGetUniformiv(from, source, ints); glUniform3iv(target, 1, ints); break;
+                case GL_INT_VEC4: case GL_BOOL_VEC4: glGetUniformiv(from, source, ints); glUniform4iv(target, 1, ints); break;
+                case GL_UNSIGNED_INT: glGetUniformuiv(from, source, uints); glUniform1uiv(target, 1, uints); break;
+                case GL_UNSIGNED_INT_VEC2: glGetUniformuiv(from, source, uints); glUniform2uiv(target, 1, uints); break;
+                case GL_UNSIGNED_INT_VEC3: glGetUniformuiv(from, source, uints); glUniform3uiv(target, 1, uints); break;
+                case GL_UNSIGNED_INT_VEC4: glGetUniformuiv(from, source, uints); glUniform4uiv(target, 1, uints); break;
+                // The ints, the bools & the samplers (the texture unit of a sampler is an int)
+                default: glGetUniformiv(from, source, ints); glUniform1iv(target, 1, ints); break;
+            }
+        }
+    }
+    glUseProgram(GLuint(current));
+}
+
+bool our::ShaderProgram::reload() {
+    finishLink();
+    ShaderProgram reloaded;
+    for (auto &attachment: attachments)
+        if (!reloaded.attach(attachment.filename, attachment.type, attachment.defines))
+            return false;
+    if (!reloaded.link())
+        return false;
+    if (linked)
+        copyUniforms(this->program, reloaded.program);
+    // The old program is deleted with "reloaded"
+    std::swap(this->program, reloaded.program);
+    std::swap(this->files, reloaded.files);
+    linked = true;
+    return true;
+}
+
+bool our::ShaderProgram::uses(const std::string &file) const {
+    return std::find(files.begin(), files.end(), file) != files.end();
+}
+
+int our::ShaderProgram::reloadChanged(const std::vector<std::string> &changedFiles) {
+    // The programs are collected first since reloading creates (then deletes) programs
+    std::vector<ShaderProgram *> changed;
+    for (auto program: instances)
+        for (auto &file: changedFiles)
+            if (program->uses(std::filesystem::path(file).lexically_normal().generic_string())) {
+                changed.push_back(program);
+                break;
+            }
+    int reloaded = 0;
+    for (auto program: changed) {
+        if (program->reload())
+            ++reloaded;
+        else {
+            std::cerr << "Couldn't reload the shader (";
+            for (auto &attachment: program->attachments)
+                std::cerr << attachment.filename << (&attachment == &program->attachments.back() ? "" : ", ");
+            std::cerr << "), the last working version is kept" << std::endl;
+        }
+    }
+    return reloaded;
+}
+
+void our::ShaderProgram::setCompilerThreads(GLuint count) {
+    if (GLAD_GL_KHR_parallel_shader_compile)
+        glMaxShaderCompilerThreadsKHR(count);
+    else if (GLAD_GL_ARB_parallel_shader_compile)
+        glMaxShaderCompilerThreadsARB(count);
+}
+
+// The cache file holds: the driver string (its length then its characters), the binary format, the binary length then the binary
+bool our::ShaderProgram::loadBinary(const std::string &path, const std::string &driver) const {
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    uint32_t driverLength = 0, binaryLength = 0;
+    GLenum format = 0;
+    file.read(reinterpret_cast<char *>(&driverLength), sizeof(driverLength));
+    if (!file || driverLength != driver.size())
+        return false;
+    std::string fileDriver(driverLength, '\0');
+    file.read(fileDriver.data(), driverLength);
+    file.read(reinterpret_cast<char *>(&format), sizeof(format));
+    file.read(reinterpret_cast<char *>(&binaryLength), sizeof(binaryLength));
+    if (!file || fileDriver != driver)
+        return false;
+    std::vector<char> binary(binaryLength);
+    file.read(binary.data(), binaryLength);
+    if (!file)
+        return false;
+    // The driver can still reject the binary (e.g. if it was made with different settings), then the program is compiled
+    glProgramBinary(this->program, format, binary.data(), GLsizei(binaryLength));
+    GLint status = GL_FALSE;
+    glGetProgramiv(this->program, GL_LINK_STATUS, &status);
+    return status == GL_TRUE;
+}
+
+void our::ShaderProgram::saveBinary(const std::string &path, const std::string &driver) const {
+    GLint length = 0;
+    glGetProgramiv(this->program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(this->program, length, &length, &format, binary.data());
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Couldn't write the shader cache file: " << path << std::endl;
+        return;
+    }
+    uint32_t driverLength = uint32_t(driver.size()), binaryLength = uint32_t(length);
+    file.write(reinterpret_cast<const char *>(&driverLength), sizeof(driverLength));
+    file.write(driver.data(), driverLength);
+    file.write(reinterpret_cast<const char *>(&format), sizeof(format));
+    file.write(reinterpret_cast<const char *>(&binaryLength), sizeof(binaryLength));
+    file.write(binary.data(), binaryLength);
+}
+
+void our::ShaderProgram::setCacheDirectory(const std::string &directory) {
+    cacheDirectory.clear();
+    if (directory.empty())
+        return;
+    // Program binaries are in the core since OpenGL 4.1 (and in an extension before it), and some drivers support no formats
+    GLint formats = 0;
+    if (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats == 0) {
+        std::cerr << "The driver doesn't support program binaries, the shader cache is disabled" << std::endl;
+        return;
+    }
+    cacheDirectory = directory;
+}
+
 ////////////////////////////////////////////////////////////////////
 // Function to check for compilation and linking error in shaders //
 ////////////////////////////////////////////////////////////////////
@@ -2,6 +2,8 @@
 #define SHADER_HPP
 
 #include <string>
+#include <unordered_set>
+#include <vector>
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -16,29 +18,105 @@ namespace our
         // Shader Program Handle (OpenGL object name)
         GLuint program;
 
+        // The shaders given to "attach" are only compiled by "startLink" if the program isn't found in the cache
+        // They are kept until "finishLink" checks their compilation status
+        struct Source
+        {
+            GLenum type;
+            std::string filename, code;
+            std::vector<std::string> files; // The file of each source string number in the "#line" directives of the code
+            GLuint shader = 0;              // The compiled shader (while the link is pending)
+        };
+        std::vector<Source> sources;
+
+        // What was given to "attach" & all the files that were read (with the includes), kept so the program can be reloaded
+        struct Attachment
+        {
+            std::string filename;
+            GLenum type;
+            std::vector<std::string> defines;
+        };
+        std::vector<Attachment> attachments;
+        std::vector<std::string> files;
+
+        // All the programs that exist (so the programs using a changed file can be found by "reloadChanged")
+        static inline std::unordered_set<ShaderProgram *> instances;
+
+        // Whether the driver may still be compiling & linking the program (its status wasn't checked yet)
+        bool pending = false;
+        bool linked = false;
+        std::string cachePath, driver; // Where the binary is saved after the pending link succeeds
+
+        // The linked programs are saved to this directory as binaries (see "setCacheDirectory"), empty if the cache is disabled
+        static inline std::string cacheDirectory;
+
+        // Loads the program from its cache file, returns false if there is no file or it was made by a different driver
+        bool loadBinary(const std::string &path, const std::string &driver) const;
+        void saveBinary(const std::string &path, const std::string &driver) const;
+
     public:
         ShaderProgram()
         {
             // (Req 1) Create A shader program
             program = glCreateProgram(); // create shader program using glCreateProgram
+            instances.insert(this);
         }
         ~ShaderProgram()
         {
             // (Req 1) Delete a shader program
             glDeleteProgram(program); // delete shader program using glDeleteProgram
+            instances.erase(this);
         }
 
-        bool attach(const std::string &filename, GLenum type) const;
-
-        bool link() const;
+        // Reads the source of a shader to be compiled & attached to the program by "link"
+        // The "#include "path"" lines of the source are replaced by the files they name (relative to the including file, and
+        // each file is included once). Every define (e.g. "EMISSIVE" or "MAX_LIGHTS 16") is added after the "#version" line.
+        // Returns false if the file (or one of its includes) couldn't be read
+        bool attach(const std::string &filename, GLenum type, const std::vector<std::string> &defines = {});
+
+        // Links the program from the attached shaders. If the cache has a binary of the same sources made by the same driver,
+        // it is loaded instead of compiling the shaders, otherwise the shaders are compiled and the binary is saved to the cache.
+        // This waits for the driver to finish (it is the same as "startLink" followed by "finishLink")
+        bool link();
+
+        // Sends the attached shaders to the driver to be compiled & linked without waiting for the result, so the driver can
+        // compile many programs at the same time (on its own threads if it supports "GL_KHR_parallel_shader_compile") while
+        // the rest of the assets are loaded. The program is finished automatically the first time it is used.
+        void startLink();
+        // Waits for the pending link (if any), reports the compilation & linking errors then saves the binary to the cache
+        // Returns whether the program is linked
+        bool finishLink();
+        // Returns true if using the program wouldn't wait for the driver (always true if the driver can't be asked)
+        // The renderer uses it to skip the postprocessing passes that are still compiling (see "ForwardRenderer::applyPostprocess")
+        bool isReady() const;
+
+        // Compiles & links the attached files again into a new program which replaces the current one only if it links
+        // (so a shader with an error keeps drawing with its last working version). The values of the uniforms are kept.
+        bool reload();
+        // Returns true if the program was made from the given file (or the file is included by one of its shaders)
+        bool uses(const std::string &file) const;
+        // Reloads every program that uses one of the given files, returns how many programs were reloaded
+        static int reloadChanged(const std::vector<std::string> &changedFiles);
+
+        // Sets how many threads the driver may use to compile the shaders (if it supports "GL_KHR_parallel_shader_compile")
+        // The default (0xFFFFFFFF) lets the driver choose, and 0 compiles the shaders on the calling thread
+        static void setCompilerThreads(GLuint count = 0xFFFFFFFF);
+
+        // Enables the program binary cache in the given directory (or disables it if the directory is empty)
+        // It must be called after the OpenGL functions are loaded since the cache is only enabled if the driver supports it
+        static void setCacheDirectory(const std::string &directory);
 
         void use()
         {
+            if (pending)
+                finishLink();
             glUseProgram(program);
         }
 
         GLuint getUniformLocation(const std::string &name)
         {
+            if (pending)
+                finishLink();
             // (Req 1) Return the location of the uniform with the given name
             return glGetUniformLocation(program, name.c_str());
         }
@@ -85,6 +163,13 @@ namespace our
             glUniform4fv(uniformLocation, 1, &value[0]);          // passing value glm::vec4 to uniform using glUniform4fv
         }
 
+        void set(const std::string &uniform, glm::ivec3 value)
+        {
+            // Send the given 3D integer vector value to the given uniform
+            GLuint uniformLocation = getUniformLocation(uniform);
+            glUniform3iv(uniformLocation, 1, &value[0]);
+        }
+
         void set(const std::string &uniform, glm::mat4 matrix)
         {
             // (Req 1) Send the given matrix 4x4 value to the given uniform
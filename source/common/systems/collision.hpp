@@ -2,6 +2,9 @@
 
 #include "../ecs/world.hpp"
 
+#include <unordered_map>
+#include <vector>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 #include <glm/trigonometric.hpp>
@@ -16,11 +19,29 @@
 
 namespace our {
 
+    class CollisionComponent;
+    class EnergyComponent;
+    class HeartComponent;
+
     // The collision system is responsible for detecting collisions between entities.
     class CollisionSystem {
 #ifdef USE_SOUND
         irrklang::ISoundEngine *soundEngine;
 #endif
+        // Instead of searching the world every frame, the system keeps track of the entities it needs
+        // using the world observers (see "World::onAdded" & "World::onRemoved")
+        // The HUD is only updated when its components change: the system writes the pepsi count & the visible hearts to the
+        // energy & heart components (through "Entity::getMutableComponent") and their "changed" observers resize their entities
+        World *observedWorld = nullptr;                   // The world tracked by the observers
+        std::vector<uint32_t> observerIds;                // The ids of the registered observers
+        Entity *playerEntity = nullptr;                   // The entity holding the player component
+        EnergyComponent *energy = nullptr;                // The energy component of the HUD energy bar
+        std::unordered_map<int, HeartComponent *> hearts; // The HUD hearts identified by their number
+        std::vector<CollisionComponent *> colliders;      // All the collision components in the world
+
+        // Registers the observers on the given world (if it is not already observed)
+        void observe(World *world);
+
     public:
         CollisionSystem() {
 #ifdef USE_SOUND
@@ -40,6 +61,9 @@ namespace our {
 
         // This function is called when the player collides with an obstacle
         void decreaseHearts(World *world, int &heartCount);
+
+        // Removes the observers from the observed world (call it before the world is destroyed)
+        void exit();
     };
 
 }
@@ -0,0 +1,189 @@
+#include "deferred-renderer.hpp"
+#include "../texture/texture-utils.hpp"
+#include <iostream>
+
+namespace our
+{
+    void DeferredRenderer::initialize(glm::ivec2 windowSize, const nlohmann::json &config)
+    {
+        // The lighting pass can't write to the G-buffer depth while reading it, so the scene is always drawn to the offscreen
+        // targets of the forward renderer, and the postprocessing step is what puts the scene on the screen
+        nlohmann::json rendererConfig = config;
+        if (!rendererConfig.contains("postprocess"))
+            rendererConfig["postprocess"] = "assets/shaders/blit.frag";
+        ForwardRenderer::initialize(windowSize, rendererConfig);
+
+        // Create the G-buffer targets
+        albedoTarget = texture_utils::empty(GL_RGBA8, windowSize);
+        specularTarget = texture_utils::empty(GL_RGBA8, windowSize);
+        normalTarget = texture_utils::empty(GL_RG16F, windowSize);
+        // The emissive colors can be brighter than 1 when the scene is drawn in HDR
+        emissiveTarget = texture_utils::empty(hdr ? GL_R11F_G11F_B10F : GL_RGBA8, windowSize);
+
+        glGenFramebuffers(1, &gBufferFrameBuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, gBufferFrameBuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTarget->getOpenGLName(), 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, specularTarget->getOpenGLName(), 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, normalTarget->getOpenGLName(), 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, emissiveTarget->getOpenGLName(), 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTarget->getOpenGLName(), 0);
+        GLenum drawBuffers[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3};
+        glDrawBuffers(4, drawBuffers);
+        if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cerr << "The G-buffer framebuffer is incomplete" << std::endl;
+
+        // The lighting pass writes to the scene color without the depth (since it reads the depth as a texture)
+        glGenFramebuffers(1, &lightingFrameBuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, lightingFrameBuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTarget->getOpenGLName(), 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        // The G-buffer is read pixel by pixel so we don't need any filtering
+        gBufferSampler = new Sampler();
+        gBufferSampler->set(GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        gBufferSampler->set(GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        gBufferSampler->set(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        gBufferSampler->set(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // The G-buffer shader uses the same vertex shader as the lighted materials
+        // The features are in the order of the bits of the variant masks
+        gBufferShaders = new ShaderVariants("assets/shaders/lighted.vert", "assets/shaders/deferred/gbuffer.frag",
+                                            {"EMISSIVE", "AMBIENT_OCCLUSION", "BATCHED"});
+        // All the variants & the lighting shader are sent to the driver first so it can compile them at the same time
+        for (uint32_t mask = 0; mask <= (G_BUFFER_EMISSIVE | G_BUFFER_AMBIENT_OCCLUSION); ++mask)
+            gBufferShaders->get(mask);
+        gBufferShaders->get(G_BUFFER_BATCHED);
+        lightingShader = new ShaderProgram();
+        lightingShader->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
+        lightingShader->attach("assets/shaders/deferred/lighting.frag", GL_FRAGMENT_SHADER);
+        lightingShader->startLink();
+
+        // The material textures are always bound to the units 0 to 4 (see "LightMaterial::bindTextures")
+        for (uint32_t mask = 0; mask <= (G_BUFFER_EMISSIVE | G_BUFFER_AMBIENT_OCCLUSION); ++mask)
+        {
+            ShaderProgram *gBufferShader = gBufferShaders->get(mask);
+            gBufferShader->use();
+            gBufferShader->set("material.albedo", 0);
+            gBufferShader->set("material.specular", 1);
+            gBufferShader->set("material.emissive", 2);
+            gBufferShader->set("material.roughness", 3);
+            gBufferShader->set("material.ambient_occlusion", 4);
+        }
+        // The batches read their texture arrays from the unit 0 and their instances from the unit 5
+        ShaderProgram *batchedShader = gBufferShaders->get(G_BUFFER_BATCHED);
+        batchedShader->use();
+        batchedShader->set("material_textures", 0);
+
+        lightingShader->use();
+        lightingShader->set("gbuffer_albedo", 0);
+        lightingShader->set("gbuffer_specular", 1);
+        lightingShader->set("gbuffer_normal", 2);
+        lightingShader->set("gbuffer_emissive", 3);
+        lightingShader->set("gbuffer_depth", 4);
+
+        lightingPipelineState.depthMask = false;
+    }
+
+    void DeferredRenderer::destroy()
+    {
+        glDeleteFramebuffers(1, &gBufferFrameBuffer);
+        glDeleteFramebuffers(1, &lightingFrameBuffer);
+        delete albedoTarget;
+        delete specularTarget;
+        delete normalTarget;
+        delete emissiveTarget;
+        delete gBufferSampler;
+        delete gBufferShaders;
+        delete lightingShader;
+        ForwardRenderer::destroy();
+    }
+
+    void DeferredRenderer::renderOpaque()
+    {
+        // The G-buffer pass: draw the opaque lighted objects to the G-buffer
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, gBufferFrameBuffer);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClearDepth(1);
+        glColorMask(true, true, true, true);
+        glDepthMask(true);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        ShaderProgram *gBufferShader = nullptr;
+        for (auto &command : opaqueCommands)
+        {
+            auto material = dynamic_cast<LightMaterial *>(command.material);
+            if (!material || MaterialBatches::isBatched(command))
+                continue;
+            // The variant only reads the optional textures that the material has
+            uint32_t mask = (material->emissive ? G_BUFFER_EMISSIVE : 0) | (material->ambient_occlusion ? G_BUFFER_AMBIENT_OCCLUSION : 0);
+            if (ShaderProgram *variant = gBufferShaders->get(mask); variant != gBufferShader)
+            {
+                gBufferShader = variant;
+                gBufferShader->use();
+                gBufferShader->set("VP", VP);
+                gBufferShader->set("camera_position", eye);
+            }
+            // Only the pipeline state & the textures of the material are used, the shader is replaced by the G-buffer shader
+            material->pipelineState.setup();
+            material->bindTextures();
+            gBufferShader->set("M", command.localToWorld);
+            gBufferShader->set("M_IT", glm::mat4(command.normalMatrix));
+            gBufferShader->set("material.emissive_intensity", material->emissiveIntensity);
+            command.mesh->draw(command.lod);
+        }
+        if (!materialBatches.getBatches().empty())
+        {
+            gBufferShader = gBufferShaders->get(G_BUFFER_BATCHED);
+            gBufferShader->use();
+            gBufferShader->set("VP", VP);
+            gBufferShader->set("camera_position", eye);
+            materialBatches.bind(gBufferShader, 5);
+            for (auto &batch : materialBatches.getBatches())
+            {
+                batch.material->pipelineState.setup();
+                materialBatches.draw(batch, gBufferShader);
+            }
+        }
+
+        // The lighting pass: light every pixel of the G-buffer once and write the result to the scene color
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, lightingFrameBuffer);
+        lightingPipelineState.setup();
+        glClear(GL_COLOR_BUFFER_BIT);
+        lightingShader->use();
+        Texture2D *gBuffer[] = {albedoTarget, specularTarget, normalTarget, emissiveTarget, depthTarget};
+        for (GLuint unit = 0; unit < 5; ++unit)
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            gBuffer[unit]->bind();
+            gBufferSampler->bind(unit);
+        }
+        lightClusters.bind(lightingShader, 8);
+        shadowMaps.bind(lightingShader, 11);
+        lightingShader->set("sky.top", glm::vec3(0.1, 0.5, 0.1));
+        lightingShader->set("sky.bottom", glm::vec3(0.1, 0.5, 0.1));
+        lightingShader->set("sky.horizon", glm::vec3(0.1, 0.5, 0.1));
+        lightingShader->set("inverse_VP", glm::inverse(VP));
+        lightingShader->set("camera_position", eye);
+        lightingShader->set("camera_forward", cameraForward);
+        glBindVertexArray(postProcessVertexArray);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        // The remaining opaque objects compute their own color so they are drawn over the lit scene like the forward renderer does
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, postprocessFrameBuffer);
+        for (auto &command : opaqueCommands)
+        {
+            if (!dynamic_cast<LightMaterial *>(command.material))
+                drawCommand(command);
+        }
+    }
+
+    ForwardRenderer *createRenderer(const nlohmann::json &config)
+    {
+        std::string type = config.value("type", "forward");
+        if (type == "deferred")
+            return new DeferredRenderer();
+        if (type != "forward")
+            std::cerr << "Unknown renderer type \"" << type << "\", using the forward renderer instead" << std::endl;
+        return new ForwardRenderer();
+    }
+
+}
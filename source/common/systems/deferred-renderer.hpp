@@ -0,0 +1,44 @@
+#pragma once
+
+#include "forward-renderer.hpp"
+
+namespace our
+{
+
+    // A deferred renderer splits the drawing of the opaque lighted objects into two passes:
+    // 1- The G-buffer pass: the objects write their surface data (albedo, specular, roughness, packed normal, emissive, ...)
+    //    to a set of textures (the G-buffer) instead of computing their lighting.
+    // 2- The lighting pass: a fullscreen triangle reads the G-buffer and lights every pixel once using the light clusters.
+    // So the lighting cost depends on the number of pixels on the screen instead of the number of overdrawn fragments.
+    // The opaque objects that are not lighted, the sky, the transparent objects and the postprocessing are drawn
+    // by the same stages as the forward renderer (which this renderer extends).
+    class DeferredRenderer : public ForwardRenderer
+    {
+        // The G-buffer targets (the depth target of the forward renderer is used as the G-buffer depth)
+        GLuint gBufferFrameBuffer, lightingFrameBuffer;
+        Texture2D *albedoTarget, *specularTarget, *normalTarget, *emissiveTarget;
+        // Used to read the G-buffer in the lighting pass
+        Sampler *gBufferSampler;
+        // The G-buffer shader has a variant for each combination of the optional textures of the lighted materials
+        // (the bits of the mask are G_BUFFER_EMISSIVE & G_BUFFER_AMBIENT_OCCLUSION), and G_BUFFER_BATCHED alone draws the material
+        // batches (their optional textures are picked per instance, see "material-batches.hpp")
+        ShaderVariants *gBufferShaders;
+        static constexpr uint32_t G_BUFFER_EMISSIVE = 1, G_BUFFER_AMBIENT_OCCLUSION = 2, G_BUFFER_BATCHED = 4;
+        ShaderProgram *lightingShader;
+        // The lighting pass doesn't need depth testing, face culling or blending
+        PipelineState lightingPipelineState;
+
+        void renderOpaque() override;
+
+    public:
+        // Same as the forward renderer but the deferred renderer always draws the scene to an offscreen target
+        // (if there is no postprocessing shader in the config, the scene is simply copied to the screen)
+        void initialize(glm::ivec2 windowSize, const nlohmann::json &config) override;
+
+        void destroy() override;
+    };
+
+    // Creates the renderer requested by the "type" in the renderer config ("forward" or "deferred", default: "forward")
+    ForwardRenderer *createRenderer(const nlohmann::json &config);
+
+}
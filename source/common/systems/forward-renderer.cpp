@@ -1,17 +1,56 @@
 #include "forward-renderer.hpp"
 #include "../mesh/mesh-utils.hpp"
 #include "../texture/texture-utils.hpp"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <memory>
+#include <new>
 #define DIRECTIONAL 0
 #define POINT 1
 #define SPOT 2
-#define SPOT_NUM 6
 namespace our
 {
+    // Replaces the list with an empty one that allocates from the given memory
+    // (a pmr container keeps its memory resource when it is assigned, so it has to be destroyed and constructed again in place)
+    template <typename List>
+    static void resetFrameList(List &list, std::pmr::memory_resource *memory)
+    {
+        std::destroy_at(&list);
+        new (&list) List(memory);
+    }
+
     void ForwardRenderer::initialize(glm::ivec2 windowSize, const nlohmann::json &config)
     {
         // First, we store the window size for later use
         this->windowSize = windowSize;
+        // Create the buffers in which the lights are sent to the lighted materials
+        // The data uploaded every frame (the lights & the instances) goes through one dynamic buffer (see "dynamic-buffer.hpp")
+        frameData.initialize(config.value("dynamic-buffer", nlohmann::json::object()));
+        lightClusters.initialize(config.value("clusters", nlohmann::json::object()), frameData);
+        // The levels of detail are picked so that their error covers at most "pixel-error" pixels on the screen
+        auto lodConfig = config.value("lod", nlohmann::json::object());
+        lodThreshold = lodConfig.value("pixel-error", lodThreshold);
+        lodHysteresis = lodConfig.value("hysteresis", lodHysteresis);
+        // Create the shadow maps (they are disabled if there is no "shadows" object in the config)
+        shadowMaps.initialize(config.value("shadows", nlohmann::json::object()), frameData);
+
+        // Create the shader of the depth pre-pass (even if it is disabled since it can be enabled at any time)
+        depthPrepass = config.value("depth-prepass", false);
+        depthShader = new ShaderProgram();
+        depthShader->attach("assets/shaders/depth-only.vert", GL_VERTEX_SHADER);
+        depthShader->attach("assets/shaders/depth-only.frag", GL_FRAGMENT_SHADER);
+        depthShader->startLink();
+        depthBatchedShader = new ShaderProgram();
+        depthBatchedShader->attach("assets/shaders/depth-only.vert", GL_VERTEX_SHADER, {"BATCHED"});
+        depthBatchedShader->attach("assets/shaders/depth-only.frag", GL_FRAGMENT_SHADER);
+        depthBatchedShader->startLink();
+        materialBatches.initialize(frameData);
+        shadowTimer.initialize();
+        depthPrepassTimer.initialize();
+        opaqueTimer.initialize();
+        transparentTimer.initialize();
+        postprocessTimer.initialize();
 
         // Then we check if there is a sky texture in the configuration
         if (config.contains("sky"))
@@ -23,7 +62,7 @@ namespace our
             ShaderProgram *skyShader = new ShaderProgram();
             skyShader->attach("assets/shaders/textured.vert", GL_VERTEX_SHADER);
             skyShader->attach("assets/shaders/textured.frag", GL_FRAGMENT_SHADER);
-            skyShader->link();
+            skyShader->startLink();
 
             // TODO: (Req 10) Pick the correct pipeline state to draw the sky
             //  Hints: the sky will be draw after the opaque objects so we would need depth testing but which depth funtion should we pick?
@@ -57,8 +96,37 @@ namespace our
             this->skyMaterial->transparent = false;
         }
 
+        // The dynamic resolution changes the size of the scene in its target, so it needs the postprocessing to upscale the scene
+        auto dynamicConfig = config.value("dynamic-resolution", nlohmann::json::object());
+        dynamicResolution = dynamicConfig.value("enabled", false);
+        targetMilliseconds = dynamicConfig.value("target-ms", targetMilliseconds);
+        minRenderScale = glm::clamp(dynamicConfig.value("min-scale", minRenderScale), 0.1f, 1.0f);
+        maxRenderScale = glm::clamp(dynamicConfig.value("max-scale", maxRenderScale), minRenderScale, 1.0f);
+        renderScale = maxRenderScale;
+        renderSize = windowSize;
+        frameTimer.initialize();
+
+        // The HDR scene is tone mapped by the postprocessing too
+        auto hdrConfig = config.value("hdr", nlohmann::json::object());
+        hdr = hdrConfig.value("enabled", false);
+        exposure = hdrConfig.value("exposure", exposure);
+        GLenum sceneFormat = GL_RGBA8;
+        if (hdr)
+        {
+            std::string format = hdrConfig.value("format", "R11G11B10F");
+            if (format == "RGBA16F")
+                sceneFormat = GL_RGBA16F;
+            else
+            {
+                if (format != "R11G11B10F")
+                    std::cerr << "Unknown HDR format \"" << format << "\", using R11G11B10F instead" << std::endl;
+                sceneFormat = GL_R11F_G11F_B10F;
+            }
+        }
+
         // Then we check if there is a postprocessing shader in the configuration
-        if (config.contains("postprocess"))
+        // (if the dynamic resolution or the HDR is enabled without any postprocessing, the scene is simply copied to the screen)
+        if (config.contains("postprocess") || dynamicResolution || hdr)
         {
             // TODO: (Req 11) Create a framebuffer
             // we need to generate the frame buffer using our postprocess frame buffer.
@@ -69,7 +137,7 @@ namespace our
             //  Hints: The color format can be (Red, Green, Blue and Alpha components with 8 bits for each channel).
             //  The depth format can be (Depth component with 24 bits).
             /// then we should create two empty textures to draw on them.
-            colorTarget = texture_utils::empty(GL_RGBA8, windowSize);
+            colorTarget = texture_utils::empty(sceneFormat, windowSize);
             depthTarget = texture_utils::empty(GL_DEPTH_COMPONENT24, windowSize);
             glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTarget->getOpenGLName(),
                                    0);
@@ -79,6 +147,19 @@ namespace our
             // Create a vertex array to use for drawing the texture
             glGenVertexArrays(1, &postProcessVertexArray);
 
+            // The scene color is also drawn to without the depth by the postprocessing passes, and the second full resolution
+            // target is where every other pass draws when there is more than one pass
+            PostprocessTargets fullTargets = {1.0f, windowSize, {colorTarget, texture_utils::empty(GL_RGBA8, windowSize)}, {0, 0}};
+            glGenFramebuffers(2, fullTargets.frameBuffers);
+            for (int index = 0; index < 2; ++index)
+            {
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fullTargets.frameBuffers[index]);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                                       fullTargets.textures[index]->getOpenGLName(), 0);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            postprocessTargets.push_back(fullTargets);
+
             // Create a sampler to use for sampling the scene texture in the post processing shader
             Sampler *postprocessSampler = new Sampler();
             postprocessSampler->set(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -86,25 +167,93 @@ namespace our
             postprocessSampler->set(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
             postprocessSampler->set(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-            // Create the post processing shader
-            ShaderProgram *postprocessShader = new ShaderProgram();
-            postprocessShader->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
-            postprocessShader->attach(config.value<std::string>("postprocess", ""), GL_FRAGMENT_SHADER);
-            postprocessShader->link();
-
-            // Create a post processing material
+            // The postprocessing in the config is either the path of a fragment shader or a list of paths (applied in order)
+            // A pass in the list can also be an object that sets its resolution scale: { "shader": "path", "scale": 0.5 }
+            // and the resolution scales of the shaders used by the states can be set in "postprocess-scale": { "path": 0.5, ... }
+            auto scales = config.value("postprocess-scale", nlohmann::json::object());
+            for (auto &[path, scale] : scales.items())
+                postprocessScales[path] = scale.get<float>();
+            auto postprocess = config.value("postprocess", nlohmann::json("assets/shaders/blit.frag"));
+            postprocessChain.clear();
+            if (postprocess.is_array())
+            {
+                for (auto &pass : postprocess)
+                {
+                    if (pass.is_object())
+                    {
+                        postprocessChain.push_back(pass.value("shader", ""));
+                        postprocessScales[postprocessChain.back()] = pass.value("scale", 1.0f);
+                    }
+                    else
+                        postprocessChain.push_back(pass.get<std::string>());
+                }
+            }
+            else
+                postprocessChain.push_back(postprocess.get<std::string>());
+            preloadPostprocess(postprocessChain);
+            // Create the lower resolution targets now instead of in the middle of the game
+            for (auto &[path, scale] : postprocessScales)
+                getPostprocessTargets(scale);
+            // The blit upsamples the lower resolution passes and stands in for the passes whose shader isn't compiled yet
+            getPostprocessShader("assets/shaders/blit.frag");
+
+            // Create a post processing material (its shader & texture are replaced by every pass)
             postprocessMaterial = new TexturedMaterial();
-            postprocessMaterial->shader = postprocessShader;
+            postprocessMaterial->shader = getPostprocessShader(postprocessChain.front());
             postprocessMaterial->texture = colorTarget;
             postprocessMaterial->sampler = postprocessSampler;
             // The default options are fine but we don't need to interact with the depth buffer
             // so it is more performant to disable the depth mask
             postprocessMaterial->pipelineState.depthMask = false;
+
+            if (hdr)
+            {
+                getPostprocessShader("assets/shaders/hdr/tonemap.frag");
+                // The bloom: { "enabled": true, "levels": 5, "threshold": 1, "knee": 0.5, "intensity": 0.05, "radius": 1 }
+                auto bloomConfig = hdrConfig.value("bloom", nlohmann::json::object());
+                if (bloomConfig.value("enabled", true))
+                {
+                    bloomThreshold = bloomConfig.value("threshold", bloomThreshold);
+                    bloomKnee = std::max(bloomConfig.value("knee", bloomKnee), 0.0001f);
+                    bloomIntensity = bloomConfig.value("intensity", bloomIntensity);
+                    bloomRadius = bloomConfig.value("radius", bloomRadius);
+                    int levelCount = bloomConfig.value("levels", 5);
+                    glm::ivec2 size = windowSize / 2;
+                    for (int level = 0; level < levelCount && size.x > 1 && size.y > 1; ++level, size /= 2)
+                    {
+                        BloomLevel bloomLevel = {size, texture_utils::empty(GL_R11F_G11F_B10F, size), 0};
+                        glGenFramebuffers(1, &bloomLevel.frameBuffer);
+                        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, bloomLevel.frameBuffer);
+                        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bloomLevel.texture->getOpenGLName(), 0);
+                        bloomLevels.push_back(bloomLevel);
+                    }
+                    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                    getPostprocessShader("assets/shaders/hdr/bloom-downsample.frag");
+                    getPostprocessShader("assets/shaders/hdr/bloom-upsample.frag");
+                    bloomPipelineState.depthMask = false;
+                    bloomPipelineState.blending.enabled = true;
+                    bloomPipelineState.blending.sourceFactor = GL_ONE;
+                    bloomPipelineState.blending.destinationFactor = GL_ONE;
+                }
+            }
         }
     }
 
     void ForwardRenderer::destroy()
     {
+        lightClusters.destroy();
+        shadowMaps.destroy();
+        materialBatches.destroy();
+        frameData.destroy();
+        delete depthShader;
+        delete depthBatchedShader;
+        depthShader = depthBatchedShader = nullptr;
+        frameTimer.destroy();
+        shadowTimer.destroy();
+        depthPrepassTimer.destroy();
+        opaqueTimer.destroy();
+        transparentTimer.destroy();
+        postprocessTimer.destroy();
         // Delete all objects related to the sky
         if (skyMaterial)
         {
@@ -121,60 +270,183 @@ namespace our
             glDeleteVertexArrays(1, &postProcessVertexArray);
             delete colorTarget;
             delete depthTarget;
+            // The first texture of the full resolution targets is the scene color (which is already deleted)
+            for (size_t index = 0; index < postprocessTargets.size(); ++index)
+            {
+                glDeleteFramebuffers(2, postprocessTargets[index].frameBuffers);
+                if (index != 0)
+                    delete postprocessTargets[index].textures[0];
+                delete postprocessTargets[index].textures[1];
+            }
+            postprocessTargets.clear();
+            for (auto &level : bloomLevels)
+            {
+                glDeleteFramebuffers(1, &level.frameBuffer);
+                delete level.texture;
+            }
+            bloomLevels.clear();
             delete postprocessMaterial->sampler;
-            delete postprocessMaterial->shader;
             delete postprocessMaterial;
+            postprocessMaterial = nullptr;
+        }
+        for (auto &[path, shader] : postprocessShaders)
+            delete shader;
+        postprocessShaders.clear();
+    }
+
+    std::pmr::memory_resource *ForwardRenderer::getFrameMemory()
+    {
+        if (app)
+            return &app->getFrameArena();
+        return std::pmr::new_delete_resource();
+    }
+
+    const ForwardRenderer::ParentMatrices &ForwardRenderer::getParentMatrices(const Entity *parent)
+    {
+        if (auto it = parentMatrices.find(parent); it != parentMatrices.end())
+            return it->second;
+        // The same chaining as "Entity::getLocalToWorldMatrix" & "Entity::getNormalMatrix", but each ancestor is only composed once
+        ParentMatrices matrices{parent->localTransform.toMat4(), parent->localTransform.getNormalMatrix()};
+        if (parent->parent)
+        {
+            const ParentMatrices &grandparent = getParentMatrices(parent->parent);
+            matrices.localToWorld = grandparent.localToWorld * matrices.localToWorld;
+            matrices.normalMatrix = grandparent.normalMatrix * matrices.normalMatrix;
+        }
+        // The references stay valid while more parents are added since the map doesn't move its elements
+        return parentMatrices.emplace(parent, matrices).first->second;
+    }
+
+    // The lights are not sent one by one anymore, the shader reads them from the light clusters
+    void ForwardRenderer::setupLighting(ShaderProgram *shader)
+    {
+        // The material uses texture units 0 to 4 so the light buffers are bound after them
+        lightClusters.bind(shader, 8);
+        shadowMaps.bind(shader, 11);
+        shader->set("sky.top", glm::vec3(0.1, 0.5, 0.1));
+        shader->set("sky.bottom", glm::vec3(0.1, 0.5, 0.1));
+        shader->set("sky.horizon", glm::vec3(0.1, 0.5, 0.1));
+
+        shader->set("VP", VP);
+        shader->set("camera_position", eye); // eye * Model of camera
+        shader->set("camera_forward", cameraForward);
+    }
+
+    RendererStats ForwardRenderer::getStats() const
+    {
+        RendererStats stats;
+        stats.frameTime = frameTimer.getMilliseconds();
+        stats.renderScale = renderSize.x / float(windowSize.x);
+        stats.shadowTime = shadowMaps.isEnabled() ? shadowTimer.getMilliseconds() : 0.0;
+        stats.shadows = shadowMaps.getStats();
+        stats.depthPrepassTime = depthPrepass ? depthPrepassTimer.getMilliseconds() : 0.0;
+        stats.opaqueTime = opaqueTimer.getMilliseconds();
+        stats.transparentTime = transparentTimer.getMilliseconds();
+        stats.postprocessTime = postprocessMaterial ? postprocessTimer.getMilliseconds() : 0.0;
+        stats.opaqueCount = opaqueCommands.size();
+        stats.transparentCount = transparentCommands.size();
+        for (auto &command : opaqueCommands)
+            stats.triangleCount += command.mesh->getElementCount(command.lod) / 3;
+        for (auto &command : transparentCommands)
+            stats.triangleCount += command.mesh->getElementCount(command.lod) / 3;
+        stats.batchedDraws = materialBatches.getBatches().size();
+        stats.batchedInstances = materialBatches.getInstanceCount();
+        stats.uploadedBytes = size_t(frameData.getUsedSize());
+        stats.persistentUploads = frameData.isPersistent();
+        return stats;
+    }
+
+    bool ForwardRenderer::usesDepthPrepass(const RenderCommand &command) const
+    {
+        return command.material->pipelineState.depthTesting.enabled && dynamic_cast<LightMaterial *>(command.material);
+    }
+
+    void ForwardRenderer::drawCommand(const RenderCommand &command, bool depthEqual)
+    {
+        // the VP matrix is still the same in all objects
+        // multiply VP with the M matrix of each object wich we get from command.localToWorld
+        // then using class matrial to send the MPV matrix to the shader
+        // the last step is draw the command using function draw in the mesh , wich draw and swap the buffers and finish the drawing
+        command.material->setup();
+        if (depthEqual)
+        {
+            // The depth is already in the depth buffer, so only the visible fragments pass and there is no need to write it again
+            glDepthFunc(GL_EQUAL);
+            glDepthMask(false);
+        }
+
+        // Check if the command material is of type LightMaterial
+        if (dynamic_cast<our::LightMaterial *>(command.material))
+        {
+            setupLighting(command.material->shader);
+            command.material->shader->set("M", command.localToWorld);
+            command.material->shader->set("M_IT", glm::mat4(command.normalMatrix));
+        }
+        else
+        {
+            command.material->shader->set("transform", VP * command.localToWorld);
+        }
+        command.mesh->draw(command.lod);
+    }
+
+    void ForwardRenderer::drawBatches(bool depthEqual)
+    {
+        for (auto &batch : materialBatches.getBatches())
+        {
+            ShaderProgram *shader = batch.material->variants->get(batch.material->batchedMask);
+            shader->use();
+            batch.material->pipelineState.setup();
+            if (depthEqual && batch.material->pipelineState.depthTesting.enabled)
+            {
+                glDepthFunc(GL_EQUAL);
+                glDepthMask(false);
+            }
+            setupLighting(shader);
+            materialBatches.bind(shader, 5);
+            materialBatches.draw(batch, shader);
         }
     }
 
     void ForwardRenderer::render(World *world, const std::string &postProcessFilter)
+    {
+        if (postProcessFilter.empty())
+        {
+            render(world, postprocessChain);
+            return;
+        }
+        singlePassChain[0] = postProcessFilter;
+        render(world, singlePassChain);
+    }
+
+    void ForwardRenderer::render(World *world, const std::vector<std::string> &chain)
     {
         // First of all, we search for a camera and for all the mesh renderers
         CameraComponent *camera = nullptr;
-        opaqueCommands.clear();
-        transparentCommands.clear();
-        lights_list.clear();
-        street_lights.clear();
+        // Start new lists for this frame in the frame memory
+        std::pmr::memory_resource *frameMemory = getFrameMemory();
+        resetFrameList(opaqueCommands, frameMemory);
+        resetFrameList(transparentCommands, frameMemory);
+        resetFrameList(lights, frameMemory);
+        resetFrameList(meshEntities, frameMemory);
+        resetFrameList(meshMatrices, frameMemory);
+        resetFrameList(parentMatrices, frameMemory);
+        meshTransforms.clear();
         // std::unordered_set<our::Light
         for (auto entity : world->getEntities())
         {
             // If we hadn't found a camera yet, we look for a camera in this entity
             if (!camera)
                 camera = entity->getComponent<CameraComponent>();
-            // If this entity has a mesh renderer component
-            if (auto meshRenderer = entity->getComponent<MeshRendererComponent>(); meshRenderer)
+            // If this entity has a mesh renderer component, we collect its local transform to compose its matrix later
+            if (entity->getComponent<MeshRendererComponent>())
             {
-                // We construct a command from it
-                RenderCommand command;
-                command.localToWorld = meshRenderer->getOwner()->getLocalToWorldMatrix();
-                command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
-                command.mesh = meshRenderer->mesh;
-                command.material = meshRenderer->material;
-                // if it is transparent, we add it to the transparent commands list
-                // transparentCommands.push_back(command);
-                if (command.material->transparent)
-                {
-                    transparentCommands.push_back(command);
-                }
-                else
-                {
-                    // Otherwise, we add it to the opaque command list
-                    opaqueCommands.push_back(command);
-                }
+                meshEntities.push_back(entity);
+                meshTransforms.push(entity->localTransform);
             }
             // If this entity has a light component
             if (auto light = entity->getComponent<LightComponent>(); light)
             {
-                // If the light is spot add this in the street_lights list
-                if (light->lightType == SPOT)
-                {
-                    street_lights.push_back(light);
-                }
-                else
-                {
-                    // otherwise add this in the lights_list list
-                    lights_list.push_back(light);
-                }
+                lights.push_back(light);
             }
         }
 
@@ -189,11 +461,58 @@ namespace our
         // wich is point to the negative z direction
         auto owner = camera->getOwner();
         auto M = owner->getLocalToWorldMatrix();
-        glm::vec3 eye = M * glm::vec4(0, 0, 0, 1);
+        eye = M * glm::vec4(0, 0, 0, 1);
         glm::vec3 center = M * glm::vec4(0, 0, -1, 1);
-        glm::vec3 cameraForward = glm::normalize(center - eye);
+        cameraForward = glm::normalize(center - eye);
+        glm::mat4 projection = camera->getProjectionMatrix(this->windowSize);
+        updateRenderScale();
+        // The number of pixels covered by one world unit at a distance of 1 (or at any distance for an orthographic camera)
+        float pixelsPerUnit = projection[1][1] * renderSize.y * 0.5f;
+        bool perspective = camera->cameraType == CameraType::PERSPECTIVE;
+
+        // Compose the local matrices of all the mesh renderers at once (see "transform-batch.hpp")
+        meshMatrices.resize(meshEntities.size());
+        composeTransforms(meshTransforms, meshMatrices.data());
+        for (size_t index = 0; index < meshEntities.size(); ++index)
+        {
+            Entity *entity = meshEntities[index];
+            auto meshRenderer = entity->getComponent<MeshRendererComponent>();
+            // We construct a command from it
+            RenderCommand command;
+            command.localToWorld = meshMatrices[index];
+            command.normalMatrix = entity->localTransform.getNormalMatrix();
+            if (entity->parent)
+            {
+                const ParentMatrices &parent = getParentMatrices(entity->parent);
+                command.localToWorld = parent.localToWorld * command.localToWorld;
+                command.normalMatrix = parent.normalMatrix * command.normalMatrix;
+            }
+            command.mesh = meshRenderer->mesh;
+            // The bounding sphere of the mesh in the world (the radius is scaled by the largest scale of the matrix)
+            command.center = glm::vec3(command.localToWorld * glm::vec4(command.mesh->getBoundsCenter(), 1));
+            float scale = std::max({glm::length(glm::vec3(command.localToWorld[0])), glm::length(glm::vec3(command.localToWorld[1])),
+                                    glm::length(glm::vec3(command.localToWorld[2]))});
+            command.radius = command.mesh->getBoundsRadius() * scale;
+            // Pick the level of detail from the error of each level in pixels at the nearest point of the bounding sphere
+            float distance = perspective ? std::max(glm::distance(command.center, eye) - command.radius, camera->near) : 1.0f;
+            meshRenderer->lod = command.mesh->selectLOD(pixelsPerUnit * scale / distance, meshRenderer->lod, lodThreshold, lodHysteresis);
+            command.lod = meshRenderer->lod;
+            command.material = meshRenderer->material;
+            // if it is transparent, we add it to the transparent commands list
+            if (command.material->transparent)
+            {
+                transparentCommands.push_back(command);
+            }
+            else
+            {
+                // Otherwise, we add it to the opaque command list
+                opaqueCommands.push_back(command);
+            }
+        }
+
+        glm::vec3 forward = cameraForward;
         std::sort(transparentCommands.begin(), transparentCommands.end(),
-                  [cameraForward](const RenderCommand &first, const RenderCommand &second)
+                  [forward](const RenderCommand &first, const RenderCommand &second)
                   {
                       // TODO: (Req 9) Finish this function
                       //  HINT: the following return should return true "first" should be drawn before "second".
@@ -201,37 +520,103 @@ namespace our
                       // by multiply each object by the forawd vector of the camera, then the far object will get begger value than the near
                       // then the far object appare first in the vector
 
-                      return glm::dot(cameraForward, first.center) > glm::dot(cameraForward, second.center);
+                      return glm::dot(forward, first.center) > glm::dot(forward, second.center);
                   });
-
-        std::sort(street_lights.begin(), street_lights.end(),
-                  [cameraForward](const LightComponent *first, const LightComponent *second)
+        // The opaque objects are drawn from front to back so that the depth test discards the hidden fragments
+        // before running their fragment shader (early depth testing)
+        std::sort(opaqueCommands.begin(), opaqueCommands.end(),
+                  [forward](const RenderCommand &first, const RenderCommand &second)
                   {
-                      /**
-                       * The function sorts the street lights in ascending order based on their distance from the camera's position along the x-axis.
-                       * The camera's forward direction is considered to determine the distance.
-                       * The street lights closer to the camera (smaller x-axis position) will have lower indices in the sorted list.
-                       */
-                      // Calculate the world positions of the first and second light components
-                      auto first_pos = glm::vec3(first->getOwner()->getLocalToWorldMatrix() *
-                                                 glm::vec4(first->getOwner()->localTransform.position, 1.0));
-                      auto second_pos = glm::vec3(second->getOwner()->getLocalToWorldMatrix() *
-                                                  glm::vec4(second->getOwner()->localTransform.position, 1.0));
-
-                      // Compare the x-axis positions of the first and second light components
-                      // The light with a smaller x-axis position(in -x direction) or bigger in +x (closer to the camera) will have a lower index in the sorted list
-                      return first_pos.x > second_pos.x;
+                      return glm::dot(forward, first.center) < glm::dot(forward, second.center);
                   });
+        // The data of this frame is written to the next region of the dynamic buffer (the GPU may still read the last ones)
+        frameData.beginFrame();
+        // Group the opaque commands of the packed materials into instanced batches (their instances keep this order)
+        materialBatches.update(opaqueCommands);
 
         // TODO: (Req 9) Get the camera ViewProjection matrix and store it in VP
         // get the view matrix and projection matrix from the camera and multiply them both
-        glm::mat4 VP = camera->getProjectionMatrix(this->windowSize) * camera->getViewMatrix();
+        VP = projection * camera->getViewMatrix();
+        frameTimer.begin();
+        // Draw the shadow maps that changed (this has to happen before the clusters since they store the shadow index of each light)
+        shadowTimer.begin();
+        shadowMaps.update(lights, opaqueCommands, camera->getViewMatrix(), projection, camera->near, camera->far);
+        shadowTimer.end();
+        // Bin the lights into the clusters of the camera view frustum
+        lightClusters.update(lights, camera->getViewMatrix(), projection, camera->near, camera->far,
+                             camera->cameraType == CameraType::PERSPECTIVE, renderSize, &shadowMaps);
         // p*v *m
         //  TODO: (Req 9) Set the OpenGL viewport using viewportStart and viewportSize
         // the view port start from point 0,0 and set the size in x direction and y direction
+        // (the scene is drawn to the bottom left corner of its target when the render scale is less than 1)
+        glViewport(0, 0, renderSize.x, renderSize.y);
+
+        opaqueTimer.begin();
+        renderOpaque();
+        opaqueTimer.end();
+        transparentTimer.begin();
+        renderSky();
+        renderTransparent();
+        transparentTimer.end();
+        postprocessTimer.begin();
+        applyPostprocess(chain.empty() ? postprocessChain : chain);
+        postprocessTimer.end();
+        frameTimer.end();
+        frameData.endFrame();
+    }
 
-        glViewport(0, 0, this->windowSize.x, this->windowSize.y);
+    void ForwardRenderer::updateRenderScale()
+    {
+        if (dynamicResolution && frameTimer.hasResult())
+        {
+            // The GPU time is mostly spent on the pixels, so it changes with the square of the render scale.
+            // Nothing changes while the time is a bit under the budget, otherwise the scale moves slowly towards the one
+            // expected to take 92.5% of the budget (the timer results are a few frames late so a fast change would oscillate)
+            double time = frameTimer.getMilliseconds();
+            if (time > targetMilliseconds || time < targetMilliseconds * 0.85)
+            {
+                float expected = renderScale * float(std::sqrt(targetMilliseconds * 0.925 / std::max(time, 0.01)));
+                renderScale = glm::clamp(renderScale + (expected - renderScale) * 0.1f, minRenderScale, maxRenderScale);
+            }
+        }
+        else if (!dynamicResolution)
+            renderScale = 1.0f;
+        renderSize = glm::clamp(glm::ivec2(glm::vec2(windowSize) * renderScale + 0.5f), glm::ivec2(1), windowSize);
+    }
 
+    void ForwardRenderer::renderDepthPrepass()
+    {
+        depthShader->use();
+        depthShader->set("VP", VP);
+        for (auto &command : opaqueCommands)
+        {
+            if (!usesDepthPrepass(command) || MaterialBatches::isBatched(command))
+                continue;
+            // Keep the face culling & the depth function of the material but write the depth only
+            command.material->pipelineState.setup();
+            glColorMask(false, false, false, false);
+            glDepthMask(true);
+            depthShader->set("M", command.localToWorld);
+            command.mesh->draw(command.lod);
+        }
+        depthBatchedShader->use();
+        depthBatchedShader->set("VP", VP);
+        materialBatches.bind(depthBatchedShader, 5);
+        for (auto &batch : materialBatches.getBatches())
+        {
+            if (!batch.material->pipelineState.depthTesting.enabled)
+                continue;
+            batch.material->pipelineState.setup();
+            glColorMask(false, false, false, false);
+            glDepthMask(true);
+            depthBatchedShader->set("instance_offset", materialBatches.getFirstTexel(batch));
+            batch.mesh->drawInstanced(batch.count, batch.lod);
+        }
+        glColorMask(true, true, true, true);
+    }
+
+    void ForwardRenderer::renderOpaque()
+    {
         // TODO: (Req 9) Set the clear color to black and the clear depth to 1
         glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
         glClearDepth(1);
@@ -252,105 +637,25 @@ namespace our
         // TODO: (Req 9) Clear the color and depth buffers
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // actual clear after setup
 
+        if (depthPrepass)
+        {
+            depthPrepassTimer.begin();
+            renderDepthPrepass();
+            depthPrepassTimer.end();
+        }
+
         // TODO: (Req 9) Draw all the opaque commands
         //  Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
-        for (auto opaqueCommand : opaqueCommands)
+        for (auto &opaqueCommand : opaqueCommands)
         {
-            // the VP matrix is still the same in all objects
-            // multiply VP with the M matrix of each object wich we get from opaqueCommand.localToWorld
-            // then using class matrial to send the MPV matrix to the shader
-            // the last step is draw the command using function draw in the mesh , wich draw and swap the buffers and finish the drawing
-            glm::mat4 M = opaqueCommand.localToWorld;
-            glm::mat4 mpv = VP * M;
-            opaqueCommand.material->setup();
-
-            // Check if the opaqueCommand material is of type LightMaterial
-            if (dynamic_cast<our::LightMaterial *>(opaqueCommand.material))
-            {
-                int index = 0;
-
-                // Loop through the lights_list to send light data to the shader
-                for (auto it = lights_list.begin(); it != lights_list.end(); it++, index++)
-                {
-                    // Set the light type for the current index
-                    opaqueCommand.material->shader->set("lights[" + std::to_string(index) + "].type", (*it)->lightType);
-                    if ((*it)->lightType == 0)
-                    {
-                        // directional light
-                        opaqueCommand.material->shader->set("lights[" + std::to_string(index) + "].direction",
-                                                            (*it)->direction);
-                        opaqueCommand.material->shader->set("lights[" + std::to_string(index) + "].color",
-                                                            (*it)->color);
-                    }
-                    else
-                    {
-                        // point
-                        glm::mat4 m = lights_list[index]->getOwner()->getLocalToWorldMatrix();
-                        glm::mat4 mVP = VP * m;
-                        // take the light position from the position of the owner of the component
-                        // and translate it to the world space
-                        auto lightPosition =
-                            glm::vec3(m *
-                                      glm::vec4((lights_list[index])->getOwner()->localTransform.position, 1.0));
-                        // Set position, color, and attenuation for the point light
-
-                        opaqueCommand.material->shader->set("lights[" + std::to_string(index) + "].position",
-                                                            lightPosition);
-                        opaqueCommand.material->shader->set("lights[" + std::to_string(index) + "].color",
-                                                            (*it)->color);
-                        opaqueCommand.material->shader->set("lights[" + std::to_string(index) + "].attenuation",
-                                                            (*it)->attenuation);
-                    }
-                }
-                int index2 = 0;
-                // Loop through the street_lights to send light data to the shader (limited by SPOT_NUM)
-                for (auto it = street_lights.begin(); index2 < SPOT_NUM; it++, index++, index2++)
-                {
-                    // Set the light type for the current index
-                    opaqueCommand.material->shader->set("lights[" + std::to_string(index) + "].type", (*it)->lightType);
-
-                    // spot light
-                    glm::mat4 m = street_lights[index2]->getOwner()->getLocalToWorldMatrix();
-                    glm::mat4 mVP = m;
-                    auto lightPosition =
-                        glm::vec3(
-                            glm::vec4((street_lights[index2])->getOwner()->localTransform.position, 1.0));
-                    lightPosition.y += 3.0; // Adjusting the position to simulate the upper part of the street light
-
-                    // Set position, direction, color, attenuation, and cone angles for the spot light
-                    opaqueCommand.material->shader->set("lights[" + std::to_string(index) + "].position",
-                                                        lightPosition);
-                    opaqueCommand.material->shader->set("lights[" + std::to_string(index) + "].direction",
-                                                        (*it)->direction);
-                    opaqueCommand.material->shader->set("lights[" + std::to_string(index) + "].color",
-                                                        (*it)->color);
-                    opaqueCommand.material->shader->set("lights[" + std::to_string(index) + "].attenuation",
-                                                        (*it)->attenuation);
-                    opaqueCommand.material->shader->set("lights[" + std::to_string(index) + "].cone_angles",
-                                                        (*it)->cone_angles);
-                }
-                // Set additional shader uniforms for lighting and environment
-
-                opaqueCommand.material->shader->set("light_count", (int32_t)lights_list.size() + SPOT_NUM);
-                opaqueCommand.material->shader->set("sky.top", glm::vec3(0.1, 0.5, 0.1));
-                opaqueCommand.material->shader->set("sky.bottom", glm::vec3(0.1, 0.5, 0.1));
-                opaqueCommand.material->shader->set("sky.horizon", glm::vec3(0.1, 0.5, 0.1));
-
-                opaqueCommand.material->shader->set("VP", VP);
-                opaqueCommand.material->shader->set("M", opaqueCommand.localToWorld);
-                opaqueCommand.material->shader->set("M_IT", glm::transpose(glm::inverse(opaqueCommand.localToWorld)));
-                opaqueCommand.material->shader->set("camera_position", eye); // eye * Model of camera
-            }
-            else
-            {
-                opaqueCommand.material->shader->set("transform", mpv);
-            }
-            opaqueCommand.mesh->draw();
-
-            //? here we should send the data to the vshader here
-            // send VP and M_IT
-            // opaqueCommand.material->shader->set("position", );
+            if (!MaterialBatches::isBatched(opaqueCommand))
+                drawCommand(opaqueCommand, depthPrepass && usesDepthPrepass(opaqueCommand));
         }
+        drawBatches(depthPrepass);
+    }
+
+    void ForwardRenderer::renderSky()
+    {
         // If there is a sky material, draw the sky
         if (this->skyMaterial)
         {
@@ -385,125 +690,191 @@ namespace our
             // Draw the sky sphere
             this->skySphere->draw();
         }
+    }
+
+    void ForwardRenderer::renderTransparent()
+    {
         // TODO: (Req 9) Draw all the transparent commands
         //  Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
-        for (auto transparentCommand : transparentCommands)
+        for (auto &transparentCommand : transparentCommands)
+        {
+            drawCommand(transparentCommand);
+        }
+    }
+
+    ShaderProgram *ForwardRenderer::getPostprocessShader(const std::string &path)
+    {
+        auto it = postprocessShaders.find(path);
+        if (it != postprocessShaders.end())
+            return it->second;
+        ShaderProgram *shader = new ShaderProgram();
+        shader->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
+        shader->attach(path, GL_FRAGMENT_SHADER);
+        // The shader is finished when it is first used so the shaders of a chain are compiled at the same time
+        shader->startLink();
+        postprocessShaders[path] = shader;
+        return shader;
+    }
+
+    void ForwardRenderer::preloadPostprocess(const std::vector<std::string> &chain)
+    {
+        for (auto &path : chain)
+            getPostprocessShader(path);
+    }
+
+    ForwardRenderer::PostprocessTargets &ForwardRenderer::getPostprocessTargets(float scale)
+    {
+        for (auto &targets : postprocessTargets)
+            if (targets.scale == scale)
+                return targets;
+        PostprocessTargets targets;
+        targets.scale = scale;
+        targets.size = glm::max(glm::ivec2(glm::vec2(windowSize) * scale), glm::ivec2(1));
+        glGenFramebuffers(2, targets.frameBuffers);
+        for (int index = 0; index < 2; ++index)
         {
-            // the VP matrix is still the same in all objects
-            // multiply VP with the M matrix of each object wich we get from transparentCommand.localToWorld
-            // then using class matrial to send the MPV matrix to the shader
-            // the last step is draw the command using function draw in the mesh , wich draw and swap the buffers and finish the drawing
-
-            glm::mat4 M = transparentCommand.localToWorld;
-            glm::mat4 mpv = VP * M;
-            transparentCommand.material->setup();
-            if (dynamic_cast<our::LightMaterial *>(transparentCommand.material))
+            targets.textures[index] = texture_utils::empty(GL_RGBA8, targets.size);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targets.frameBuffers[index]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, targets.textures[index]->getOpenGLName(), 0);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        postprocessTargets.push_back(targets);
+        return postprocessTargets.back();
+    }
+
+    void ForwardRenderer::applyPostprocess(const std::vector<std::string> &chain)
+    {
+        // If there is a postprocess material, apply postprocessing
+        if (postprocessMaterial)
+        {
+            glBindVertexArray(postProcessVertexArray);
+            // The scene viewport may only cover a part of the targets, but the passes always cover all of them
+            glViewport(0, 0, windowSize.x, windowSize.y);
+            // The first pass reads the scene color, then each pass reads what the pass before it drew
+            Texture2D *source = colorTarget;
+            // The HDR scene is tone mapped first. If the rest of the chain only copies the image, the tone mapping draws
+            // directly to the screen instead
+            if (hdr)
             {
-                int index = 0;
-                for (auto it = lights_list.begin(); it != lights_list.end(); it++, index++)
-                {
-                    // we need to send all the lights entity to the shader
-                    // we need to send the data corresponding to each type of light
-                    transparentCommand.material->shader->set("lights[" + std::to_string(index) + "].type",
-                                                             (*it)->lightType);
-                    if ((*it)->lightType == 0)
-                    {
-                        // directional light
-                        transparentCommand.material->shader->set("lights[" + std::to_string(index) + "].direction",
-                                                                 (*it)->direction);
-                        transparentCommand.material->shader->set("lights[" + std::to_string(index) + "].color",
-                                                                 (*it)->color);
-                    }
-                    else
-                    {
-                        // point light
-                        transparentCommand.material->shader->set("lights[" + std::to_string(index) + "].position",
-                                                                 (*it)->getOwner()->localTransform.position);
-                        transparentCommand.material->shader->set("lights[" + std::to_string(index) + "].color",
-                                                                 (*it)->color);
-                        transparentCommand.material->shader->set("lights[" + std::to_string(index) + "].attenuation",
-                                                                 (*it)->attenuation);
-                    }
-                }
-                int index2 = 0;
-                for (auto it = street_lights.begin(); index2 < SPOT_NUM; it++, index++, index2++)
+                if (!bloomLevels.empty())
+                    renderBloom();
+                auto &fullTargets = postprocessTargets.front();
+                bool toScreen = chain.empty() || (chain.size() == 1 && chain.front() == "assets/shaders/blit.frag");
+                applyToneMapping(toScreen ? 0 : fullTargets.frameBuffers[1]);
+                if (toScreen)
+                    return;
+                source = fullTargets.textures[1];
+            }
+            // If the scene was drawn at a lower resolution, it is upscaled to the second full resolution target first
+            else if (renderSize != windowSize)
+            {
+                auto &fullTargets = postprocessTargets.front();
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, postprocessFrameBuffer);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fullTargets.frameBuffers[1]);
+                glBlitFramebuffer(0, 0, renderSize.x, renderSize.y, 0, 0, windowSize.x, windowSize.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+                source = fullTargets.textures[1];
+            }
+            bool onScreen = false;
+            for (size_t index = 0; index < chain.size(); ++index)
+            {
+                auto scale = postprocessScales.find(chain[index]);
+                auto &targets = getPostprocessTargets(scale != postprocessScales.end() ? scale->second : 1.0f);
+                postprocessMaterial->texture = source;
+                // TODO: (Req 11) Return to the default framebuffer
+                // the default is to unbind the framebuffer (only the last pass draws to the screen if it runs at the full resolution)
+                onScreen = index + 1 == chain.size() && targets.scale == 1.0f;
+                if (onScreen)
+                    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+                else
                 {
-                    // we need to send all the lights entlightComponenty to the shader
-                    // we need to send the data corresponding to each type of light
-                    transparentCommand.material->shader->set("lights[" + std::to_string(index) + "].type", (*it)->lightType);
-
-                    // spot light
-                    glm::mat4 m = street_lights[index2]->getOwner()->getLocalToWorldMatrix();
-                    glm::mat4 mVP = m;
-                    auto lightPosition =
-                        glm::vec3(
-                            glm::vec4((street_lights[index2])->getOwner()->localTransform.position, 1.0));
-                    lightPosition.y += 3.0; // to simulate the upper part of the streat light not the base part
-                    transparentCommand.material->shader->set("lights[" + std::to_string(index) + "].position",
-                                                             lightPosition);
-                    transparentCommand.material->shader->set("lights[" + std::to_string(index) + "].direction",
-                                                             (*it)->direction);
-                    transparentCommand.material->shader->set("lights[" + std::to_string(index) + "].color",
-                                                             (*it)->color);
-                    transparentCommand.material->shader->set("lights[" + std::to_string(index) + "].attenuation",
-                                                             (*it)->attenuation);
-                    transparentCommand.material->shader->set("lights[" + std::to_string(index) + "].cone_angles",
-                                                             (*it)->cone_angles);
+                    int target = targets.textures[0] == source ? 1 : 0;
+                    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targets.frameBuffers[target]);
+                    glViewport(0, 0, targets.size.x, targets.size.y);
+                    source = targets.textures[target];
                 }
-                // std::cout << "num of lightsis : " << (int32_t)lights_list.size() << std::endl;
-                transparentCommand.material->shader->set("light_count", (int32_t)lights_list.size());
-                transparentCommand.material->shader->set("sky.top", glm::vec3(0.1, 0.5, 0.1));
-                transparentCommand.material->shader->set("sky.bottom", glm::vec3(0.1, 0.5, 0.1));
-                transparentCommand.material->shader->set("sky.horizon", glm::vec3(0.1, 0.5, 0.1));
-
-                transparentCommand.material->shader->set("VP", VP);
-                transparentCommand.material->shader->set("M", transparentCommand.localToWorld);
-                transparentCommand.material->shader->set("M_IT",
-                                                         glm::transpose(glm::inverse(transparentCommand.localToWorld)));
-                transparentCommand.material->shader->set("camera_position", eye); // eye * Model of camera
+                // TODO: (Req 11) Setup the postprocess material and draw the fullscreen triangle
+                // A pass whose shader is still being compiled by the driver (e.g. an effect that was just preloaded) only copies
+                // the image this frame instead of stalling the frame till the shader is finished
+                ShaderProgram *shader = getPostprocessShader(chain[index]);
+                if (!shader->isReady())
+                    shader = getPostprocessShader("assets/shaders/blit.frag");
+                postprocessMaterial->shader = shader;
+                postprocessMaterial->setup();
+                glDrawArrays(GL_TRIANGLES, 0, 3);
+                glViewport(0, 0, windowSize.x, windowSize.y);
             }
-            else
+            // If the last pass ran at a lower resolution, its output is upsampled to the screen
+            if (!onScreen && !chain.empty())
             {
-                transparentCommand.material->shader->set("transform", mpv);
+                glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+                postprocessMaterial->texture = source;
+                postprocessMaterial->shader = getPostprocessShader("assets/shaders/blit.frag");
+                postprocessMaterial->setup();
+                glDrawArrays(GL_TRIANGLES, 0, 3);
             }
-            transparentCommand.mesh->draw();
         }
-        // If there is a postprocess material, apply postprocessing
-        if (postprocessMaterial)
+    }
+
+    void ForwardRenderer::renderBloom()
+    {
+        // The first level is downsampled from the part of the scene target that holds the scene (see the dynamic resolution)
+        glm::vec2 sceneScale = glm::vec2(renderSize) / glm::vec2(windowSize);
+        ShaderProgram *downsample = getPostprocessShader("assets/shaders/hdr/bloom-downsample.frag");
+        postprocessMaterial->shader = downsample;
+        for (size_t level = 0; level < bloomLevels.size(); ++level)
         {
-            // Create the post processing shader
-            if (lastPostProcess != postProcessFilter)
-            {
-                // Create a sampler to use for sampling the scene texture in the post processing shader
-                Sampler *postprocessSampler = new Sampler();
-                postprocessSampler->set(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-                postprocessSampler->set(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                postprocessSampler->set(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-                postprocessSampler->set(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-                // Create the post processing shader
-                ShaderProgram *postprocessShader = new ShaderProgram();
-                postprocessShader->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
-                postprocessShader->attach(postProcessFilter, GL_FRAGMENT_SHADER);
-                postprocessShader->link();
-
-                // Create a post processing material
-                postprocessMaterial = new TexturedMaterial();
-                postprocessMaterial->shader = postprocessShader;
-                postprocessMaterial->texture = colorTarget;
-                postprocessMaterial->sampler = postprocessSampler;
-                // The default options are fine but we don't need to interact with the depth buffer
-                postprocessMaterial->pipelineState.depthMask = false;
-                lastPostProcess = postProcessFilter;
-            }
-            // TODO: (Req 11) Return to the default framebuffer
-            // the default is to unbind the framebuffer
-            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-            glBindVertexArray(postProcessVertexArray);
-            // TODO: (Req 11) Setup the postprocess material and draw the fullscreen triangle
+            Texture2D *source = level == 0 ? colorTarget : bloomLevels[level - 1].texture;
+            glm::vec2 sourceSize = level == 0 ? glm::vec2(windowSize) : glm::vec2(bloomLevels[level - 1].size);
+            glm::vec2 uvScale = level == 0 ? sceneScale : glm::vec2(1.0f);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, bloomLevels[level].frameBuffer);
+            glViewport(0, 0, bloomLevels[level].size.x, bloomLevels[level].size.y);
+            postprocessMaterial->texture = source;
             postprocessMaterial->setup();
+            downsample->set("texel_size", 1.0f / sourceSize);
+            downsample->set("uv_scale", uvScale);
+            downsample->set("uv_max", uvScale - 0.5f / sourceSize);
+            downsample->set("prefilter", GLint(level == 0));
+            downsample->set("threshold", glm::vec4(bloomThreshold, bloomThreshold - bloomKnee, 2.0f * bloomKnee, 0.25f / bloomKnee));
             glDrawArrays(GL_TRIANGLES, 0, 3);
         }
+
+        // Each level is blurred while it is added to the level above it, so the first level gets the sum of all of them
+        ShaderProgram *upsample = getPostprocessShader("assets/shaders/hdr/bloom-upsample.frag");
+        postprocessMaterial->shader = upsample;
+        for (size_t level = bloomLevels.size() - 1; level > 0; --level)
+        {
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, bloomLevels[level - 1].frameBuffer);
+            glViewport(0, 0, bloomLevels[level - 1].size.x, bloomLevels[level - 1].size.y);
+            postprocessMaterial->texture = bloomLevels[level].texture;
+            postprocessMaterial->setup();
+            bloomPipelineState.setup();
+            upsample->set("texel_size", bloomRadius / glm::vec2(bloomLevels[level].size));
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        postprocessMaterial->pipelineState.setup();
+        glViewport(0, 0, windowSize.x, windowSize.y);
+    }
+
+    void ForwardRenderer::applyToneMapping(GLuint frameBuffer)
+    {
+        ShaderProgram *tonemap = getPostprocessShader("assets/shaders/hdr/tonemap.frag");
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frameBuffer);
+        postprocessMaterial->shader = tonemap;
+        postprocessMaterial->texture = colorTarget;
+        postprocessMaterial->setup();
+        // Without bloom, the scene is bound in place of the bloom texture (it is multiplied by a zero intensity)
+        glActiveTexture(GL_TEXTURE1);
+        (bloomLevels.empty() ? colorTarget : bloomLevels.front().texture)->bind();
+        postprocessMaterial->sampler->bind(1);
+        tonemap->set("bloom", 1);
+        glm::vec2 uvScale = glm::vec2(renderSize) / glm::vec2(windowSize);
+        tonemap->set("uv_scale", uvScale);
+        tonemap->set("uv_max", uvScale - 0.5f / glm::vec2(windowSize));
+        tonemap->set("exposure", exposure);
+        tonemap->set("bloom_intensity", bloomLevels.empty() ? 0.0f : bloomIntensity);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glActiveTexture(GL_TEXTURE0);
     }
 
-}
\ No newline at end of file
+}
@@ -4,69 +4,217 @@
 #include "../components/camera.hpp"
 #include "../components/mesh-renderer.hpp"
 #include "../components/light.hpp"
+#include "light-clusters.hpp"
+#include "shadow-maps.hpp"
+#include "material-batches.hpp"
+#include "render-command.hpp"
 
 #include "../asset-loader.hpp"
+#include "../ecs/transform-batch.hpp"
+#include "../gpu-timer.hpp"
+#include "../dynamic-buffer.hpp"
 
 #include <glad/gl.h>
+#include <string>
+#include <unordered_map>
 #include <vector>
+#include <memory_resource>
 #include <algorithm>
 #include "../application.hpp"
 
 namespace our
 {
 
-    // The render command stores command that tells the renderer that it should draw
-    // the given mesh at the given localToWorld matrix using the given material
-    // The renderer will fill this struct using the mesh renderer components
-    struct RenderCommand
+    // The statistics of the last rendered frames (the times are the GPU milliseconds spent in each stage of the renderer)
+    // The opaque time includes the depth pre-pass, and the sky is counted with the transparent objects
+    struct RendererStats
     {
-        glm::mat4 localToWorld;
-        glm::vec3 center;
-        Mesh *mesh;
-        Material *material;
+        double frameTime = 0; // The GPU time of the whole frame
+        double shadowTime = 0, depthPrepassTime = 0, opaqueTime = 0, transparentTime = 0, postprocessTime = 0;
+        float renderScale = 1; // The resolution of the scene relative to the window (see "dynamic resolution")
+        size_t opaqueCount = 0, transparentCount = 0;
+        size_t triangleCount = 0; // The triangles drawn by the commands using their levels of detail
+        size_t batchedDraws = 0, batchedInstances = 0; // The instanced draw calls of the material batches & the commands they drew
+        size_t uploadedBytes = 0;                       // The data written to the dynamic buffer in the last frame
+        bool persistentUploads = false;                 // Whether the dynamic buffer is persistently mapped
+        ShadowMaps::Stats shadows;
     };
 
     // A forward renderer is a renderer that draw the object final color directly to the framebuffer
     // In other words, the fragment shader in the material should output the color that we should see on the screen
     // This is different from more complex renderers that could draw intermediate data to a framebuffer before computing the final color
-    // In this project, we only need to implement a forward renderer
+    // (see "deferred-renderer.hpp" which replaces the opaque stage and reuses the other stages of this renderer)
     class ForwardRenderer
     {
+    protected:
         // These window size will be used on multiple occasions (setting the viewport, computing the aspect ratio, etc.)
         glm::ivec2 windowSize;
         // These are two vectors in which we will store the opaque and the transparent commands.
-        // We define them here (instead of being local to the "render" function) as an optimization to prevent reallocating them every frame
-        std::vector<RenderCommand> opaqueCommands;
-        std::vector<RenderCommand> transparentCommands;
-        // These vectors for lighting
-        std::vector<LightComponent *> lights_list;   // store all point and directinal lights
-        std::vector<LightComponent *> street_lights; // store all spot lights
+        // They are constructed again at the start of every "render" on the frame arena of the application (see "frame-arena.hpp"),
+        // so once the arena has grown enough, filling them never calls malloc.
+        std::pmr::vector<RenderCommand> opaqueCommands;
+        std::pmr::vector<RenderCommand> transparentCommands;
+        // The entities that have a mesh renderer, their local transforms and the matrices composed from them in one batch
+        // (the transforms are not on the frame arena: the batch is made of plain vectors that keep their memory between frames)
+        std::pmr::vector<Entity *> meshEntities;
+        TransformBatch meshTransforms;
+        std::pmr::vector<glm::mat4> meshMatrices;
+        // The world matrices of the parents of the mesh renderers, each parent is composed once per frame and shared by its
+        // children (see "getParentMatrices"). Like the lists above, it is constructed again on the frame arena every frame.
+        struct ParentMatrices
+        {
+            glm::mat4 localToWorld;
+            glm::mat3 normalMatrix;
+        };
+        std::pmr::unordered_map<const Entity *, ParentMatrices> parentMatrices;
+        // The per-frame data of the lights, the shadow casters & the material batches is uploaded to this buffer
+        DynamicBuffer frameData;
+        // All the lights in the world, they are binned into clusters for the lighted materials (see "light-clusters.hpp")
+        std::pmr::vector<LightComponent *> lights;
+        LightClusters lightClusters;
+        // The shadow maps of the directional light & the nearest spot lights (the opaque objects are the shadow casters)
+        ShadowMaps shadowMaps;
+        // The opaque lighted objects whose textures are packed in texture arrays are drawn in instanced batches
+        MaterialBatches materialBatches;
+        // The camera data of the current frame (computed at the start of "render" and used by all the stages)
+        glm::vec3 eye, cameraForward;
+        glm::mat4 VP;
         // Objects used for rendering a skybox
         Mesh *skySphere;
-        TexturedMaterial *skyMaterial;
+        TexturedMaterial *skyMaterial = nullptr;
         // Objects used for Postprocessing
         GLuint postprocessFrameBuffer, postProcessVertexArray;
         Texture2D *colorTarget, *depthTarget;
-        TexturedMaterial *postprocessMaterial;
-        Application *app; // The application in which the state runs
-        std::string lastPostProcess = "";
+        TexturedMaterial *postprocessMaterial = nullptr;
+        // The postprocessing passes are applied in order and each pass reads the output of the one before it.
+        // Each pass draws to one of the two targets of its resolution scale (the one it doesn't read) and the last pass draws
+        // to the screen. The expensive passes (e.g. blurs) can run at a lower resolution, then the pass after them (or a final
+        // blit) upsamples their output by reading it with bilinear filtering.
+        struct PostprocessTargets
+        {
+            float scale;
+            glm::ivec2 size;
+            Texture2D *textures[2];
+            GLuint frameBuffers[2];
+        };
+        // The targets of each resolution scale (the first one is the full resolution and its first texture is the scene color)
+        std::vector<PostprocessTargets> postprocessTargets;
+        // The resolution scale of each postprocessing shader that doesn't run at the full resolution (by its path)
+        std::unordered_map<std::string, float> postprocessScales;
+        // The passes given in the config (used when "render" doesn't get any)
+        std::vector<std::string> postprocessChain;
+        // Used by "render" to turn a single filter into a chain without allocating a new vector every frame
+        std::vector<std::string> singlePassChain = std::vector<std::string>(1);
+        // Every postprocessing shader is compiled once and kept here by the path of its fragment shader
+        std::unordered_map<std::string, ShaderProgram *> postprocessShaders;
+        Application *app = nullptr; // The application in which the state runs
+        // The depth pre-pass draws the depth of the opaque lighted objects with a position-only shader first,
+        // so the main pass (with the depth function set to GL_EQUAL) runs "lighted.frag" once per pixel instead of once per fragment
+        bool depthPrepass = false;
+        ShaderProgram *depthShader = nullptr, *depthBatchedShader = nullptr; // The second one draws the material batches
+        // The levels of detail of the meshes are picked so that their error covers at most "lodThreshold" pixels
+        // (see "Mesh::selectLOD" for the hysteresis)
+        float lodThreshold = 1.0f, lodHysteresis = 0.25f;
+        // The dynamic resolution draws the scene at "renderSize" (a part of the scene targets) then upscales it to the window
+        // in the postprocessing stage. The render scale is picked from the GPU time of the last frames so that a frame takes about
+        // "targetMilliseconds" on the GPU (within the limits of the scale).
+        bool dynamicResolution = false;
+        float targetMilliseconds = 16.6f, minRenderScale = 0.5f, maxRenderScale = 1.0f, renderScale = 1.0f;
+        glm::ivec2 renderSize;
+        // When "hdr" is true, the scene is drawn to a floating point target so the bright colors (e.g. emissive surfaces) don't
+        // clip, then the first postprocessing pass (see "assets/shaders/hdr/tonemap.frag") adds the bloom, applies the exposure
+        // and maps the colors to the screen range. The tone mapping also does the upscale of the dynamic resolution, and it draws
+        // directly to the screen when the rest of the chain is a plain blit.
+        bool hdr = false;
+        float exposure = 1.0f;
+        // The bloom halves the bright parts of the scene down a chain of levels, then adds each level back to the one above it
+        // (see "assets/shaders/hdr/bloom-*.frag"). The levels use a small floating point format to save bandwidth.
+        struct BloomLevel
+        {
+            glm::ivec2 size;
+            Texture2D *texture;
+            GLuint frameBuffer;
+        };
+        std::vector<BloomLevel> bloomLevels;
+        float bloomThreshold = 1.0f, bloomKnee = 0.5f, bloomIntensity = 0.05f, bloomRadius = 1.0f;
+        PipelineState bloomPipelineState; // Adds the upsampled levels to the levels above them
+        // The GPU time spent in the whole frame & in each stage (see "gpu-timer.hpp")
+        GpuTimer frameTimer, shadowTimer, depthPrepassTimer, opaqueTimer, transparentTimer, postprocessTimer;
+
+        // Returns the memory resource used for the per-frame lists (the frame arena if the renderer entered an application)
+        std::pmr::memory_resource *getFrameMemory();
+        // Returns the world matrices of the given parent, composing it (and its ancestors) the first time it is asked for in the frame
+        const ParentMatrices &getParentMatrices(const Entity *parent);
+        // Sets the uniforms of a lighted shader that are the same for all the objects in the frame (the lights, the camera, etc.)
+        void setupLighting(ShaderProgram *shader);
+        // Sets up the material of the command (and its transform or lighting uniforms) then draws its mesh
+        // If "depthEqual" is true, the command only draws the fragments that passed the depth pre-pass
+        void drawCommand(const RenderCommand &command, bool depthEqual = false);
+        // Whether the command is drawn in the depth pre-pass (the pre-pass only handles the opaque lighted materials since
+        // their vertex shader computes the position exactly like the depth shader does)
+        bool usesDepthPrepass(const RenderCommand &command) const;
+        // Draws the material batches with the "BATCHED" variant of their shaders (like "drawCommand" does for a single command)
+        void drawBatches(bool depthEqual);
+
+        // The stages of "render" in the order they run
+        // The opaque stage binds the scene framebuffer, clears it and draws the opaque commands
+        void renderDepthPrepass();
+        virtual void renderOpaque();
+        void renderSky();
+        void renderTransparent();
+        void applyPostprocess(const std::vector<std::string> &chain);
+
+        // Returns the postprocessing shader that uses the given fragment shader (it is compiled the first time it is requested)
+        ShaderProgram *getPostprocessShader(const std::string &path);
+        // Picks the render scale of this frame (and the render size) from the measured GPU frame time
+        void updateRenderScale();
+        // Returns the targets of the given resolution scale (they are created the first time they are requested)
+        PostprocessTargets &getPostprocessTargets(float scale);
+        // Draws the bloom levels from the scene color
+        void renderBloom();
+        // Adds the bloom to the scene, tone maps it and draws it to the given framebuffer (see "hdr")
+        void applyToneMapping(GLuint frameBuffer);
 
     public:
+        virtual ~ForwardRenderer() = default;
+
         // Initialize the renderer including the sky and the Postprocessing objects.
         // windowSize is the width & height of the window (in pixels).
-        void initialize(glm::ivec2 windowSize, const nlohmann::json &config);
+        virtual void initialize(glm::ivec2 windowSize, const nlohmann::json &config);
 
         // Clean up the renderer
-        void destroy();
+        virtual void destroy();
 
         // This function should be called every frame to draw the given world
+        // "postProcessFilter" replaces the postprocessing passes of the config with a single pass (if it is not empty)
         void render(World *world, const std::string &postProcessFilter = "");
+        // Same as above but applies the given postprocessing passes in order (if the chain is empty, the passes of the config are used)
+        void render(World *world, const std::vector<std::string> &chain);
+
+        // Compiles the postprocessing shaders of the given chain ahead of time so switching to it later doesn't stall a frame
+        void preloadPostprocess(const std::vector<std::string> &chain);
 
         // When a state enters, it should call this function and give it the pointer to the application
         void enter(Application *app)
         {
             this->app = app;
         }
+
+        // Enables or disables the depth pre-pass (it can also be enabled from the config using "depth-prepass")
+        void setDepthPrepass(bool enabled) { depthPrepass = enabled; }
+        bool isDepthPrepassEnabled() const { return depthPrepass; }
+
+        // Enables or disables the dynamic resolution (it can't be enabled if the renderer has no postprocessing targets
+        // to upscale the scene). When it is disabled, the scene is drawn at the full resolution.
+        void setDynamicResolution(bool enabled) { dynamicResolution = enabled && postprocessMaterial; }
+        bool isDynamicResolutionEnabled() const { return dynamicResolution; }
+
+        // The exposure multiplies the HDR scene colors before the tone mapping (it has no effect if "hdr" is disabled)
+        void setExposure(float value) { exposure = value; }
+        float getExposure() const { return exposure; }
+        bool isHDREnabled() const { return hdr; }
+
+        RendererStats getStats() const;
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "light-clusters.hpp"
+#include "shadow-maps.hpp"
+#include "../ecs/entity.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#define DIRECTIONAL 0
+#define POINT 1
+#define SPOT 2
+
+namespace our
+{
+
+    void LightClusters::initialize(const nlohmann::json &config, DynamicBuffer &frameData)
+    {
+        if (config.is_object())
+        {
+            gridSize.x = std::max(1, config.value("x", gridSize.x));
+            gridSize.y = std::max(1, config.value("y", gridSize.y));
+            gridSize.z = std::max(1, config.value("z", gridSize.z));
+            threshold = std::max(1e-6f, config.value("threshold", threshold));
+        }
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+
+        // The dynamic buffer is viewed through a buffer texture for each format the shader expects (the textures are owned by it)
+        this->frameData = &frameData;
+        lightTexture = frameData.createTexture(GL_RGBA32F);
+        clusterTexture = frameData.createTexture(GL_RG32UI);
+        indexTexture = frameData.createTexture(GL_R32UI);
+    }
+
+    void LightClusters::destroy()
+    {
+        frameData = nullptr;
+        lightTexture = clusterTexture = indexTexture = 0;
+    }
+
+    glm::vec3 LightClusters::getLightPosition(const LightComponent *light)
+    {
+        Entity *owner = light->getOwner();
+        if (light->lightType == SPOT)
+        {
+            // The street lights are placed at the top of their pole (their entity is at the base)
+            return owner->localTransform.position + glm::vec3(0, 3, 0);
+        }
+        return glm::vec3(owner->getLocalToWorldMatrix() * glm::vec4(owner->localTransform.position, 1.0));
+    }
+
+    float LightClusters::getLightRange(const LightComponent *light, float threshold)
+    {
+        // The intensity at distance d is color / (a*d^2 + b*d + c), so we solve a*d^2 + b*d + c = color / threshold
+        float brightest = std::max({light->color.r, light->color.g, light->color.b});
+        float a = light->attenuation.x, b = light->attenuation.y, c = light->attenuation.z;
+        float k = brightest / threshold - c;
+        if (k <= 0.0f)
+            return 0.0f; // The light is never bright enough to matter
+        if (a > 0.0f)
+            return (-b + std::sqrt(b * b + 4.0f * a * k)) / (2.0f * a);
+        if (b > 0.0f)
+            return k / b;
+        return -1.0f; // No falloff, so the light reaches everything
+    }
+
+    int LightClusters::sliceOf(float depth) const
+    {
+        if (depth <= nearPlane)
+            return 0;
+        return std::min(gridSize.z - 1, int(std::log(depth / nearPlane) * depthScale));
+    }
+
+    GLuint LightClusters::addLight(const LightComponent *light, const glm::vec3 &position, const ShadowMaps *shadows)
+    {
+        auto index = GLuint(lightData.size() / 4);
+        lightData.emplace_back(position, float(light->lightType));
+        lightData.emplace_back(light->direction, light->cone_angles.x);
+        lightData.emplace_back(light->color, light->cone_angles.y);
+        lightData.emplace_back(light->attenuation, float(shadows ? shadows->getShadowIndex(light) : -1));
+        return index;
+    }
+
+    void LightClusters::update(const std::pmr::vector<LightComponent *> &lights, const glm::mat4 &view,
+                               const glm::mat4 &projection, float near, float far, bool perspective, glm::ivec2 viewportSize,
+                               const ShadowMaps *shadows)
+    {
+        lightData.clear();
+        assignments.clear();
+        int clusterCount = gridSize.x * gridSize.y * gridSize.z;
+        tileSize = glm::vec2(viewportSize) / glm::vec2(gridSize.x, gridSize.y);
+        nearPlane = std::max(near, 1e-4f);
+        depthScale = float(gridSize.z) / std::log(std::max(far, nearPlane * 1.001f) / nearPlane);
+
+        // The global lights come first (they are not binned). Lights that are too dim to matter are dropped.
+        // With an orthographic camera, the tile bounds below don't apply so every light is global.
+        for (auto light : lights)
+        {
+            float range = light->lightType == DIRECTIONAL ? -1.0f : getLightRange(light, threshold);
+            if (range < 0.0f || (!perspective && range > 0.0f))
+                addLight(light, getLightPosition(light), shadows);
+        }
+        globalCount = int(lightData.size() / 4);
+        if (perspective)
+        {
+            for (auto light : lights)
+            {
+                if (light->lightType == DIRECTIONAL)
+                    continue;
+                float range = getLightRange(light, threshold);
+                if (range <= 0.0f)
+                    continue;
+                glm::vec3 position = getLightPosition(light);
+                glm::vec3 center = glm::vec3(view * glm::vec4(position, 1.0f));
+                // The view space depth range of the light sphere (the camera looks down -z)
+                float nearest = -center.z - range, farthest = -center.z + range;
+                if (farthest < near || nearest > far)
+                    continue;
+                // The screen space bounds of the box around the sphere: x/depth is extreme at the corners of the box
+                float depths[2] = {std::max(nearest, nearPlane), std::max(farthest, nearPlane)};
+                glm::vec2 minimum(1e30f), maximum(-1e30f);
+                for (float depth : depths)
+                    for (float dx : {-range, range})
+                        for (float dy : {-range, range})
+                        {
+                            glm::vec2 ndc = glm::vec2(projection[0][0] * (center.x + dx), projection[1][1] * (center.y + dy)) / depth;
+                            minimum = glm::min(minimum, ndc);
+                            maximum = glm::max(maximum, ndc);
+                        }
+                if (maximum.x < -1.0f || maximum.y < -1.0f || minimum.x > 1.0f || minimum.y > 1.0f)
+                    continue; // Outside the screen
+                GLuint index = addLight(light, position, shadows);
+                glm::ivec2 first = glm::clamp(glm::ivec2(glm::floor((minimum * 0.5f + 0.5f) * glm::vec2(gridSize))),
+                                              glm::ivec2(0), glm::ivec2(gridSize) - 1);
+                glm::ivec2 last = glm::clamp(glm::ivec2(glm::floor((maximum * 0.5f + 0.5f) * glm::vec2(gridSize))),
+                                             glm::ivec2(0), glm::ivec2(gridSize) - 1);
+                for (int z = sliceOf(nearest); z <= sliceOf(farthest); ++z)
+                    for (int y = first.y; y <= last.y; ++y)
+                        for (int x = first.x; x <= last.x; ++x)
+                            assignments.emplace_back(GLuint(x + gridSize.x * (y + gridSize.y * z)), index);
+            }
+        }
+
+        // Sort the assignments into the clusters (a counting sort since we know the number of clusters)
+        clusters.assign(clusterCount, glm::uvec2(0));
+        for (auto &[cluster, light] : assignments)
+            ++clusters[cluster].y;
+        GLuint offset = 0;
+        for (auto &cluster : clusters)
+        {
+            cluster.x = offset;
+            offset += cluster.y;
+            cluster.y = 0;
+        }
+        indices.resize(std::min<size_t>(offset, size_t(maxTexels)));
+        for (auto &[cluster, light] : assignments)
+        {
+            auto &range = clusters[cluster];
+            if (range.x + range.y < indices.size())
+                indices[range.x + range.y++] = light;
+        }
+        if (offset > indices.size())
+        {
+            std::cerr << "Too many light assignments (" << offset << "), some lights were dropped" << std::endl;
+        }
+
+        // Upload the data to the region of this frame in the dynamic buffer
+        lightOffset = frameData->upload(lightData.data(), GLsizeiptr(lightData.size() * sizeof(glm::vec4)));
+        clusterOffset = frameData->upload(clusters.data(), GLsizeiptr(clusters.size() * sizeof(glm::uvec2)));
+        indexOffset = frameData->upload(indices.data(), GLsizeiptr(indices.size() * sizeof(GLuint)));
+    }
+
+    void LightClusters::bind(ShaderProgram *shader, GLuint firstUnit) const
+    {
+        GLuint textures[] = {lightTexture, clusterTexture, indexTexture};
+        const char *names[] = {"light_data", "light_clusters", "light_indices"};
+        for (GLuint index = 0; index < 3; ++index)
+        {
+            glActiveTexture(GL_TEXTURE0 + firstUnit + index);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[index]);
+            shader->set(names[index], GLint(firstUnit + index));
+        }
+        shader->set("light_offsets", glm::ivec3(frameData->getTexel(lightOffset, sizeof(glm::vec4)),
+                                                frameData->getTexel(clusterOffset, sizeof(glm::uvec2)),
+                                                frameData->getTexel(indexOffset, sizeof(GLuint))));
+        shader->set("global_light_count", GLint(globalCount));
+        shader->set("cluster_count", gridSize);
+        shader->set("cluster_tile_size", tileSize);
+        shader->set("cluster_near", nearPlane);
+        shader->set("cluster_depth_scale", depthScale);
+    }
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "../components/light.hpp"
+#include "../shader/shader.hpp"
+#include "../dynamic-buffer.hpp"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+#include <memory_resource>
+#include <vector>
+
+namespace our
+{
+    class ShadowMaps;
+
+    // Clustered forward lighting: instead of letting every fragment loop over every light in the scene,
+    // the view frustum is split into a 3D grid of clusters (screen tiles in x & y and exponential depth slices in z)
+    // and every frame, each light is added to the clusters that its sphere of influence touches.
+    // The fragment shader then finds its cluster and only loops over the lights in it.
+    // The data is sent to the shaders through 3 buffer textures (OpenGL 3.3 has no storage buffers) that view the dynamic buffer
+    // of the renderer, and "light_offsets" holds the texel where the data of this frame starts in each of them:
+    //  - "light_data" (RGBA32F): 4 texels per light (position & type, direction & inner cone angle, color & outer cone angle,
+    //    attenuation & shadow index)
+    //  - "light_clusters" (RG32UI): for each cluster, the offset & the count of its lights in "light_indices"
+    //  - "light_indices" (R32UI): the light indices of all the clusters packed one after the other
+    // The lights that affect everything (directional lights & lights with no distance falloff) are placed first in
+    // "light_data" and are applied to every fragment without going through the clusters ("global_light_count").
+    class LightClusters
+    {
+        // The number of clusters along each axis
+        glm::ivec3 gridSize = {16, 9, 24};
+        // A light is considered to have no effect once its intensity (color / attenuation) falls below this value
+        float threshold = 1.0f / 256.0f;
+
+        // The data of every frame is uploaded to the dynamic buffer of the renderer (see "dynamic-buffer.hpp")
+        DynamicBuffer *frameData = nullptr;
+        GLsizeiptr lightOffset = 0, clusterOffset = 0, indexOffset = 0;
+        GLuint lightTexture = 0, clusterTexture = 0, indexTexture = 0;
+        GLint maxTexels = 65536; // The maximum size of a buffer texture (queried from the driver)
+
+        // These are kept here (instead of being local to "update") to prevent reallocating them every frame
+        std::vector<glm::vec4> lightData;
+        std::vector<glm::uvec2> clusters;
+        std::vector<GLuint> indices;
+        std::vector<std::pair<GLuint, GLuint>> assignments; // (cluster, light) pairs before they are sorted into the clusters
+
+        int globalCount = 0;
+        glm::vec2 tileSize;
+        float nearPlane = 0.1f, depthScale = 1.0f;
+
+        // Returns the depth slice that contains the given view depth
+        int sliceOf(float depth) const;
+        // Adds the light to the light data and returns its index
+        GLuint addLight(const LightComponent *light, const glm::vec3 &position, const ShadowMaps *shadows);
+
+    public:
+        // Creates the buffer textures that read the data from the given dynamic buffer
+        // The grid size & the threshold can be changed in the config: { "x": 16, "y": 9, "z": 24, "threshold": 0.004 }
+        void initialize(const nlohmann::json &config, DynamicBuffer &frameData);
+        void destroy();
+
+        // Bins the lights into the clusters of the given camera and uploads the result
+        // "lights" holds every light component in the world, "view" & "projection" are the camera matrices,
+        // "near" & "far" are the camera clip planes and "viewportSize" is the size of the viewport in pixels
+        // If "shadows" is given, the shadow index of each light is stored with its data (see "shadow-maps.hpp")
+        void update(const std::pmr::vector<LightComponent *> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+                    float near, float far, bool perspective, glm::ivec2 viewportSize, const ShadowMaps *shadows = nullptr);
+
+        // Binds the buffer textures starting from the given texture unit and sets the cluster uniforms of the shader
+        void bind(ShaderProgram *shader, GLuint firstUnit) const;
+
+        // Returns where the renderer places the light of the given component in the world
+        static glm::vec3 getLightPosition(const LightComponent *light);
+        // Returns the distance after which the light intensity falls below "threshold" (or a negative number if it never does)
+        static float getLightRange(const LightComponent *light, float threshold);
+    };
+
+}
@@ -0,0 +1,101 @@
+#include "material-batches.hpp"
+
+namespace our
+{
+
+    void MaterialBatches::initialize(DynamicBuffer &frameData)
+    {
+        this->frameData = &frameData;
+        instanceTexture = frameData.createTexture(GL_RGBA32F);
+    }
+
+    void MaterialBatches::destroy()
+    {
+        frameData = nullptr;
+        instanceTexture = 0;
+        batches.clear();
+        instances.clear();
+    }
+
+    bool MaterialBatches::isBatched(const RenderCommand &command)
+    {
+        auto material = dynamic_cast<LightMaterial *>(command.material);
+        return material && material->textureArray;
+    }
+
+    void MaterialBatches::update(const std::pmr::vector<RenderCommand> &commands)
+    {
+        batches.clear();
+        batchIndices.clear();
+        instances.clear();
+
+        // Find the batch of every batched command (there are few batches so they are searched linearly)
+        for (auto &command : commands)
+        {
+            if (!isBatched(command))
+                continue;
+            auto material = static_cast<LightMaterial *>(command.material);
+            uint32_t index = 0;
+            for (; index < batches.size(); ++index)
+            {
+                auto &batch = batches[index];
+                if (batch.mesh == command.mesh && batch.lod == command.lod &&
+                    batch.material->textureArray == material->textureArray && batch.material->sampler == material->sampler &&
+                    batch.material->variants == material->variants && batch.material->pipelineState == material->pipelineState)
+                    break;
+            }
+            if (index == batches.size())
+                batches.push_back({material, command.mesh, command.lod, 0, 0});
+            ++batches[index].count;
+            batchIndices.push_back(index);
+        }
+        if (batches.empty())
+            return;
+
+        // Each batch gets a contiguous range of instances
+        GLint offset = 0;
+        for (auto &batch : batches)
+        {
+            batch.offset = offset;
+            offset += batch.count;
+            batch.count = 0;
+        }
+        instances.resize(size_t(offset) * TEXELS_PER_INSTANCE);
+        size_t next = 0;
+        for (auto &command : commands)
+        {
+            if (!isBatched(command))
+                continue;
+            auto &batch = batches[batchIndices[next++]];
+            auto material = static_cast<LightMaterial *>(command.material);
+            glm::vec4 *instance = &instances[size_t(batch.offset + batch.count++) * TEXELS_PER_INSTANCE];
+            for (int column = 0; column < 4; ++column)
+                instance[column] = command.localToWorld[column];
+            for (int column = 0; column < 3; ++column)
+                instance[4 + column] = glm::vec4(command.normalMatrix[column], 0.0f);
+            // The layers of the albedo, the specular, the roughness & the ambient occlusion then the emissive layer & intensity
+            instance[7] = glm::vec4(material->layers[0], material->layers[1], material->layers[3], material->layers[4]);
+            instance[8] = glm::vec4(material->layers[2], material->emissiveIntensity, 0.0f, 0.0f);
+        }
+
+        instanceOffset = frameData->upload(instances.data(), GLsizeiptr(instances.size() * sizeof(glm::vec4)));
+    }
+
+    void MaterialBatches::bind(ShaderProgram *shader, GLuint unit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_BUFFER, instanceTexture);
+        shader->set("instance_data", GLint(unit));
+    }
+
+    void MaterialBatches::draw(const Batch &batch, ShaderProgram *shader) const
+    {
+        glActiveTexture(GL_TEXTURE0);
+        batch.material->textureArray->bind();
+        batch.material->sampler->bind(0);
+        shader->set("material_textures", 0);
+        shader->set("instance_offset", getFirstTexel(batch));
+        batch.mesh->drawInstanced(batch.count, batch.lod);
+    }
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "render-command.hpp"
+#include "../shader/shader.hpp"
+#include "../dynamic-buffer.hpp"
+
+#include <cstdint>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <memory_resource>
+#include <vector>
+
+namespace our
+{
+
+    // Draws the opaque commands whose lighted material has its textures packed in a texture array (see "AssetLoader<TextureArray>")
+    // in instanced batches: the commands that use the same mesh, texture array, sampler & pipeline state are drawn in one call
+    // even if their materials are different, since the layers of the material of each instance are sent with its matrices.
+    // Like the shadow casters, the instance data of all the batches is uploaded once per frame to the dynamic buffer of the renderer
+    // and read through a buffer texture ("instance_data", 9 texels per instance, see "lighted.vert").
+    class MaterialBatches
+    {
+    public:
+        static constexpr int TEXELS_PER_INSTANCE = 9;
+
+        // The instances drawn in one call (the material is the one of the first instance, it gives the shared state)
+        struct Batch
+        {
+            LightMaterial *material;
+            Mesh *mesh;
+            int lod;
+            GLint offset; // The first instance of the batch
+            GLsizei count;
+        };
+
+    private:
+        DynamicBuffer *frameData = nullptr;
+        GLsizeiptr instanceOffset = 0; // Where the instances of this frame are in the dynamic buffer
+        GLuint instanceTexture = 0;
+        // These are kept here (instead of being local to "update") to prevent reallocating them every frame
+        std::vector<Batch> batches;
+        std::vector<uint32_t> batchIndices; // The batch of each batched command (in the order of the commands)
+        std::vector<glm::vec4> instances;
+
+    public:
+        // The instance data is uploaded to the given dynamic buffer
+        void initialize(DynamicBuffer &frameData);
+        void destroy();
+
+        // Whether the command is drawn by a batch instead of being drawn alone
+        static bool isBatched(const RenderCommand &command);
+
+        // Groups the batched commands into batches & uploads their instance data
+        // The instances keep the order of the commands inside each batch (so they are still drawn from front to back)
+        void update(const std::pmr::vector<RenderCommand> &commands);
+
+        // Binds the instance data to the given texture unit and sets "instance_data" of the shader
+        void bind(ShaderProgram *shader, GLuint unit) const;
+        // Returns the texel of "instance_data" where the instances of the batch start (the shaders get it as "instance_offset")
+        GLint getFirstTexel(const Batch &batch) const
+        {
+            return frameData->getTexel(instanceOffset, sizeof(glm::vec4)) + TEXELS_PER_INSTANCE * batch.offset;
+        }
+        // Binds the texture array & the sampler of the batch to the texture unit 0 then draws its instances
+        // (the shader must be in use, have the "BATCHED" feature and be bound to the instance data)
+        void draw(const Batch &batch, ShaderProgram *shader) const;
+
+        const std::vector<Batch> &getBatches() const { return batches; }
+        size_t getInstanceCount() const { return instances.size() / TEXELS_PER_INSTANCE; }
+    };
+
+}
@@ -26,7 +26,7 @@ namespace our {
                 if (movement && motionState == our::MotionState::RUNNING) {
                     // Change the position and rotation based on the linear & angular velocity and delta time.
                     entity->localTransform.position += deltaTime * movement->linearVelocity;
-                    entity->localTransform.rotation += deltaTime * movement->angularVelocity;
+                    entity->localTransform.rotate(movement->angularVelocity, deltaTime);
                 }
             }
         }
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../mesh/mesh.hpp"
+#include "../material/material.hpp"
+
+#include <glm/glm.hpp>
+
+namespace our
+{
+
+    // The render command stores command that tells the renderer that it should draw
+    // the given mesh at the given localToWorld matrix using the given material
+    // The renderer will fill this struct using the mesh renderer components
+    struct RenderCommand
+    {
+        glm::mat4 localToWorld;
+        glm::mat3 normalMatrix; // The inverse transpose of localToWorld (used to transform the normals for lighting)
+        glm::vec3 center;       // The center of the bounding sphere of the mesh in the world space
+        float radius;           // The radius of the bounding sphere of the mesh in the world space
+        Mesh *mesh;
+        int lod;                // The level of detail of the mesh to draw
+        Material *material;
+    };
+
+}
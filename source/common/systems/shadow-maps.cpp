@@ -0,0 +1,451 @@
+#include "shadow-maps.hpp"
+#include "light-clusters.hpp"
+#include "../ecs/entity.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <glm/gtc/matrix_transform.hpp>
+#define DIRECTIONAL 0
+#define POINT 1
+#define SPOT 2
+
+namespace our
+{
+
+    // Hashes the bytes of a value (FNV-1a)
+    template <typename T>
+    static uint64_t hashOf(const T &value, uint64_t hash = 1469598103934665603ull)
+    {
+        auto bytes = reinterpret_cast<const unsigned char *>(&value);
+        for (size_t index = 0; index < sizeof(T); ++index)
+            hash = (hash ^ bytes[index]) * 1099511628211ull;
+        return hash;
+    }
+
+    // Extracts the 6 planes of the frustum of a view projection matrix (the normals point inwards)
+    static void frustumPlanes(const glm::mat4 &VP, glm::vec4 planes[6])
+    {
+        glm::mat4 rows = glm::transpose(VP);
+        planes[0] = rows[3] + rows[0]; // left
+        planes[1] = rows[3] - rows[0]; // right
+        planes[2] = rows[3] + rows[1]; // bottom
+        planes[3] = rows[3] - rows[1]; // top
+        planes[4] = rows[3] + rows[2]; // near
+        planes[5] = rows[3] - rows[2]; // far
+        for (int index = 0; index < 6; ++index)
+            planes[index] /= glm::length(glm::vec3(planes[index]));
+    }
+
+    static bool sphereInFrustum(const glm::vec4 planes[6], const glm::vec3 &center, float radius, bool skipNear)
+    {
+        for (int index = 0; index < 6; ++index)
+        {
+            if (skipNear && index == 4)
+                continue;
+            if (glm::dot(glm::vec3(planes[index]), center) + planes[index].w < -radius)
+                return false;
+        }
+        return true;
+    }
+
+    // Maps the clip space [-1, 1] to the texture space [0, 1]
+    static const glm::mat4 clipToTexture = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+
+    void ShadowMaps::initialize(const nlohmann::json &config, DynamicBuffer &frameData)
+    {
+        enabled = config.value("enabled", true) && !config.empty();
+        cascadeCount = std::clamp(config.value("cascades", cascadeCount), 1, MAX_CASCADES);
+        cascadeResolution = std::max(1, config.value("resolution", cascadeResolution));
+        distance = config.value("distance", distance);
+        splitLambda = std::clamp(config.value("split-lambda", splitLambda), 0.0f, 1.0f);
+        spotResolution = std::max(1, config.value("spot-resolution", spotResolution));
+        atlasSize = std::max(spotResolution, config.value("atlas-size", atlasSize));
+        int tilesPerRow = atlasSize / spotResolution;
+        spotCount = std::clamp(config.value("spot-count", spotCount), 0, std::min(MAX_SPOT_SHADOWS, tilesPerRow * tilesPerRow));
+        // The shaders always sample the shadow textures, so they are created (with a single texel) even if the shadows are disabled
+        if (!enabled)
+        {
+            cascadeCount = 1;
+            cascadeResolution = atlasSize = 1;
+            spotCount = 0;
+        }
+
+        auto setupDepthTexture = [](GLenum target)
+        {
+            // Sampling with a comparison gives a filtered shadow factor (a 2x2 PCF for free with linear filtering)
+            glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        };
+        glGenTextures(1, &cascadeTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, cascadeTexture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, cascadeResolution, cascadeResolution, cascadeCount, 0,
+                     GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        setupDepthTexture(GL_TEXTURE_2D_ARRAY);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        glGenTextures(1, &atlasTexture);
+        glBindTexture(GL_TEXTURE_2D, atlasTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, atlasSize, atlasSize, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+        setupDepthTexture(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &frameBuffer);
+        this->frameData = &frameData;
+        instanceTexture = frameData.createTexture(GL_RGBA32F);
+
+        shader = new ShaderProgram();
+        shader->attach("assets/shaders/shadow.vert", GL_VERTEX_SHADER);
+        shader->attach("assets/shaders/depth-only.frag", GL_FRAGMENT_SHADER);
+        shader->startLink();
+
+        for (auto &cascade : cascades)
+            cascade = ShadowMap();
+        spots.assign(spotCount, ShadowMap());
+        directional = nullptr;
+
+        for (int index = 0; index < cascadeCount; ++index)
+        {
+            std::string element = "[" + std::to_string(index) + "]";
+            cascadeMatrixNames[index] = "shadow_cascade_matrices" + element;
+            cascadeSplitNames[index] = "shadow_cascade_splits" + element;
+            cascadeTexelNames[index] = "shadow_cascade_texels" + element;
+        }
+        for (int tile = 0; tile < spotCount; ++tile)
+            spotMatrixNames[tile] = "shadow_spot_matrices[" + std::to_string(tile) + "]";
+    }
+
+    void ShadowMaps::destroy()
+    {
+        glDeleteFramebuffers(1, &frameBuffer);
+        glDeleteTextures(1, &cascadeTexture);
+        glDeleteTextures(1, &atlasTexture);
+        frameBuffer = cascadeTexture = atlasTexture = instanceTexture = 0;
+        frameData = nullptr;
+        delete shader;
+        shader = nullptr;
+    }
+
+    void ShadowMaps::collectCasters(ShadowMap &map, const std::pmr::vector<RenderCommand> &casters, bool clampDepth)
+    {
+        glm::vec4 planes[6];
+        frustumPlanes(map.lightVP, planes);
+        visible.clear();
+        // The key doesn't depend on the order of the casters (their order changes every frame since they are sorted by depth)
+        uint64_t casterSum = 0;
+        for (auto &caster : casters)
+        {
+            if (!sphereInFrustum(planes, caster.center, caster.radius, clampDepth))
+                continue;
+            visible.push_back(&caster);
+            casterSum += hashOf(caster.localToWorld, hashOf(caster.lod, hashOf(caster.mesh)));
+        }
+        uint64_t key = hashOf(casterSum, hashOf(visible.size(), hashOf(map.lightVP)));
+        map.batchCount = 0;
+        if (map.valid && map.key == key)
+        {
+            ++stats.cachedMaps;
+            return;
+        }
+        map.key = key;
+        map.valid = false; // It becomes valid once it is drawn
+
+        // Group the instances of each mesh (and level of detail) together so that each of them is drawn with a single call
+        std::sort(visible.begin(), visible.end(), [](const RenderCommand *first, const RenderCommand *second)
+                  { return first->mesh != second->mesh ? first->mesh < second->mesh : first->lod < second->lod; });
+        map.firstBatch = batches.size();
+        for (auto caster : visible)
+        {
+            if (map.batchCount == 0 || batches.back().mesh != caster->mesh || batches.back().lod != caster->lod)
+            {
+                batches.push_back({caster->mesh, caster->lod, GLint(instances.size()), 0});
+                ++map.batchCount;
+            }
+            instances.push_back(caster->localToWorld);
+            ++batches.back().count;
+        }
+    }
+
+    void ShadowMaps::fitCascades(const glm::mat4 &view, const glm::mat4 &projection, float near, float far)
+    {
+        float farPlane = std::min(far, distance);
+        // The split depths blend a logarithmic split (which matches the perspective) and a uniform one
+        for (int index = 0; index < cascadeCount; ++index)
+        {
+            float p = float(index + 1) / float(cascadeCount);
+            float logarithmic = near * std::pow(farPlane / near, p);
+            float uniform = near + (farPlane - near) * p;
+            cascadeSplits[index] = splitLambda * logarithmic + (1.0f - splitLambda) * uniform;
+        }
+
+        glm::mat4 inverseVP = glm::inverse(projection * view);
+        auto ndcDepth = [&projection](float depth)
+        {
+            glm::vec4 clip = projection * glm::vec4(0.0f, 0.0f, -depth, 1.0f);
+            return clip.z / clip.w;
+        };
+        glm::vec3 lightDirection = glm::normalize(directional->direction);
+        glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+        for (int index = 0; index < cascadeCount; ++index)
+        {
+            // Find the bounding sphere of the slice of the camera frustum (a sphere so that its size doesn't change with the rotation)
+            float depths[2] = {index == 0 ? near : cascadeSplits[index - 1], cascadeSplits[index]};
+            glm::vec3 corners[8];
+            int count = 0;
+            for (float depth : depths)
+                for (float x : {-1.0f, 1.0f})
+                    for (float y : {-1.0f, 1.0f})
+                    {
+                        glm::vec4 corner = inverseVP * glm::vec4(x, y, ndcDepth(depth), 1.0f);
+                        corners[count++] = glm::vec3(corner) / corner.w;
+                    }
+            glm::vec3 center(0.0f);
+            for (auto &corner : corners)
+                center += corner / 8.0f;
+            float radius = 0.0f;
+            for (auto &corner : corners)
+                radius = std::max(radius, glm::length(corner - center));
+            radius = std::ceil(radius * 16.0f) / 16.0f;
+
+            glm::mat4 lightView = glm::lookAt(center - lightDirection * radius, center, up);
+            glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius);
+            // Snap the cascade to its texels: move it such that the world origin falls exactly on a texel
+            glm::vec4 origin = lightProjection * lightView * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            glm::vec2 texels = glm::vec2(origin) * (cascadeResolution * 0.5f);
+            glm::vec2 offset = (glm::round(texels) - texels) * (2.0f / cascadeResolution);
+            lightProjection[3][0] += offset.x;
+            lightProjection[3][1] += offset.y;
+
+            auto &cascade = cascades[index];
+            cascade.light = directional;
+            cascade.lightVP = lightProjection * lightView;
+            cascade.textureMatrix = clipToTexture * cascade.lightVP;
+            cascadeTexels[index] = 2.0f * radius / cascadeResolution;
+        }
+    }
+
+    void ShadowMaps::assignSpots(const std::pmr::vector<LightComponent *> &lights, const glm::mat4 &VP, const glm::vec3 &eye)
+    {
+        glm::vec4 planes[6];
+        frustumPlanes(VP, planes);
+        spotCandidates.clear();
+        for (auto light : lights)
+        {
+            if (light->lightType != SPOT)
+                continue;
+            float range = LightClusters::getLightRange(light, threshold);
+            if (range == 0.0f)
+                continue;
+            glm::vec3 position = LightClusters::getLightPosition(light);
+            if (range > 0.0f && !sphereInFrustum(planes, position, range, false))
+                continue;
+            spotCandidates.emplace_back(glm::length(position - eye), light);
+        }
+        size_t count = std::min(spotCandidates.size(), spots.size());
+        std::partial_sort(spotCandidates.begin(), spotCandidates.begin() + count, spotCandidates.end(),
+                          [](auto &first, auto &second)
+                          { return first.first < second.first; });
+
+        // Keep every light that had a tile in the last frame in the same tile (so the tile can be reused if nothing changed)
+        takenTiles.assign(spots.size(), false);
+        unplacedSpots.clear();
+        for (size_t index = 0; index < count; ++index)
+        {
+            auto light = spotCandidates[index].second;
+            auto it = std::find_if(spots.begin(), spots.end(), [light](const ShadowMap &spot)
+                                   { return spot.light == light; });
+            if (it != spots.end())
+                takenTiles[it - spots.begin()] = true;
+            else
+                unplacedSpots.push_back(light);
+        }
+        for (size_t tile = 0; tile < spots.size(); ++tile)
+        {
+            if (takenTiles[tile])
+                continue;
+            spots[tile].light = nullptr;
+            if (!unplacedSpots.empty())
+            {
+                spots[tile].light = unplacedSpots.back();
+                spots[tile].valid = false;
+                unplacedSpots.pop_back();
+            }
+        }
+
+        int tilesPerRow = atlasSize / spotResolution;
+        float tileScale = float(spotResolution) / float(atlasSize);
+        for (size_t tile = 0; tile < spots.size(); ++tile)
+        {
+            auto &spot = spots[tile];
+            if (!spot.light)
+                continue;
+            glm::vec3 position = LightClusters::getLightPosition(spot.light);
+            glm::vec3 direction = glm::normalize(spot.light->direction);
+            glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(0, 0, 1) : glm::vec3(0, 1, 0);
+            float range = LightClusters::getLightRange(spot.light, threshold);
+            if (range < 0.0f)
+                range = distance;
+            // The frustum fits the outer cone of the light
+            float fov = glm::clamp(2.0f * spot.light->cone_angles.y, 0.1f, glm::radians(170.0f));
+            spot.lightVP = glm::perspective(fov, 1.0f, std::min(0.05f, range * 0.5f), range) *
+                           glm::lookAt(position, position + direction, up);
+            glm::vec2 corner = glm::vec2(float(tile % tilesPerRow), float(tile / tilesPerRow)) * tileScale;
+            glm::mat4 tileMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(corner, 0.0f)) *
+                                   glm::scale(glm::mat4(1.0f), glm::vec3(tileScale, tileScale, 1.0f));
+            spot.textureMatrix = tileMatrix * clipToTexture * spot.lightVP;
+        }
+    }
+
+    void ShadowMaps::drawBatches(const ShadowMap &map)
+    {
+        shader->set("light_VP", map.lightVP);
+        GLint firstTexel = frameData->getTexel(instanceOffset, sizeof(glm::vec4));
+        for (size_t index = map.firstBatch; index < map.firstBatch + map.batchCount; ++index)
+        {
+            auto &batch = batches[index];
+            shader->set("instance_offset", firstTexel + 4 * batch.offset);
+            batch.mesh->drawInstanced(batch.count, batch.lod);
+            ++stats.casterDraws;
+            stats.casterInstances += batch.count;
+        }
+    }
+
+    void ShadowMaps::update(const std::pmr::vector<LightComponent *> &lights, const std::pmr::vector<RenderCommand> &casters,
+                            const glm::mat4 &view, const glm::mat4 &projection, float near, float far)
+    {
+        stats = Stats();
+        configuredShaders.clear();
+        if (!enabled)
+            return;
+
+        // The first directional light casts the cascaded shadows
+        directional = nullptr;
+        for (auto light : lights)
+        {
+            if (light->lightType == DIRECTIONAL)
+            {
+                directional = light;
+                break;
+            }
+        }
+        glm::vec3 eye = glm::vec3(glm::inverse(view)[3]);
+        if (directional)
+            fitCascades(view, projection, near, far);
+        assignSpots(lights, projection * view, eye);
+
+        // Find the maps that changed and the casters to draw in them
+        instances.clear();
+        batches.clear();
+        if (directional)
+            for (int index = 0; index < cascadeCount; ++index)
+                collectCasters(cascades[index], casters, true);
+        for (auto &spot : spots)
+            if (spot.light)
+                collectCasters(spot, casters, false);
+        if (stats.cachedMaps == (directional ? cascadeCount : 0) + int(std::count_if(spots.begin(), spots.end(), [](const ShadowMap &spot)
+                                                                                      { return spot.light != nullptr; })))
+            return; // Every map can be reused
+
+        // Upload the matrices of all the instances at once
+        instanceOffset = frameData->upload(instances.data(), GLsizeiptr(instances.size() * sizeof(glm::mat4)));
+
+        glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LEQUAL);
+        glDepthMask(true);
+        glColorMask(false, false, false, false);
+        glDisable(GL_BLEND);
+        // Both faces are drawn since some models are not closed, and the depth is pushed back a bit to avoid shadow acne
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(1.5f, 4.0f);
+        shader->use();
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_BUFFER, instanceTexture);
+        shader->set("instance_matrices", 0);
+
+        // The casters between the light and a cascade are flattened on its near plane
+        glEnable(GL_DEPTH_CLAMP);
+        glViewport(0, 0, cascadeResolution, cascadeResolution);
+        for (int index = 0; directional && index < cascadeCount; ++index)
+        {
+            auto &cascade = cascades[index];
+            if (cascade.valid)
+                continue;
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cascadeTexture, 0, index);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            drawBatches(cascade);
+            cascade.valid = true;
+            ++stats.renderedMaps;
+        }
+        glDisable(GL_DEPTH_CLAMP);
+
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, atlasTexture, 0);
+        glEnable(GL_SCISSOR_TEST);
+        int tilesPerRow = atlasSize / spotResolution;
+        for (size_t tile = 0; tile < spots.size(); ++tile)
+        {
+            auto &spot = spots[tile];
+            if (!spot.light || spot.valid)
+                continue;
+            int x = int(tile % tilesPerRow) * spotResolution, y = int(tile / tilesPerRow) * spotResolution;
+            glViewport(x, y, spotResolution, spotResolution);
+            glScissor(x, y, spotResolution, spotResolution);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            drawBatches(spot);
+            spot.valid = true;
+            ++stats.renderedMaps;
+        }
+        glDisable(GL_SCISSOR_TEST);
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glColorMask(true, true, true, true);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void ShadowMaps::bind(ShaderProgram *shader, GLuint firstUnit) const
+    {
+        glActiveTexture(GL_TEXTURE0 + firstUnit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, cascadeTexture);
+        glBindSampler(firstUnit, 0);
+        glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+        glBindTexture(GL_TEXTURE_2D, atlasTexture);
+        glBindSampler(firstUnit + 1, 0);
+
+        // The uniforms keep their values in the program, so they are only sent once per frame to each shader
+        if (std::find(configuredShaders.begin(), configuredShaders.end(), shader) != configuredShaders.end())
+            return;
+        configuredShaders.push_back(shader);
+        shader->set(cascadesName, GLint(firstUnit));
+        shader->set(atlasName, GLint(firstUnit + 1));
+        shader->set(cascadeCountName, enabled && directional ? cascadeCount : 0);
+        for (int index = 0; enabled && directional && index < cascadeCount; ++index)
+        {
+            shader->set(cascadeMatrixNames[index], cascades[index].textureMatrix);
+            shader->set(cascadeSplitNames[index], cascadeSplits[index]);
+            shader->set(cascadeTexelNames[index], cascadeTexels[index]);
+        }
+        for (size_t tile = 0; tile < spots.size(); ++tile)
+            if (spots[tile].light)
+                shader->set(spotMatrixNames[tile], spots[tile].textureMatrix);
+        shader->set(spotTexelName, 2.0f / float(spotResolution));
+    }
+
+    int ShadowMaps::getShadowIndex(const LightComponent *light) const
+    {
+        if (!enabled)
+            return -1;
+        if (light->lightType == DIRECTIONAL)
+            return light == directional ? 0 : -1;
+        for (size_t tile = 0; tile < spots.size(); ++tile)
+            if (spots[tile].light == light)
+                return int(tile);
+        return -1;
+    }
+
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "render-command.hpp"
+#include "../components/light.hpp"
+#include "../shader/shader.hpp"
+#include "../dynamic-buffer.hpp"
+
+#include <cstdint>
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace our
+{
+
+    // Shadow mapping for the directional light and the nearest spot lights.
+    //  - The directional light uses cascaded shadow maps: the view frustum (up to "distance") is split into a few depth ranges
+    //    and each range gets its own orthographic shadow map (a layer of a depth texture array), so the shadows near the camera
+    //    get more texels than the far ones. The cascades are snapped to their texels so they don't shimmer when the camera moves.
+    //  - The spot lights nearest to the camera get a perspective shadow map each, packed as tiles in a single depth atlas.
+    // Every shadow map only draws the casters whose bounding sphere is inside its frustum, and the casters are drawn instanced
+    // (one draw call per mesh). The matrices of the instances are uploaded to the dynamic buffer of the renderer like the lights are.
+    // A shadow map is only drawn again when its light or the casters inside it change (e.g. the street lights are static so
+    // their tiles are reused until an object moves in or out of them).
+    // The shaders find the shadow map of a light using the shadow index that "LightClusters" stores with the light data.
+    class ShadowMaps
+    {
+    public:
+        static constexpr int MAX_CASCADES = 4;
+        static constexpr int MAX_SPOT_SHADOWS = 16;
+
+        // What was drawn in the last update
+        struct Stats
+        {
+            int renderedMaps = 0, cachedMaps = 0;               // The shadow maps that were drawn & the ones reused from before
+            size_t casterDraws = 0, casterInstances = 0;         // The instanced draw calls & the instances they drew
+        };
+
+    private:
+        // A shadow map (a cascade or a tile of the atlas) and what was drawn in it the last time
+        struct ShadowMap
+        {
+            const LightComponent *light = nullptr; // The light that owns the map this frame (null if the map is unused)
+            glm::mat4 lightVP;                     // From the world space to the clip space of the light
+            glm::mat4 textureMatrix;               // From the world space to the texture space of the map (used by the shaders)
+            uint64_t key = 0;                      // A hash of the light matrix & the casters in the map
+            bool valid = false;                    // Whether the content of the map was drawn using "key"
+            size_t firstBatch = 0, batchCount = 0; // The caster batches to draw in the map this frame (if it changed)
+        };
+        // The instances of a mesh drawn in one call (the casters use the same level of detail as in the camera view)
+        struct CasterBatch
+        {
+            Mesh *mesh;
+            int lod;
+            GLint offset;
+            GLsizei count;
+        };
+
+        bool enabled = false;
+        int cascadeCount = 3, cascadeResolution = 2048;
+        float distance = 60.0f, splitLambda = 0.75f;
+        int spotCount = 8, spotResolution = 512, atlasSize = 2048;
+        // The range of a spot light (and the far plane of its shadow map) is where its intensity falls below this value
+        float threshold = 1.0f / 256.0f;
+
+        GLuint frameBuffer = 0, cascadeTexture = 0, atlasTexture = 0;
+        DynamicBuffer *frameData = nullptr;
+        GLsizeiptr instanceOffset = 0; // Where the matrices of this frame are in the dynamic buffer
+        GLuint instanceTexture = 0;
+        ShaderProgram *shader = nullptr;
+
+        ShadowMap cascades[MAX_CASCADES];
+        float cascadeSplits[MAX_CASCADES] = {}, cascadeTexels[MAX_CASCADES] = {};
+        std::vector<ShadowMap> spots; // One per tile of the atlas
+        const LightComponent *directional = nullptr;
+
+        // These are kept here (instead of being local to "update") to prevent reallocating them every frame
+        std::vector<const RenderCommand *> visible;
+        std::vector<glm::mat4> instances;
+        std::vector<CasterBatch> batches;
+        std::vector<std::pair<float, const LightComponent *>> spotCandidates;
+        std::vector<bool> takenTiles;                      // The tiles kept by the lights that had them in the last frame
+        std::vector<const LightComponent *> unplacedSpots; // The lights that need a new tile
+        mutable std::vector<const ShaderProgram *> configuredShaders; // The shaders that got the uniforms of this frame
+        // The names of the uniforms are kept here (the names of the array elements are built by "initialize")
+        // instead of being built every time a shader is bound
+        std::string cascadesName = "shadow_cascades", atlasName = "shadow_atlas";
+        std::string cascadeCountName = "shadow_cascade_count", spotTexelName = "shadow_spot_texel";
+        std::string cascadeMatrixNames[MAX_CASCADES], cascadeSplitNames[MAX_CASCADES], cascadeTexelNames[MAX_CASCADES];
+        std::string spotMatrixNames[MAX_SPOT_SHADOWS];
+
+        Stats stats;
+
+        // Culls the casters against the light frustum of the map and prepares their batches if the map has to be drawn again
+        // "clampDepth" means that the casters in front of the near plane still count (they are clamped to it while drawing)
+        void collectCasters(ShadowMap &map, const std::pmr::vector<RenderCommand> &casters, bool clampDepth);
+        // Fits the cascades of the directional light around the slices of the camera frustum
+        void fitCascades(const glm::mat4 &view, const glm::mat4 &projection, float near, float far);
+        // Picks the nearest visible spot lights and gives each of them a tile in the atlas
+        void assignSpots(const std::pmr::vector<LightComponent *> &lights, const glm::mat4 &VP, const glm::vec3 &eye);
+        void drawBatches(const ShadowMap &map);
+
+    public:
+        // Creates the shadow maps (the matrices of the casters are uploaded to the given dynamic buffer)
+        // The options can be changed in the config (shadows are disabled if "enabled" is false):
+        // { "enabled": true, "cascades": 3, "resolution": 2048, "distance": 60, "split-lambda": 0.75,
+        //   "spot-count": 8, "spot-resolution": 512, "atlas-size": 2048 }
+        void initialize(const nlohmann::json &config, DynamicBuffer &frameData);
+        void destroy();
+
+        // Picks the lights that cast shadows this frame then draws their shadow maps (unless they can be reused)
+        // "casters" are the commands that cast shadows, "view" & "projection" are the camera matrices and "near" & "far" its planes
+        // NOTE: this changes the framebuffer, the viewport & the pipeline state
+        void update(const std::pmr::vector<LightComponent *> &lights, const std::pmr::vector<RenderCommand> &casters,
+                    const glm::mat4 &view, const glm::mat4 &projection, float near, float far);
+
+        // Binds the shadow textures to the given texture unit & the one after it and sets the shadow uniforms of the shader
+        void bind(ShaderProgram *shader, GLuint firstUnit) const;
+
+        // Returns the shadow index of the light that the shaders use to find its shadow map (-1 if it has no shadows this frame)
+        int getShadowIndex(const LightComponent *light) const;
+
+        bool isEnabled() const { return enabled; }
+        const Stats &getStats() const { return stats; }
+    };
+
+}
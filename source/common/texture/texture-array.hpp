@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/vec2.hpp>
+
+namespace our {
+
+    // This class defines an OpenGL texture which will be used as a GL_TEXTURE_2D_ARRAY
+    // All the layers of the array have the same size, so many textures can be bound at once (the shader picks a layer by its index)
+    class TextureArray {
+        // The OpenGL object name of this texture
+        GLuint name = 0;
+        glm::ivec2 size = {0, 0};
+        GLsizei layers = 0;
+    public:
+        // Creates the texture & allocates the storage of all its layers (with all their mip levels if "mipmaps" is true)
+        TextureArray(GLenum format, glm::ivec2 size, GLsizei layers, bool mipmaps = true) : size(size), layers(layers) {
+            glGenTextures(1, &this->name);
+            GLsizei levels = 1;
+            if (mipmaps)
+                for (int largest = size.x > size.y ? size.x : size.y; largest > 1; largest /= 2)
+                    ++levels;
+            bind();
+            glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, format, size.x, size.y, layers);
+            unbind();
+        }
+
+        // This deconstructor deletes the underlying OpenGL texture
+        ~TextureArray() {
+            glDeleteTextures(1, &this->name);
+        }
+
+        // Get the internal OpenGL name of the texture which is useful for use with framebuffers
+        GLuint getOpenGLName() const {
+            return name;
+        }
+
+        glm::ivec2 getSize() const { return size; }
+        GLsizei getLayerCount() const { return layers; }
+
+        // This method binds this texture to GL_TEXTURE_2D_ARRAY
+        void bind() const {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, this->name);
+        }
+
+        // This static method ensures that no texture is bound to GL_TEXTURE_2D_ARRAY
+        static void unbind() {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        }
+
+        TextureArray(const TextureArray &) = delete;
+
+        TextureArray &operator=(const TextureArray &) = delete;
+    };
+
+}
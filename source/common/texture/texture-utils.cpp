@@ -44,6 +44,18 @@ our::Texture2D *our::texture_utils::empty(GLenum format, glm::ivec2 size)
 }
 
 our::Texture2D *our::texture_utils::loadImage(const std::string &filename, bool generate_mipmap)
+{
+    // Create a texture
+    our::Texture2D *texture = new our::Texture2D();
+    if (!loadImage(texture, filename, generate_mipmap))
+    {
+        delete texture;
+        return nullptr;
+    }
+    return texture;
+}
+
+bool our::texture_utils::loadImage(our::Texture2D *texture, const std::string &filename, bool generate_mipmap)
 {
     glm::ivec2 size;
     int channels;
@@ -62,10 +74,8 @@ our::Texture2D *our::texture_utils::loadImage(const std::string &filename, bool
     if (pixels == nullptr)
     {
         std::cerr << "Failed to load image: " << filename << std::endl;
-        return nullptr;
+        return false;
     }
-    // Create a texture
-    our::Texture2D *texture = new our::Texture2D();
     // Bind the texture such that we upload the image data to its storage
     // TODO: (Req 5) Finish this function to fill the texture with the data found in "pixels"
 
@@ -90,5 +100,60 @@ our::Texture2D *our::texture_utils::loadImage(const std::string &filename, bool
 
     // The purpose of this function is to free the memory that was allocated by the stbi_load function, which is used to load an image into memory.
     stbi_image_free(pixels); // Free image data after uploading to GPU
-    return texture;
-}
\ No newline at end of file
+    return true;
+}
+glm::ivec2 our::texture_utils::getSize(our::Texture2D *texture)
+{
+    glm::ivec2 size;
+    texture->bind();
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &size.x);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &size.y);
+    texture->unbind();
+    return size;
+}
+
+our::TextureArray *our::texture_utils::packLayers(const std::vector<our::Texture2D *> &textures, glm::ivec2 size, GLenum format)
+{
+    auto array = new our::TextureArray(format, size, GLsizei(textures.size()));
+
+    // Each texture is copied by blitting it from a read framebuffer to a draw framebuffer holding its layer
+    // (so the texture is copied & scaled on the GPU without reading it back)
+    GLint readFrameBuffer = 0, drawFrameBuffer = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFrameBuffer);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFrameBuffer);
+    GLuint frameBuffers[2];
+    glGenFramebuffers(2, frameBuffers);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, frameBuffers[0]);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frameBuffers[1]);
+    for (size_t layer = 0; layer < textures.size(); ++layer)
+    {
+        // A linear blit that shrinks the image by more than half skips texels (the result aliases), so a bigger texture is
+        // copied from its smallest mip level that is still at least as big as the layer (an undefined level has a zero size)
+        GLint level = 0;
+        glm::ivec2 textureSize = getSize(textures[layer]);
+        textures[layer]->bind();
+        for (;;)
+        {
+            glm::ivec2 next;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level + 1, GL_TEXTURE_WIDTH, &next.x);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level + 1, GL_TEXTURE_HEIGHT, &next.y);
+            if (next.x < size.x || next.y < size.y)
+                break;
+            ++level;
+            textureSize = next;
+        }
+        textures[layer]->unbind();
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[layer]->getOpenGLName(), level);
+        glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, array->getOpenGLName(), 0, GLint(layer));
+        glBlitFramebuffer(0, 0, textureSize.x, textureSize.y, 0, 0, size.x, size.y, GL_COLOR_BUFFER_BIT,
+                          textureSize == size ? GL_NEAREST : GL_LINEAR);
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, GLuint(readFrameBuffer));
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GLuint(drawFrameBuffer));
+    glDeleteFramebuffers(2, frameBuffers);
+
+    array->bind();
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    array->unbind();
+    return array;
+}
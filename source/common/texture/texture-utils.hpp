@@ -1,7 +1,9 @@
 #pragma once
 
 #include "texture2d.hpp"
+#include "texture-array.hpp"
 #include <string>
+#include <vector>
 
 #include <glad/gl.h>
 #include <glm/vec2.hpp>
@@ -11,4 +13,13 @@ namespace our::texture_utils {
     Texture2D* empty(GLenum format, glm::ivec2 size);
     // This function loads an image and sends its data to the given Texture2D 
     Texture2D* loadImage(const std::string& filename, bool generate_mipmap = true);
+    // Same as above but the image replaces the content of an existing texture (used to reload the texture when its file changes)
+    // Returns false if the image couldn't be loaded (then the texture is unchanged)
+    bool loadImage(Texture2D* texture, const std::string& filename, bool generate_mipmap = true);
+    // Returns the size of the first level of the texture
+    glm::ivec2 getSize(Texture2D* texture);
+    // Copies the textures into the layers of a new texture array (in the same order). The textures that have a different size
+    // than "size" are scaled (with linear filtering, starting from the mip level nearest to "size" when they are bigger).
+    // The mipmaps of the array are generated after copying.
+    TextureArray* packLayers(const std::vector<Texture2D*>& textures, glm::ivec2 size, GLenum format = GL_RGBA8);
 }
\ No newline at end of file
@@ -9,10 +9,13 @@
 */
 #include <iostream>
 #include <fstream>
+#include <filesystem>
 #include <flags/flags.h>
 #include <json/json.hpp>
 
 #include <application.hpp>
+#include <ecs/scene-binary.hpp>
+#include <config-utils.hpp>
 
 #include "states/menu-state.hpp"
 #include "states/game-over.hpp"
@@ -29,8 +32,41 @@
 #include "states/winning-state.hpp"
 #include "states/levels-state.hpp"
 
+#include "states/scene-load-benchmark-state.hpp"
+#include "states/transform-benchmark-state.hpp"
+
 #pragma comment(lib, "irrKlang.lib")
 
+// Cooks every level found in the scene config into a binary scene file inside the given directory
+// The play state will then load these files instead of parsing the levels json (see "ecs/scene-binary.hpp")
+int cookScenes(const nlohmann::json &app_config, const std::string &directory)
+{
+    const auto &scene = app_config["scene"];
+    std::filesystem::create_directories(directory);
+    // The level keys and the level number passed to the world while deserializing them
+    const std::pair<const char *, int> levels[] = {{"world", 1}, {"level1", 1}, {"level2", 2}, {"level3", 3}};
+    // The prefabs are shared by all the levels
+    nlohmann::json prefabs = scene.contains("prefabs") ? our::resolveConfig(scene["prefabs"]) : nlohmann::json::object();
+    int cooked = 0;
+    for (auto &[name, level] : levels)
+    {
+        if (!scene.contains(name))
+            continue;
+        std::string path = directory + "/" + name + ".scene";
+        // The hash of the json sources lets the play state skip the cooked scene once the json is edited
+        uint64_t sourceHash = our::scene_binary::hashSources(scene[name], scene.value("prefabs", nlohmann::json()));
+        if (!our::scene_binary::cook(our::resolveConfig(scene[name]), level, path, prefabs, sourceHash))
+        {
+            std::cerr << "Failed to cook " << name << " into " << path << std::endl;
+            return -1;
+        }
+        std::cout << "Cooked " << name << " into " << path << std::endl;
+        ++cooked;
+    }
+    std::cout << "Cooked " << cooked << " scene(s)" << std::endl;
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
 
@@ -42,6 +78,10 @@ int main(int argc, char **argv)
     // This is useful for testing multiple configurations in a batch
     // Default: 0 where the application runs indefinitely until manually closed
     int run_for_frames = args.get<int>("f", 0);
+    // cook is a directory in which all the levels in the config are cooked into binary scene files
+    // When it is given, the application cooks the levels and exits without opening a window
+    // Default: "" where nothing is cooked
+    std::string cook_directory = args.get<std::string>("cook", "");
 
     // Open the config file and exit if failed
     std::ifstream file_in(config_path);
@@ -54,6 +94,9 @@ int main(int argc, char **argv)
     nlohmann::json app_config = nlohmann::json::parse(file_in, nullptr, true, true);
     file_in.close();
 
+    if (!cook_directory.empty())
+        return cookScenes(app_config, cook_directory);
+
     // Create the application
     our::Application app(app_config);
 
@@ -72,6 +115,8 @@ int main(int argc, char **argv)
     app.registerState<EntityTestState>("entity-test");
     app.registerState<RendererTestState>("renderer-test");
     app.registerState<LevelsState>("levels");
+    app.registerState<SceneLoadBenchmarkState>("scene-load-benchmark");
+    app.registerState<TransformBenchmarkState>("transform-benchmark");
     // Then choose the state to run based on the option "start-scene" in the config
     if (app_config.contains(std::string{"start-scene"}))
     {
@@ -3,13 +3,17 @@
 #include <application.hpp>
 
 #include <ecs/world.hpp>
-#include <systems/forward-renderer.hpp>
+#include <systems/deferred-renderer.hpp>
 #include <systems/free-camera-controller.hpp>
 #include <systems/movement.hpp>
 #include <systems/collision.hpp>
 #include <systems/repeat.hpp>
 #include <systems/final-line.hpp>
+#include <ecs/scene-binary.hpp>
+#include <ecs/component-pool.hpp>
 #include <asset-loader.hpp>
+#include <deque>
+#include <config-utils.hpp>
 
 #ifdef USE_SOUND
 
@@ -21,7 +25,7 @@
 class Playstate : public our::State {
 
     our::World world;
-    our::ForwardRenderer renderer;
+    our::ForwardRenderer *renderer = nullptr; // A forward or a deferred renderer (picked by the renderer config)
     our::FreeCameraControllerSystem cameraController;
     our::MovementSystem movementSystem;
     our::CollisionSystem collisionSystem;
@@ -33,58 +37,128 @@ class Playstate : public our::State {
 
     float collisionStartTime = 0;
 
+    // The level stays loaded after leaving the play state so that replaying the same level (e.g. after a game over)
+    // only needs to restore the world to its initial state instead of reloading everything
+    std::string loadedLevel;
+    our::WorldSnapshot levelStart;
+
+    // While running, a checkpoint is taken every "checkpointInterval" seconds (the newest is at the back)
+    // Pressing F5 rolls the world back to the newest checkpoint (pressing it again goes further back)
+    struct Checkpoint {
+        our::WorldSnapshot world;
+        int countPepsi, heartCount;
+    };
+    std::deque<Checkpoint> checkpoints;
+    float checkpointInterval = 5.0f;
+    size_t maxCheckpoints = 12;
+    float checkpointTimer = 0;
+
+    // Pressing F3 toggles a debug overlay that shows the memory statistics of the engine
+    bool showDebugOverlay = false;
+    // The postprocessing passes used while playing (the grain of a collision is stacked on the vignette)
+    const std::vector<std::string> vignetteChain{"assets/shaders/postprocess/vignette.frag"};
+    const std::vector<std::string> radialBlurChain{"assets/shaders/postprocess/radial-blur.frag"};
+    const std::vector<std::string> sandChain{"assets/shaders/postprocess/sandWethereEffect.frag"};
+    const std::vector<std::string> collisionChain{"assets/shaders/postprocess/Grain.frag",
+                                                  "assets/shaders/postprocess/vignette.frag"};
+
+    // Populates the world with the given level from the scene config and loads the assets it needs
+    // The level can be written inline in the scene config or given as a path to its own json document.
+    // Only the assets referenced by the level are loaded (see "deserializeAssets" in "asset-loader.hpp").
+    // If the scene config has a "cooked-scenes" directory holding a cooked version of the level (see "ecs/scene-binary.hpp"),
+    // the cooked version is loaded instead since it skips all the json parsing. The cooked version is only used while the
+    // level & prefabs json match the ones it was cooked from (see "scene_binary::hashSources"), so json edits aren't ignored.
+    void loadLevel(const nlohmann::json &config, const std::string &name) {
+        our::AssetDependencies dependencies;
+        std::string cookedPath;
+        std::vector<std::string> cookedStrings;
+        if (config.contains("cooked-scenes")) {
+            cookedPath = config["cooked-scenes"].get<std::string>() + "/" + name + ".scene";
+            // The asset names are stored in the string table of the cooked scene, so we load any asset named there
+            uint64_t cookedHash = 0;
+            if (our::scene_binary::readStrings(cookedPath, cookedStrings, &cookedHash)) {
+                nlohmann::json prefabsSource = config.value("prefabs", nlohmann::json());
+                if (cookedHash != our::scene_binary::hashSources(config[name], prefabsSource)) {
+                    std::cout << cookedPath << " is outdated (cook the levels again), " << name
+                              << " is loaded from the json" << std::endl;
+                    cookedStrings.clear();
+                }
+            }
+            dependencies.meshes.insert(cookedStrings.begin(), cookedStrings.end());
+            dependencies.materials.insert(cookedStrings.begin(), cookedStrings.end());
+        }
+        nlohmann::json entities, prefabs;
+        if (cookedStrings.empty()) {
+            entities = our::resolveConfig(config[name]);
+            if (config.contains("prefabs")) prefabs = our::resolveConfig(config["prefabs"]);
+            our::collectAssetDependencies(entities, dependencies, prefabs);
+        }
+        if (config.contains("assets")) {
+            our::deserializeAssets(config["assets"], dependencies);
+        }
+
+        if (!cookedStrings.empty()) {
+            if (our::scene_binary::load(&world, cookedPath)) {
+                std::cout << name << " is loaded from " << cookedPath << std::endl;
+                return;
+            }
+            entities = our::resolveConfig(config[name]);
+            if (config.contains("prefabs")) prefabs = our::resolveConfig(config["prefabs"]);
+        }
+        // The prefabs are deserialized once (after the assets they refer to are loaded) then each instance just clones them
+        world.deserializePrefabs(prefabs);
+        world.deserialize(entities);
+    }
+
     void onInitialize() override {
         // First of all, we get the scene configuration from the app config
         auto &config = getApp()->getConfig()["scene"];
-        // If we have assets in the scene config, we deserialize them
-        if (config.contains("assets")) {
-            our::deserializeAllAssets(config["assets"]);
-        }
-        // If we have a world in the scene config, we use it to populate our world
+        // Then we pick the level to play: "level1", "level2" or "level3" if it exists, otherwise the default "world"
         int level = getApp()->levelState;
-        if (level == 1) {
-            world.level = 1;
-            if (config.contains("level1")) {
-                std::cout << "level1 is rendered" << std::endl;
-                world.deserialize(config["level1"]);
-            } else if (config.contains("world")) {
-                std::cout << "world is rendered" << std::endl;
-                world.deserialize(config["world"]);
-            }
-        } else if (level == 2) {
-            world.level = 2;
-            if (config.contains("level2")) {
-                std::cout << "level2 is rendered" << std::endl;
-                world.deserialize(config["level2"]);
-            } else if (config.contains("world")) {
-                std::cout << "world is rendered" << std::endl;
-                world.deserialize(config["world"]);
-            }
-        } else if (level == 3) {
-            world.level = 3;
-            if (config.contains("level3")) {
-                std::cout << "level3 is rendered" << std::endl;
-                world.deserialize(config["level3"]);
-            } else if (config.contains("world")) {
-                std::cout << "world is rendered" << std::endl;
-                world.deserialize(config["world"]);
-            }
+        std::string levelName = "world";
+        if (level >= 1 && level <= 3) {
+            world.level = level;
+            if (config.contains("level" + std::to_string(level)))
+                levelName = "level" + std::to_string(level);
+        }
+        if (!loadedLevel.empty() && loadedLevel == levelName) {
+            // The level is still loaded from the last time it was played, so we just restore its initial state
+            std::cout << levelName << " is restarted" << std::endl;
+            world.restore(levelStart);
         } else {
-            if (config.contains("world")) {
-                std::cout << "world is rendered" << std::endl;
-                world.deserialize(config["world"]);
+            unloadLevel();
+            // If we have the level in the scene config, we use it to populate our world (along with the assets it needs)
+            if (config.contains(levelName)) {
+                std::cout << levelName << " is rendered" << std::endl;
+                loadLevel(config, levelName);
+            } else if (config.contains("assets")) {
+                our::deserializeAllAssets(config["assets"]);
             }
+            loadedLevel = levelName;
+            levelStart = world.snapshot();
         }
 
+        // Read the checkpoint options (if any) and start with no checkpoints
+        if (config.contains("checkpoints")) {
+            checkpointInterval = config["checkpoints"].value("interval", checkpointInterval);
+            maxCheckpoints = config["checkpoints"].value("count", maxCheckpoints);
+        }
+        checkpoints.clear();
+        checkpointTimer = 0;
+
         // We initialize the camera controller system since it needs a pointer to the app
         cameraController.enter(getApp());
         collisionSystem.enter(getApp());
         finalLineSystem.enter(getApp());
-        renderer.enter(getApp());
 
-        // Then we initialize the renderer
+        // Then we create & initialize the renderer
+        renderer = our::createRenderer(config["renderer"]);
+        renderer->enter(getApp());
         auto size = getApp()->getFrameBufferSize();
-        renderer.initialize(size, config["renderer"]);
+        renderer->initialize(size, config["renderer"]);
+        // Compile all the postprocessing shaders now so that switching between the effects never compiles a shader
+        for (auto chain : {&vignetteChain, &radialBlurChain, &sandChain, &collisionChain})
+            renderer->preloadPostprocess(*chain);
 
 #ifdef USE_SOUND
         // Plat state sound
@@ -106,30 +180,65 @@ class Playstate : public our::State {
 
         repeatSystem.update(&world, (float) deltaTime, level);
         finalLineSystem.update(&world, (float) deltaTime);
+        updateCheckpoints((float) deltaTime);
 
-        std::string postProcessFrag = "assets/shaders/postprocess/vignette.frag";
+        const std::vector<std::string> *postprocessChain = &vignetteChain;
         if (getApp()->levelState == 3 && getApp()->motionState == our::MotionState::RUNNING)
-            postProcessFrag = "assets/shaders/postprocess/radial-blur.frag";
+            postprocessChain = &radialBlurChain;
         if (getApp()->levelState == 2)
-            postProcessFrag = "assets/shaders/postprocess/sandWethereEffect.frag";
+            postprocessChain = &sandChain;
         if (collisionStartTime != 0) {
             collisionStartTime += deltaTime;
-            postProcessFrag = "assets/shaders/postprocess/Grain.frag";
+            postprocessChain = &collisionChain;
         }
         // Collision effect for 100 time
         if (collisionStartTime >= 20 * deltaTime)collisionStartTime = 0;
+        // Let the observers react to the components that were added or changed by the systems (e.g. the HUD) before drawing
+        world.dispatchEvents();
         // And finally we use the renderer system to draw the scene
-        renderer.render(&world, postProcessFrag);
+        renderer->render(&world, *postprocessChain);
 
         // Get a reference to the keyboard object
         auto &keyboard = getApp()->getKeyboard();
 
+        if (keyboard.justPressed(GLFW_KEY_F3)) showDebugOverlay = !showDebugOverlay;
+
         if (keyboard.justPressed(GLFW_KEY_ESCAPE)) {
             // If the escape  key is pressed in this frame, go to the play state
             getApp()->changeState("menu");
         }
     }
 
+    // Takes a checkpoint every "checkpointInterval" seconds while running and rolls back to the newest one when F5 is pressed
+    void updateCheckpoints(float deltaTime) {
+        if (getApp()->getKeyboard().justPressed(GLFW_KEY_F5) && !checkpoints.empty()) {
+            // If the newest checkpoint was just taken, we drop it and go one step further back
+            if (checkpoints.size() > 1 && checkpointTimer < 1.0f) checkpoints.pop_back();
+            auto &checkpoint = checkpoints.back();
+            world.restore(checkpoint.world);
+            getApp()->countPepsi = checkpoint.countPepsi;
+            getApp()->heartCount = checkpoint.heartCount;
+            checkpointTimer = 0;
+            return;
+        }
+        if (getApp()->motionState != our::MotionState::RUNNING || checkpointInterval <= 0) return;
+        checkpointTimer += deltaTime;
+        if (checkpointTimer < checkpointInterval) return;
+        checkpointTimer = 0;
+        checkpoints.push_back({world.snapshot(), getApp()->countPepsi, getApp()->heartCount});
+        while (checkpoints.size() > maxCheckpoints) checkpoints.pop_front();
+    }
+
+    // Deletes the loaded level (the world & the assets)
+    void unloadLevel() {
+        world.clear();
+        // and we delete all the loaded assets to free memory on the RAM and the VRAM
+        our::clearAllAssets();
+        loadedLevel.clear();
+        levelStart = our::WorldSnapshot();
+        checkpoints.clear();
+    }
+
     void onImmediateGui() override {
         if (getApp()->motionState == our::MotionState::RESTING) {
             ImGui::Begin("Start running", 0,
@@ -146,17 +255,85 @@ class Playstate : public our::State {
 
             ImGui::End();
         }
+        if (showDebugOverlay) drawDebugOverlay();
+    }
+
+    // Draws the memory statistics of the engine in a small window
+    void drawDebugOverlay() {
+        ImGui::Begin("Debug", &showDebugOverlay, ImGuiWindowFlags_AlwaysAutoResize);
+        auto &frameStats = getApp()->getFrameArena().getStats();
+        ImGui::Text("Frame memory (KiB): last %.1f, peak %.1f, capacity %.1f", frameStats.lastFrame / 1024.0,
+                    frameStats.peak / 1024.0, frameStats.capacity / 1024.0);
+        ImGui::Text("Frame memory heap allocations: %zu", frameStats.growths);
+        // The GPU time spent in each stage of the renderer
+        ImGui::Separator();
+        auto rendererStats = renderer->getStats();
+        bool depthPrepass = renderer->isDepthPrepassEnabled();
+        if (ImGui::Checkbox("Depth pre-pass", &depthPrepass)) renderer->setDepthPrepass(depthPrepass);
+        bool dynamicResolution = renderer->isDynamicResolutionEnabled();
+        if (ImGui::Checkbox("Dynamic resolution", &dynamicResolution)) renderer->setDynamicResolution(dynamicResolution);
+        ImGui::Text("GPU frame: %.2f ms at %.0f%% resolution", rendererStats.frameTime, rendererStats.renderScale * 100.0f);
+        if (renderer->isHDREnabled()) {
+            float exposure = renderer->getExposure();
+            if (ImGui::SliderFloat("Exposure", &exposure, 0.1f, 4.0f)) renderer->setExposure(exposure);
+        }
+        ImGui::Text("GPU (ms): shadows %.2f, opaque %.2f (pre-pass %.2f), sky & transparent %.2f, postprocess %.2f",
+                    rendererStats.shadowTime, rendererStats.opaqueTime, rendererStats.depthPrepassTime,
+                    rendererStats.transparentTime, rendererStats.postprocessTime);
+        ImGui::Text("Shadow maps: %d drawn, %d cached (%zu draws, %zu instances)", rendererStats.shadows.renderedMaps,
+                    rendererStats.shadows.cachedMaps, rendererStats.shadows.casterDraws, rendererStats.shadows.casterInstances);
+        ImGui::Text("Commands: %zu opaque, %zu transparent (%zu triangles)", rendererStats.opaqueCount,
+                    rendererStats.transparentCount, rendererStats.triangleCount);
+        ImGui::Text("Material batches: %zu draws, %zu instances", rendererStats.batchedDraws, rendererStats.batchedInstances);
+        ImGui::Text("Uploads: %.1f KB per frame (%s)", rendererStats.uploadedBytes / 1024.0,
+                    rendererStats.persistentUploads ? "persistent mapping" : "orphaning");
+        // The components allocated by each component pool
+        ImGui::Separator();
+        ImGui::Columns(5, "component pools");
+        ImGui::Text("Component");
+        ImGui::NextColumn();
+        ImGui::Text("Count");
+        ImGui::NextColumn();
+        ImGui::Text("Peak");
+        ImGui::NextColumn();
+        ImGui::Text("Used (KiB)");
+        ImGui::NextColumn();
+        ImGui::Text("Reserved (KiB)");
+        ImGui::NextColumn();
+        size_t totalUsed = 0, totalReserved = 0;
+        for (auto pool: our::ComponentPool::getPools()) {
+            ImGui::Text("%s", pool->getName().c_str());
+            ImGui::NextColumn();
+            ImGui::Text("%zu", pool->getCount());
+            ImGui::NextColumn();
+            ImGui::Text("%zu", pool->getPeakCount());
+            ImGui::NextColumn();
+            ImGui::Text("%.1f", pool->getBytesUsed() / 1024.0);
+            ImGui::NextColumn();
+            ImGui::Text("%.1f", pool->getBytesReserved() / 1024.0);
+            ImGui::NextColumn();
+            totalUsed += pool->getBytesUsed();
+            totalReserved += pool->getBytesReserved();
+        }
+        ImGui::Columns(1);
+        ImGui::Text("Components total (KiB): used %.1f, reserved %.1f", totalUsed / 1024.0, totalReserved / 1024.0);
+        ImGui::End();
     }
 
     void onDestroy() override {
         // Don't forget to destroy the renderer
-        renderer.destroy();
+        renderer->destroy();
+        delete renderer;
+        renderer = nullptr;
         // On exit, we call exit for the camera controller system to make sure that the mouse is unlocked
         cameraController.exit();
-        // Clear the world
-        world.clear();
-        // and we delete all the loaded assets to free memory on the RAM and the VRAM
-        our::clearAllAssets();
+        // The level is kept loaded for a fast restart unless the application is closing
+        if (glfwWindowShouldClose(getApp()->getWindow())) {
+            unloadLevel();
+            collisionSystem.exit();
+            // No component is left, so the component pools can give their memory back
+            our::ComponentPool::trimAll();
+        }
         getApp()->motionState = our::MotionState::RESTING;
 
         // Stop play state sound
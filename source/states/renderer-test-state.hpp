@@ -4,14 +4,14 @@
 #include <ecs/world.hpp>
 #include <components/camera.hpp>
 #include <components/mesh-renderer.hpp>
-#include <systems/forward-renderer.hpp>
+#include <systems/deferred-renderer.hpp>
 #include <application.hpp>
 
-// This state tests and shows how to use the Forward renderer.
+// This state tests and shows how to use the renderers (the forward renderer unless the renderer config asks for another type).
 class RendererTestState: public our::State {
 
     our::World world;
-    our::ForwardRenderer renderer;
+    our::ForwardRenderer *renderer = nullptr;
     
     void onInitialize() override {
         // First of all, we get the scene configuration from the app config
@@ -27,15 +27,18 @@ class RendererTestState: public our::State {
         }
 
         glm::ivec2 size = getApp()->getFrameBufferSize();
-        renderer.initialize(size, config["renderer"]);
+        renderer = our::createRenderer(config["renderer"]);
+        renderer->initialize(size, config["renderer"]);
     }
 
     void onDraw(double deltaTime) override {
         // We simply call the renderer's "render" function and it should do all the rendering work
-        renderer.render(&world);
+        renderer->render(&world);
     }
 
     void onDestroy() override {
+        renderer->destroy();
+        delete renderer;
         world.clear();
         our::clearAllAssets();
     }
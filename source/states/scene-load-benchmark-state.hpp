@@ -0,0 +1,97 @@
+#pragma once
+
+#include <application.hpp>
+#include <ecs/world.hpp>
+#include <ecs/scene-binary.hpp>
+#include <config-utils.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+
+// This state compares the time it takes to load the levels from the json config against loading their cooked binary version.
+// It runs once in "onInitialize", prints the results then closes the application.
+// The benchmark only measures the ECS side of loading (entities & components), so no assets are loaded.
+// The benchmark options are read from the "benchmark" object in the app config:
+//  - "config": the path of the config holding the levels (default: "config/app.jsonc")
+//  - "levels": the level keys to benchmark (default: ["world", "level2", "level3"])
+//  - "iterations": how many times each level is loaded (default: 10)
+//  - "directory": where the cooked levels are written (default: "cache/benchmark")
+class SceneLoadBenchmarkState : public our::State {
+
+    using Clock = std::chrono::high_resolution_clock;
+
+    static double millisecondsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    void onInitialize() override {
+        auto &options = getApp()->getConfig()["benchmark"];
+        std::string configPath = options.value("config", "config/app.jsonc");
+        std::vector<std::string> levels = options.value("levels", std::vector<std::string>{"world", "level2", "level3"});
+        int iterations = std::max(1, options.value("iterations", 10));
+        std::string directory = options.value("directory", "cache/benchmark");
+        std::filesystem::create_directories(directory);
+
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "Scene load benchmark (" << iterations << " iterations, averaged, in milliseconds)" << std::endl;
+        std::cout << std::setw(10) << "level" << std::setw(10) << "entities"
+                  << std::setw(14) << "json parse" << std::setw(14) << "json walk" << std::setw(14) << "json total"
+                  << std::setw(14) << "binary" << std::setw(10) << "speedup" << std::endl;
+
+        for (auto &level: levels) {
+            double parseTime = 0, walkTime = 0, binaryTime = 0;
+            size_t entityCount = 0;
+
+            // The json path: parse the level document (or the whole config if the level is written inline) then walk the level array
+            nlohmann::json config = our::parseConfigFile(configPath);
+            if (!config.contains("scene") || !config["scene"].contains(level)) {
+                std::cout << std::setw(10) << level << "  (missing from " << configPath << ")" << std::endl;
+                continue;
+            }
+            const nlohmann::json &levelConfig = config["scene"][level];
+            nlohmann::json entities, prefabs;
+            for (int iteration = 0; iteration < iterations; ++iteration) {
+                auto start = Clock::now();
+                entities = levelConfig.is_string() ? our::parseConfigFile(levelConfig.get<std::string>())
+                                                   : our::parseConfigFile(configPath)["scene"][level];
+                if (config["scene"].contains("prefabs")) prefabs = our::resolveConfig(config["scene"]["prefabs"]);
+                parseTime += millisecondsSince(start);
+
+                our::World world;
+                world.level = 1;
+                start = Clock::now();
+                world.deserializePrefabs(prefabs);
+                world.deserialize(entities);
+                walkTime += millisecondsSince(start);
+                entityCount = world.getEntities().size();
+            }
+
+            // The binary path: cook once, then load the cooked file
+            std::string cookedPath = directory + "/" + level + ".scene";
+            if (!our::scene_binary::cook(entities, 1, cookedPath, prefabs)) {
+                std::cout << std::setw(10) << level << "  (failed to cook into " << cookedPath << ")" << std::endl;
+                continue;
+            }
+            for (int iteration = 0; iteration < iterations; ++iteration) {
+                our::World world;
+                auto start = Clock::now();
+                our::scene_binary::load(&world, cookedPath);
+                binaryTime += millisecondsSince(start);
+            }
+
+            parseTime /= iterations;
+            walkTime /= iterations;
+            binaryTime /= iterations;
+            double jsonTime = parseTime + walkTime;
+            std::cout << std::setw(10) << level << std::setw(10) << entityCount
+                      << std::setw(14) << parseTime << std::setw(14) << walkTime << std::setw(14) << jsonTime
+                      << std::setw(14) << binaryTime << std::setw(9) << (binaryTime > 0 ? jsonTime / binaryTime : 0.0)
+                      << "x" << std::endl;
+        }
+
+        // We are done, there is nothing to draw
+        getApp()->close();
+    }
+};
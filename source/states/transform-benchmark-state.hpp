@@ -0,0 +1,92 @@
+#pragma once
+
+#include <application.hpp>
+#include <ecs/transform-batch.hpp>
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+// This state compares composing the transform matrices one by one using "Transform::toMat4" against the batched kernels
+// in "ecs/transform-batch.hpp" (scalar, SSE & AVX2). It runs once in "onInitialize", prints the results then closes the application.
+// The benchmark options are read from the "benchmark" object in the app config:
+//  - "counts": the number of transforms in each run (default: [1000, 10000, 100000])
+//  - "iterations": how many times the matrices are composed in each run (default: 20)
+class TransformBenchmarkState : public our::State {
+
+    using Clock = std::chrono::high_resolution_clock;
+
+    static double secondsSince(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Returns the largest difference between the matching elements of the two matrix arrays
+    static float maxError(const std::vector<glm::mat4> &a, const std::vector<glm::mat4> &b) {
+        float error = 0;
+        for (size_t index = 0; index < a.size(); ++index)
+            for (int column = 0; column < 4; ++column)
+                for (int row = 0; row < 4; ++row)
+                    error = std::max(error, std::abs(a[index][column][row] - b[index][column][row]));
+        return error;
+    }
+
+    void onInitialize() override {
+        auto &options = getApp()->getConfig()["benchmark"];
+        std::vector<size_t> counts = options.value("counts", std::vector<size_t>{1000, 10000, 100000});
+        int iterations = std::max(1, options.value("iterations", 20));
+
+        std::vector<our::SimdLevel> levels = {our::SimdLevel::SCALAR};
+        if (our::detectSimdLevel() >= our::SimdLevel::SSE) levels.push_back(our::SimdLevel::SSE);
+        if (our::detectSimdLevel() >= our::SimdLevel::AVX2) levels.push_back(our::SimdLevel::AVX2);
+
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << "Transform benchmark (" << iterations << " iterations, best instruction set: "
+                  << our::simdLevelName(our::detectSimdLevel()) << ", in million matrices per second)" << std::endl;
+        std::cout << std::setw(10) << "count" << std::setw(12) << "toMat4";
+        for (auto level: levels) std::cout << std::setw(12) << our::simdLevelName(level);
+        std::cout << std::setw(10) << "speedup" << std::setw(14) << "max error" << std::endl;
+
+        std::mt19937 generator(12345);
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f), angle(-glm::pi<float>(), glm::pi<float>()), scale(0.1f, 4.0f);
+        for (size_t count: counts) {
+            std::vector<our::Transform> transforms(count);
+            our::TransformBatch batch;
+            batch.reserve(count);
+            for (auto &transform: transforms) {
+                transform.position = {position(generator), position(generator), position(generator)};
+                transform.rotation = {angle(generator), angle(generator), angle(generator)};
+                transform.scale = {scale(generator), scale(generator), scale(generator)};
+                batch.push(transform);
+            }
+
+            std::vector<glm::mat4> reference(count), matrices(count);
+            auto start = Clock::now();
+            for (int iteration = 0; iteration < iterations; ++iteration)
+                for (size_t index = 0; index < count; ++index) reference[index] = transforms[index].toMat4();
+            double referenceRate = double(count) * iterations / secondsSince(start) / 1e6;
+            std::cout << std::setw(10) << count << std::setw(12) << referenceRate;
+
+            double bestRate = 0;
+            float error = 0;
+            for (auto level: levels) {
+                start = Clock::now();
+                for (int iteration = 0; iteration < iterations; ++iteration)
+                    our::composeTransforms(batch, matrices.data(), level);
+                double rate = double(count) * iterations / secondsSince(start) / 1e6;
+                bestRate = std::max(bestRate, rate);
+                error = std::max(error, maxError(reference, matrices));
+                std::cout << std::setw(12) << rate;
+            }
+            std::cout << std::setw(9) << (referenceRate > 0 ? bestRate / referenceRate : 0.0) << "x"
+                      << std::setw(14) << std::scientific << error << std::fixed << std::endl;
+        }
+
+        // We are done, there is nothing to draw
+        getApp()->close();
+    }
+};